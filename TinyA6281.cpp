@@ -43,20 +43,89 @@
 	packet.clockMode = clockMode; \
 	packet.mode_correct = TA6281_MODE_CORRECT;
 
+/* Stop the external PWM clock, if it's running, to use the clock pin */
+#define TA6281_PAUSECLOCK() \
+	if (clock_running) { \
+		MCU::stopClock(pin_clock); \
+		clock_running = false; \
+	}
+
+/* Put a bit on the data line and clock it in */
+#define TA6281_CLOCKBIT(bit) \
+	MCU::digitalOut(pin_data, (bit) ? HIGH : LOW); \
+	MCU::digitalOut(pin_clock, HIGH); \
+	MCU::delayUs(TA6281_CLOCK_DELAY_US); \
+	MCU::digitalOut(pin_clock, LOW); \
+	MCU::delayUs(TA6281_CLOCK_DELAY_US);
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+/* Whether a (PWM) packet lights anything up */
+#define TA6281_ISLIT(packet)	(((packet).value & 0x3FFFFFFFUL) != 0)
+
+/* Keep lit_count up to date when a tracked packet is replaced */
+#define TA6281_TRACKLIT(old_packet, new_packet) \
+	if (TA6281_ISLIT(old_packet)) lit_count--; \
+	if (TA6281_ISLIT(new_packet)) lit_count++;
+
+/* Keep the per-channel PWM sums up to date when a tracked packet is replaced */
+#define TA6281_TRACKPOWER(old_packet, new_packet) \
+	pwm_sum[0] += (new_packet).pwm_0; pwm_sum[0] -= (old_packet).pwm_0; \
+	pwm_sum[1] += (new_packet).pwm_1; pwm_sum[1] -= (old_packet).pwm_1; \
+	pwm_sum[2] += (new_packet).pwm_2; pwm_sum[2] -= (old_packet).pwm_2;
+
+/* PWM sums are weighed in 64ths of full PWM, times the dot-correction
+ ** weight, so a long chain's load still fits in 32 bits: a channel at
+ ** full PWM and dot-correction weighs TA6281_POWER_FULLSCALE.
+ */
+#define TA6281_POWER_SHIFT		6
+#define TA6281_POWER_FULLSCALE \
+	(((unsigned long) TA6281_PWM_MAXVALUE * TA6281_CORRECTION_MAXVALUE) >> TA6281_POWER_SHIFT)
+#define TA6281_POWER_MAXLOAD	0xFFFFFFUL
+
+/* Current still drawn at dot-correction 0 (36.5% per the datasheet), in 127ths */
+#define TA6281_CORRECTION_FLOOR		46
+
+/* How far the limit must be able to rise before the correction is re-sent */
+#define TA6281_POWER_HYSTERESIS		4
+#endif
+
+#ifdef TA6281_LOOPBACK_ENABLE
+/* Marker used to detect the chain length, and word used to check it */
+#define TA6281_LOOPBACK_MARKER		0xA5
+#define TA6281_LOOPBACK_TESTWORD	0x5A3C96E1UL
+#endif
+
 /*
  ** TinyA6281 constructor.
  ** Only needs to setup defaults and record the number of A6281s in the chain.
  */
 TinyA6281::TinyA6281(DriverNum numA6281s, bool autoUpdates) :
-		using_nEnable(false), pin_data(TA6281_DEFAULT_DATAPIN), pin_clock(
+		using_nEnable(false), user_enabled(true),
+#ifdef TA6281_LOOPBACK_ENABLE
+		using_loopback(false), pin_loopback(0),
+#endif
+		pin_data(TA6281_DEFAULT_DATAPIN), pin_clock(
 				TA6281_DEFAULT_CLOCKPIN), pin_latch(TA6281_DEFAULT_LATCHPIN), pin_nEnable(
 				TA6281_DEFAULT_NENABLEPIN), num_sent(0), num_drivers(numA6281s), auto_update_cycle(
-				autoUpdates)
+				autoUpdates), update_pending(false), latch_count(0), latch_held(false), latch_owed(
+				false), correction_due(false), external_clock_hz(0), clock_running(false), registers_clocked(false), latch_pending(false), latch_quiet_us(0), last_send_us(0), command_base(
+				commandPacket(TA6281_CORRECTION_MAXVALUE,
+						TA6281_CORRECTION_MAXVALUE, TA6281_CORRECTION_MAXVALUE,
+						TA6281_COMMAND_CLOCK_800kHz)), command_map(NULL), command_map_len(
+				0), correction_scale(
+				TA6281_CORRECTION_MAXVALUE), correction_refresh(0), latches_since_correction(
+				0)
 #ifdef TA6281_STATE_TRACKING_ENABLE
-			, tracking_state(false), state_vector(NULL), state_vector_head_idx(0)
+			, tracking_state(false), state_vector(NULL), state_vector_head_idx(0),
+			lit_count(0), blackout_detection(false), blacked_out(false),
+			command_shifted(false),
+			power_budget_ma(0), power_channel_ma(0), power_scale(
+				TA6281_CORRECTION_MAXVALUE), correction_peak(command_base)
 #endif
 {
-
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	pwm_sum[0] = pwm_sum[1] = pwm_sum[2] = 0;
+#endif
 }
 
 /* autoUpdate
@@ -70,14 +139,62 @@ bool TinyA6281::autoUpdate() {
  ** Turn auto-update on or off, using a boolean parameter.
  */
 void TinyA6281::setAutoUpdate(bool setTo) {
+	if (!setTo) {
+		// don't leave anything hanging
+		flush();
+	}
 	auto_update_cycle = setTo;
 }
 
+/*
+ ** setLatchCoalescing
+ ** Only latch auto-updates once nothing was sent for quiet_us.
+ */
+void TinyA6281::setLatchCoalescing(unsigned long quiet_us) {
+	if (!quiet_us) {
+		flush();
+	}
+	latch_quiet_us = quiet_us;
+}
+
+/*
+ ** flush
+ ** Latch any coalesced auto-updates now.
+ */
+void TinyA6281::flush() {
+	if (latch_pending) {
+		// clears latch_pending
+		endUpdate();
+	}
+}
+
+/*
+ ** poll
+ ** Latch coalesced auto-updates, if the quiet interval is over.
+ */
+bool TinyA6281::poll() {
+	if (!latch_pending || MCU::micros() - last_send_us < latch_quiet_us) {
+		return false;
+	}
+
+	flush();
+	return true;
+}
+
 /*
  ** setEnabled
  ** Sets the ~ENABLE pin appropriately, if it's being used.
  */
 void TinyA6281::setEnabled(bool activate) {
+	user_enabled = activate;
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	if (blacked_out) {
+		// stays dark until there's something to show, see endUpdate()
+		return;
+	}
+#endif
+
 	// it's inverted (enabled when low)
 	if (using_nEnable) {
 		if (activate) {
@@ -101,9 +218,12 @@ void TinyA6281::setPins(uint8_t datapin, uint8_t clockpin, uint8_t latchpin,
 	pin_latch = latchpin;
 	pin_nEnable = nEnablepin;
 
+#ifndef TINYBRITE_PLATFORM_PACKET_TRANSPORT
+	// (data and clock belong to the platform's transport, otherwise)
 	MCU::setPinMode(pin_clock, OUTPUT);
-	MCU::setPinMode(pin_latch, OUTPUT);
 	MCU::setPinMode(pin_data, OUTPUT);
+#endif
+	MCU::setPinMode(pin_latch, OUTPUT);
 
 	if (using_nEnable) {
 		MCU::setPinMode(pin_nEnable, OUTPUT);
@@ -120,7 +240,9 @@ void TinyA6281::setup(uint8_t datapin, uint8_t clockpin, uint8_t latchpin) {
 	using_nEnable = false; // make sure we set this *prior* to setPins call
 	setPins(datapin, clockpin, latchpin, TA6281_DEFAULT_NENABLEPIN);
 
+#ifndef TINYBRITE_PLATFORM_PACKET_TRANSPORT
 	MCU::digitalOut(pin_clock, LOW);
+#endif
 	MCU::digitalOut(pin_latch, LOW);
 
 }
@@ -135,7 +257,9 @@ void TinyA6281::setup(uint8_t datapin, uint8_t clockpin, uint8_t latchpin,
 	using_nEnable = true; // make sure we set this *prior* to setPins call
 	setPins(datapin, clockpin, latchpin, nEnablepin);
 
+#ifndef TINYBRITE_PLATFORM_PACKET_TRANSPORT
 	MCU::digitalOut(pin_clock, LOW);
+#endif
 	MCU::digitalOut(pin_latch, LOW);
 	MCU::digitalOut(pin_nEnable, LOW);
 
@@ -160,6 +284,10 @@ void TinyA6281::setup(uint8_t datapin, uint8_t clockpin, uint8_t latchpin,
 void TinyA6281::beginUpdate() {
 	// reset our number sent counter	
 	num_sent = 0;
+	update_pending = true;
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	command_shifted = false;
+#endif
 }
 
 /*
@@ -168,11 +296,113 @@ void TinyA6281::beginUpdate() {
  ** See beginUpdate, above.
  */
 DriverNum TinyA6281::endUpdate() {
+	DriverNum numSent = num_sent;
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	if (blackout_detection && tracking_state && state_vector) {
+		if (! lit_count) {
+			if (! blacked_out) {
+				// latch the (black) frame, so nothing stale can show if the
+				// outputs get enabled, and blank the chain.
+				if (num_sent) {
+					latch();
+				}
+				blacked_out = true;
+				MCU::digitalOut(pin_nEnable, HIGH);
+			} else if (command_shifted) {
+				// commands still go through in the dark: a later refresh()
+				// would push them past the chain, unlatched
+				latch();
+			}
+
+			update_pending = false;
+			latch_pending = false;
+			return numSent;
+		}
+
+		if (blacked_out) {
+			// back from the dark: the shift registers are stale, send
+			// everything we've been tracking, then light up.
+			if (command_shifted) {
+				// (once any commands sent along are latched, see above)
+				latch();
+			}
+			blacked_out = false;
+			refresh();
+			setEnabled(user_enabled);
+
+			return numSent;
+		}
+	}
+#endif
+
 	if (num_sent) {
+		bool correct = false;
+
+		if (!restoreClocked()) {
+			// the rest of the chain would latch whatever the external clock
+			// shifted in: only full frames go out with it running
+			abortUpdate();
+			return 0;
+		}
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+		uint8_t needed = powerScaleNeeded();
+		uint8_t applied = appliedScale();
+		if (needed < power_scale) {
+			// over budget: dim before this frame shows
+			power_scale = needed;
+			if (appliedScale() != applied) {
+				if (latch_held) {
+					correction_due = true;
+				} else {
+					// the commands push the frame out of the shift registers,
+					// and the tracked state (which has it) is put back in.
+					// (sendCorrection() would flush() us back here, otherwise)
+					latch_pending = false;
+					sendCorrection();
+				}
+			}
+		} else if (needed > power_scale
+				&& (needed == TA6281_CORRECTION_MAXVALUE
+						|| needed - power_scale >= TA6281_POWER_HYSTERESIS)) {
+			// back under budget: brighten once this frame shows
+			power_scale = needed;
+			correct = (appliedScale() != applied);
+		}
+#endif
+
 		latch();
+
+		if (correction_refresh
+				&& ++latches_since_correction >= correction_refresh) {
+			// time to make sure the command registers haven't been lost
+			correct = true;
+		}
+
+		if (correct) {
+			// (the commands would push held data out, so wait for it)
+			if (latch_held) {
+				correction_due = true;
+			} else {
+				sendCorrection();
+			}
+		}
 	}
 
-	return num_sent;
+	update_pending = false;
+	return numSent;
+}
+
+/*
+ ** abortUpdate
+ ** End an update cycle without latching.
+ ** See beginUpdate, above.
+ */
+void TinyA6281::abortUpdate() {
+	num_sent = 0;
+	update_pending = false;
+	latch_pending = false;
 }
 
 /*
@@ -226,43 +456,320 @@ void TinyA6281::sendCommand(unsigned int correct0, unsigned int correct1,
 
 	TA6281_SETCOMMANDPACKET(packet, correct0, correct1, correct2, clockMode);
 
+	// this is now the chain's dot-correction and clock setting
+	command_base = packet;
+
 	sendPacket (packet);
 
 }
 
+/*
+ ** scaledCommand
+ ** Apply the correction scale to a command packet's dot-correction.
+ ** (dc * (scale + 1)) >> 7 keeps full scale exact without a division.
+ */
+A6281Packet TinyA6281::scaledCommand(A6281Packet command) {
+	if (external_clock_hz) {
+		// every device must follow the clock we generate
+		command.clockMode = TA6281_COMMAND_CLOCK_EXT;
+	}
+
+	uint8_t scale = appliedScale();
+	if (scale >= TA6281_CORRECTION_MAXVALUE) {
+		return command;
+	}
+
+	uint16_t mult = scale + 1;
+	command.dotCorrect0 = (command.dotCorrect0 * mult) >> 7;
+	command.dotCorrect1 = (command.dotCorrect1 * mult) >> 7;
+	command.dotCorrect2 = (command.dotCorrect2 * mult) >> 7;
+
+	return command;
+}
+
+/*
+ ** appliedScale
+ ** The correction scale in use: the one set, or lower if the power limit
+ ** holds it down.
+ */
+uint8_t TinyA6281::appliedScale() {
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	if (power_scale < correction_scale) {
+		return power_scale;
+	}
+#endif
+	return correction_scale;
+}
+
+/*
+ ** setCorrectionScale
+ ** Scale the dot-correction of every device, and send it.
+ */
+void TinyA6281::setCorrectionScale(uint8_t scale) {
+	correction_scale =
+			(scale > TA6281_CORRECTION_MAXVALUE) ?
+					TA6281_CORRECTION_MAXVALUE : scale;
+	sendCorrection();
+}
+
+/*
+ ** setCorrectionMap
+ ** Use per-device command packets, in order from the uC.
+ */
+void TinyA6281::setCorrectionMap(const A6281Packet * per_device,
+		DriverNum num_entries) {
+	command_map = per_device;
+	command_map_len = per_device ? num_entries : 0;
+}
+
+/*
+ ** correctionPacket
+ ** The command packet a device gets from sendCorrection().
+ */
+A6281Packet TinyA6281::correctionPacket(DriverNum driver_index) {
+	if (command_map && driver_index < command_map_len) {
+		return scaledCommand(command_map[driver_index]);
+	}
+
+	return scaledCommand(command_base);
+}
+
+/*
+ ** setCorrectionRefresh
+ ** Re-send the correction automatically every num_latches latches.
+ */
+void TinyA6281::setCorrectionRefresh(uint16_t num_latches) {
+	correction_refresh = num_latches;
+	latches_since_correction = 0;
+}
+
+/*
+ ** sendCorrection
+ ** Send the (scaled) dot-correction to every device in a single pass.
+ **
+ ** Once latched, command packets go to the dot-correction registers and
+ ** the PWM registers keep their values, so this doesn't affect colours
+ ** (and isn't recorded in the tracked state).
+ */
+void TinyA6281::sendCorrection() {
+	correctionPass(false);
+}
+
+/*
+ ** correctionPass
+ ** Send and latch the correction, then shift the tracked state back in,
+ ** and latch that too if latch_state is set (see refresh()).  Returns the
+ ** number of state packets latched.
+ */
+DriverNum TinyA6281::correctionPass(bool latch_state) {
+	// coalesced packets would be pushed out by the commands, unseen
+	flush();
+
+	bool tmpUpdate = auto_update_cycle;
+
+	auto_update_cycle = false; // disable auto-updates
+	beginUpdate();
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	if (command_map) {
+		// the power estimate counts each channel at its highest
+		// dot-correction, across the map
+		correction_peak = (command_map_len < num_drivers) ?
+				command_base : commandPacket(0, 0, 0, 0);
+		for (DriverNum i = 0; i < command_map_len; i++) {
+			if (command_map[i].dotCorrect0 > correction_peak.dotCorrect0) {
+				correction_peak.dotCorrect0 = command_map[i].dotCorrect0;
+			}
+			if (command_map[i].dotCorrect1 > correction_peak.dotCorrect1) {
+				correction_peak.dotCorrect1 = command_map[i].dotCorrect1;
+			}
+			if (command_map[i].dotCorrect2 > correction_peak.dotCorrect2) {
+				correction_peak.dotCorrect2 = command_map[i].dotCorrect2;
+			}
+		}
+	}
+#endif
+
+	if (command_map) {
+		// the last device's packet goes out first
+		for (DriverNum i = num_drivers; i > 0; i--) {
+			sendPacket(correctionPacket(i - 1));
+		}
+	} else {
+		sendPacketToAll(scaledCommand(command_base));
+	}
+
+	// latch directly: going through endUpdate() would count this latch
+	// towards the next automatic correction refresh
+	latch();
+	latches_since_correction = 0;
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	// the shift registers now hold commands: put the PWM state back in
+	// (unlatched) so that later partial updates still push colours, rather
+	// than corrections, down the chain.
+	shiftState();
+
+	if (latch_state) {
+		// that's a refresh, already shifted: it only needs latching
+		DriverNum numSent = endUpdate();
+		auto_update_cycle = tmpUpdate;
+
+		resumeClock();
+		return numSent;
+	}
+#endif
+
+	// what's left in the shift registers is what's already displayed
+	num_sent = 0;
+	update_pending = false;
+	auto_update_cycle = tmpUpdate;
+
+	resumeClock();
+	return 0;
+}
+
+/*
+ ** setExternalClock
+ ** Generate the PWM clock on the clock pin, and switch the chain to it.
+ */
+bool TinyA6281::setExternalClock(unsigned long frequency_hz) {
+	if (frequency_hz) {
+		if (!MCU::startClock(pin_clock, frequency_hz)) {
+			return false;
+		}
+		// the clock pin is needed for the commands: started again after
+		MCU::stopClock(pin_clock);
+	} else {
+		TA6281_PAUSECLOCK();
+	}
+
+	clock_running = false;
+	external_clock_hz = frequency_hz;
+
+	sendCorrection();
+
+	return true;
+}
+
+/*
+ ** resumeClock
+ ** Restart the external PWM clock, once data is latched.
+ */
+void TinyA6281::resumeClock() {
+	if (external_clock_hz && !clock_running) {
+		// the clock shifts whatever is on DI in: make it zeros (black PWM
+		// packets) rather than the last bit sent, which could build up
+		// command packets.
+		MCU::digitalOut(pin_data, LOW);
+		MCU::startClock(pin_clock, external_clock_hz);
+		clock_running = true;
+		registers_clocked = true;
+	}
+}
+
+/*
+ ** restoreClocked
+ ** Put the tracked state back in the shift registers before latching, if
+ ** the external clock has been through them since the last full frame.
+ ** Returns false if that's needed but there's no state to restore.
+ */
+bool TinyA6281::restoreClocked() {
+	if (!registers_clocked || num_sent >= num_drivers) {
+		// whatever the clock shifted in has been pushed out
+		registers_clocked = false;
+		return true;
+	}
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	if (tracking_state && state_vector) {
+		// the state has this update's packets in it already
+		bool tmpUpdate = auto_update_cycle;
+		auto_update_cycle = false;
+		shiftState();
+		auto_update_cycle = tmpUpdate;
+
+		registers_clocked = false;
+		return true;
+	}
+#endif
+
+	return false;
+}
+
 /*
  ** sendPacket
  ** Send a packet of data to our chain of A6281 devices.
  */
-void TinyA6281::sendPacket(A6281Packet packet,  uint8_t num_times) {
-	if (auto_update_cycle) {
+void TinyA6281::sendPacket(A6281Packet packet, DriverNum num_times) {
+	bool coalescing = auto_update_cycle && latch_quiet_us;
+
+	if (coalescing) {
+		// latch the previous burst if it's over, and start a new one
+		poll();
+		if (!latch_pending) {
+			beginUpdate();
+		}
+	} else if (auto_update_cycle) {
 		beginUpdate();
 	}
 
 
-	for (uint8_t n=0; n < num_times; n++)
+	bool shift = true;
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	// while blacked out, colours only go to the tracked state: the chain is
+	// brought up to date when there's something to show (see endUpdate())
+	shift = ! (blacked_out && packet.mode_pwm == TA6281_MODE_PWM);
+	if (blacked_out && shift) {
+		// a command: endUpdate() must latch it, even in the dark
+		command_shifted = true;
+	}
+#endif
+
+	for (DriverNum n=0; n < num_times; n++)
 	{
-		for (uint8_t i = 1; i < 33; i++) {
-			//Set the appropriate Data In value according to the packet.
-			if ((packet.value >> (32 - i)) & 1)
-				MCU::digitalOut(pin_data, HIGH);
-			else
-				MCU::digitalOut(pin_data, LOW);
-
-			// toggle the clock
-			MCU::digitalOut(pin_clock, HIGH);
-			MCU::delayUs(TA6281_CLOCK_DELAY_US);
-			MCU::digitalOut(pin_clock, LOW);
-			MCU::delayUs(TA6281_CLOCK_DELAY_US);
+		if (shift)
+		{
+#ifdef TINYBRITE_PLATFORM_PACKET_TRANSPORT
+			// the platform clocks whole packets out itself
+			MCU::shiftPacket(packet.value);
+#else
+			TA6281_PAUSECLOCK();
+			for (uint8_t i = 1; i < 33; i++) {
+				//Set the appropriate Data In value according to the packet,
+				// and toggle the clock
+				TA6281_CLOCKBIT((packet.value >> (32 - i)) & 1);
+			}
+#endif
 		}
 
 		num_sent++;
 	}
 
+	update_pending = true;
+
 
 #ifdef TA6281_STATE_TRACKING_ENABLE
 	// state tracking is on, keep this packet if we need to (and can do so).
+	trackPacket(packet, num_times);
+#endif
 
+	if (coalescing) {
+		// the latch waits until we've been quiet for a while
+		latch_pending = (num_sent != 0);
+		last_send_us = MCU::micros();
+	} else if (auto_update_cycle) {
+		endUpdate();
+	}
+
+}
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+/*
+ ** trackPacket
+ ** Record a packet sent num_times, if we're tracking state.
+ */
+void TinyA6281::trackPacket(A6281Packet packet, DriverNum num_times) {
 	/*
 	 * Ok, big explanation for little code, but this needs to be
 	 * clear...
@@ -307,29 +814,37 @@ void TinyA6281::sendPacket(A6281Packet packet,  uint8_t num_times) {
 	 * To restore, you'll have to send them "backwards", see restore for that.
 	 */
 
-	if (tracking_state && state_vector)
+	if (tracking_state && state_vector && packet.mode_pwm == TA6281_MODE_PWM)
 	{
 		// we *are* tracking state and do have a state vector available
-		if (state_vector_head_idx)
-		{
-			// ok, we have room to move down one slot
-			state_vector_head_idx--;
-		} else {
-			// oh, we're at the bottom of our ring, circle 'round:
-			state_vector_head_idx = num_drivers - 1;
-		}
+		// (command packets are latched to other registers, so they never
+		// change the PWM state we're tracking)
 
-		// store this packet.
-		state_vector[state_vector_head_idx] = packet;
-	}
+		// past num_drivers copies, we'd only be going round in circles
+		DriverNum num_copies = (num_times < num_drivers) ? num_times : num_drivers;
 
-#endif
-
-	if (auto_update_cycle) {
-		endUpdate();
+		for (DriverNum n=0; n < num_copies; n++)
+		{
+			if (state_vector_head_idx)
+			{
+				// ok, we have room to move down one slot
+				state_vector_head_idx--;
+			} else {
+				// oh, we're at the bottom of our ring, circle 'round:
+				state_vector_head_idx = num_drivers - 1;
+			}
+
+			// the slot we're about to overwrite held the state of the driver
+			// that just fell off the end of the chain
+			TA6281_TRACKLIT(state_vector[state_vector_head_idx], packet);
+			TA6281_TRACKPOWER(state_vector[state_vector_head_idx], packet);
+
+			// store this packet.
+			state_vector[state_vector_head_idx] = packet;
+		}
 	}
-
 }
+#endif
 
 /*
  ** sendPackets
@@ -338,7 +853,7 @@ void TinyA6281::sendPacket(A6281Packet packet,  uint8_t num_times) {
 void TinyA6281::sendPackets(A6281Packet * packets, DriverNum numPackets) {
 	bool tmpUpdate = false;
 
-	if (auto_update_cycle) {
+	if (auto_update_cycle && !latch_quiet_us) {
 		// suspend autoupdates for multiple send
 		tmpUpdate = true;
 		auto_update_cycle = false;
@@ -361,6 +876,209 @@ void TinyA6281::sendPackets(A6281Packet * packets, DriverNum numPackets) {
 
 }
 
+/*
+ ** compileFrame
+ ** Turn packets into data line states (or packed bits), for sendPackets().
+ */
+bool TinyA6281::compileFrame(const A6281Packet * packets, DriverNum numPackets,
+		A6281CompiledFrame & frame, uint8_t format) {
+	frame.num_packets = 0;
+	frame.states = NULL;
+
+	size_t size;
+	if (format == TA6281_COMPILE_STATES) {
+		size = TA6281_COMPILEDFRAME_SIZE(numPackets);
+	} else if (format == TA6281_COMPILE_PACKED) {
+		size = TA6281_PACKEDFRAME_SIZE(numPackets);
+	} else {
+		// flash frames are built at compile time, see compileFlashFrame()
+		return false;
+	}
+
+	uint8_t * buffer = (uint8_t*) malloc(size);
+	if (!buffer) {
+		return false;
+	}
+
+	frame.num_packets = numPackets;
+	frame.format = format;
+	frame.states = buffer;
+	compileFor(frame);
+
+	for (DriverNum i = 0; i < numPackets; i++) {
+		uint32_t value = packets[i].value;
+		if (format == TA6281_COMPILE_PACKED) {
+			*buffer++ = value >> 24;
+			*buffer++ = value >> 16;
+			*buffer++ = value >> 8;
+			*buffer++ = value;
+			continue;
+		}
+		for (uint8_t bit = 32; bit > 0; bit--) {
+			*buffer++ = ((value >> (bit - 1)) & 1) ? frame.data_mask : 0;
+		}
+	}
+
+	return true;
+}
+
+/*
+ ** compileFlashFrame
+ ** Use packed bytes in flash as a compiled frame: nothing is allocated.
+ */
+void TinyA6281::compileFlashFrame(const uint8_t * flash_bytes,
+		DriverNum numPackets, A6281CompiledFrame & frame) {
+	frame.num_packets = numPackets;
+	frame.format = TA6281_COMPILE_FLASH;
+	frame.states = flash_bytes;
+	compileFor(frame);
+}
+
+/*
+ ** compileFor
+ ** Note our pins, and their port (if they share one) in the frame.
+ */
+void TinyA6281::compileFor(A6281CompiledFrame & frame) {
+	frame.pin_data = pin_data;
+	frame.pin_clock = pin_clock;
+	frame.port = MCU::pinPort(pin_data);
+	if (frame.port != MCU::pinPort(pin_clock)) {
+		// the bits will have to go out a pin at a time
+		frame.port = 0;
+	}
+	frame.data_mask = frame.port ? MCU::pinMask(pin_data) : 1;
+	frame.clock_mask = frame.port ? MCU::pinMask(pin_clock) : 0;
+}
+
+void TinyA6281::freeFrame(A6281CompiledFrame & frame) {
+	if (frame.format != TA6281_COMPILE_FLASH) {
+		free((void *) frame.states);
+	}
+	frame.states = NULL;
+	frame.num_packets = 0;
+}
+
+/*
+ ** compiledPacket
+ ** Get a packet back out of a compiled frame.
+ */
+A6281Packet TinyA6281::compiledPacket(const A6281CompiledFrame & frame,
+		DriverNum index) {
+	A6281Packet packet = {value:0};
+
+	if (frame.format == TA6281_COMPILE_STATES) {
+		const uint8_t * state = frame.states
+				+ TA6281_COMPILEDFRAME_SIZE(index);
+		for (uint8_t bit = 0; bit < 32; bit++) {
+			packet.value = (packet.value << 1) | (*state++ ? 1 : 0);
+		}
+		return packet;
+	}
+
+	uint8_t bytes[4];
+	const uint8_t * packed = frame.states + TA6281_PACKEDFRAME_SIZE(index);
+	if (frame.format == TA6281_COMPILE_FLASH) {
+		MCU::flashRead(bytes, packed, sizeof(bytes));
+	} else {
+		memcpy(bytes, packed, sizeof(bytes));
+	}
+	packet.value = ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16)
+			| ((uint32_t) bytes[2] << 8) | bytes[3];
+	return packet;
+}
+
+/*
+ ** emitFrame
+ ** Clock a compiled frame out, straight to the port if we can.
+ */
+void TinyA6281::emitFrame(const A6281CompiledFrame & frame) {
+	const uint8_t * state = frame.states;
+	bool samePins = (frame.port && frame.pin_data == pin_data
+			&& frame.pin_clock == pin_clock);
+
+	TA6281_PAUSECLOCK();
+
+	if (frame.format == TA6281_COMPILE_STATES) {
+		size_t len = TA6281_COMPILEDFRAME_SIZE(frame.num_packets);
+		if (samePins
+				&& MCU::portEmit(frame.port, frame.data_mask, frame.clock_mask,
+						state, len)) {
+			return;
+		}
+
+		while (len--) {
+			TA6281_CLOCKBIT(*state++);
+		}
+		return;
+	}
+
+	bool inFlash = (frame.format == TA6281_COMPILE_FLASH);
+	if (samePins
+			&& MCU::portEmitPacked(frame.port, frame.data_mask,
+					frame.clock_mask, state,
+					TA6281_PACKEDFRAME_SIZE(frame.num_packets), inFlash)) {
+		return;
+	}
+
+	for (DriverNum i = 0; i < frame.num_packets; i++) {
+		A6281Packet packet = compiledPacket(frame, i);
+		for (uint8_t bit = 1; bit < 33; bit++) {
+			TA6281_CLOCKBIT((packet.value >> (32 - bit)) & 1);
+		}
+	}
+}
+
+/*
+ ** sendPackets
+ ** Send a compiled frame to our chain of A6281 devices.
+ */
+void TinyA6281::sendPackets(const A6281CompiledFrame & frame) {
+	bool direct = !(auto_update_cycle && latch_quiet_us);
+#ifdef TINYBRITE_PLATFORM_PACKET_TRANSPORT
+	direct = false;
+#endif
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	if (blacked_out) {
+		// colours are only tracked, for now: sendPacket() knows
+		direct = false;
+	}
+#endif
+
+	bool tmpUpdate = false;
+	if (auto_update_cycle && !latch_quiet_us) {
+		// suspend autoupdates for multiple send
+		tmpUpdate = true;
+		auto_update_cycle = false;
+		beginUpdate();
+	}
+
+	if (direct) {
+#ifdef TA6281_STATE_TRACKING_ENABLE
+		if (tracking_state && state_vector) {
+			// record what's about to go out, as sendPacket() would
+			for (DriverNum i = 0; i < frame.num_packets; i++) {
+				trackPacket(compiledPacket(frame, i), 1);
+			}
+		}
+#endif
+		emitFrame(frame);
+		num_sent += frame.num_packets;
+		update_pending = true;
+	} else {
+		// rebuild each packet, and send it the usual way
+		for (DriverNum i = 0; i < frame.num_packets; i++) {
+			sendPacket(compiledPacket(frame, i));
+		}
+	}
+
+	if (tmpUpdate) {
+		// auto updates were on
+		endUpdate();
+		// re-enable
+		auto_update_cycle = true;
+	}
+}
+
 /*
  ** sendPacketToAll
  ** Send a single packet to every driver in our chain of A6281 devices.
@@ -371,20 +1089,295 @@ void TinyA6281::sendPacketToAll(A6281Packet packet) {
 
 }
 
+/*
+ ** setNumDrivers
+ ** Change the number of devices in the chain.
+ */
+bool TinyA6281::setNumDrivers(DriverNum num) {
+	if (num == num_drivers) {
+		return true;
+	}
+
+	// a per-device map was made for the old chain
+	command_map = NULL;
+	command_map_len = 0;
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	if (state_vector) {
+		return resizeState(num);
+	}
+#endif
+
+	num_drivers = num;
+	return true;
+}
+
+#ifdef TA6281_LOOPBACK_ENABLE
+/*
+ ** setLoopbackPin
+ ** Register and configure the input pin wired to the last device's DO.
+ */
+void TinyA6281::setLoopbackPin(uint8_t loopbackpin) {
+	pin_loopback = loopbackpin;
+	using_loopback = true;
+
+	MCU::setPinMode(pin_loopback, INPUT);
+}
+
+/*
+ ** loopbackClock
+ ** Clock a bit in, and read what comes out the end of the chain.
+ */
+bool TinyA6281::loopbackClock(bool bit) {
+	TA6281_PAUSECLOCK();
+	TA6281_CLOCKBIT(bit);
+	return MCU::digitalIn(pin_loopback);
+}
+
+/*
+ ** loopbackDone
+ ** The shift registers hold junk from the checks: put the tracked state
+ ** back (unlatched), if we have it.
+ */
+void TinyA6281::loopbackDone() {
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	bool tmpUpdate = auto_update_cycle;
+	auto_update_cycle = false;
+
+	shiftState();
+
+	auto_update_cycle = tmpUpdate;
+#endif
+	num_sent = 0;
+	update_pending = false;
+}
+
+/*
+ ** detectChainLength
+ ** Count the devices by timing a marker through the chain.
+ **
+ ** A bit clocked in at clock j comes out of a chain of N devices after
+ ** clock j + 32N - 1: once the last bit of the marker (clock 8) has
+ ** come out, N = (clocks - 7) / 32.
+ */
+DriverNum TinyA6281::detectChainLength(DriverNum max_drivers, bool resize) {
+	if (!(using_loopback && max_drivers)) {
+		return 0;
+	}
+
+	flush();
+
+	unsigned long maxClocks = (unsigned long) max_drivers * 32;
+	DriverNum found = 0;
+
+	// flush with zeros: whatever comes out now must be low
+	for (unsigned long c = 0; c < maxClocks; c++) {
+		loopbackClock(false);
+	}
+
+	if (!MCU::digitalIn(pin_loopback)) {
+		uint8_t window = 0;
+		for (unsigned long c = 1; c <= maxClocks + 8; c++) {
+			bool bit = (c <= 8) ? ((TA6281_LOOPBACK_MARKER >> (8 - c)) & 1) : false;
+
+			window = (window << 1) | (loopbackClock(bit) ? 1 : 0);
+			if (window == TA6281_LOOPBACK_MARKER) {
+				// round to the nearest, in case DO is a clock edge off
+				found = (c - 7 + 16) / 32;
+				break;
+			}
+		}
+	}
+	// else: longer than max_drivers, or DO is stuck high
+
+	if (found && resize) {
+		setNumDrivers(found);
+	}
+
+	loopbackDone();
+
+	return found;
+}
+
+/*
+ ** verifyChain
+ ** Check that a test word makes it through numDrivers() devices, intact.
+ */
+bool TinyA6281::verifyChain() {
+	if (!(using_loopback && num_drivers)) {
+		return false;
+	}
+
+	flush();
+
+	unsigned long chainClocks = (unsigned long) num_drivers * 32;
+	bool intact = true;
+
+	for (unsigned long c = 1; c < chainClocks + 32; c++) {
+		bool bit = (c <= 32) ? ((TA6281_LOOPBACK_TESTWORD >> (32 - c)) & 1) : false;
+		bool out = loopbackClock(bit);
+
+		if (c >= chainClocks) {
+			// bit (c - chainClocks) of the test word should be coming out
+			bool expected = (TA6281_LOOPBACK_TESTWORD >> (31 - (c - chainClocks))) & 1;
+			if (out != expected) {
+				intact = false;
+				break;
+			}
+		}
+	}
+
+	loopbackDone();
+
+	return intact;
+}
+#endif
+
 /*
  ** latch
  ** Toggle the latch to make data currently in A6281 shift registers take effect.
  */
 void TinyA6281::latch() {
+#ifdef TINYBRITE_PLATFORM_PACKET_TRANSPORT
+	// packets may be queued up by the platform: get them all out first
+	MCU::flushPackets();
+#endif
+
+	// the external clock may have been through the shift registers
+	// (without tracked state, partial updates are refused: see endUpdate())
+	restoreClocked();
+
+	if (latch_held) {
+		// releaseLatch() will take care of it
+		latch_owed = true;
+	} else {
+		pulseLatch();
+		latch_count++;
+	}
+
+	update_pending = false;
+	latch_pending = false;
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	command_shifted = false;
+#endif
+}
+
+/*
+ ** pulseLatch
+ ** Toggle the latch pin.
+ */
+void TinyA6281::pulseLatch() {
 	// Set Latch high
 	MCU::digitalOut(pin_latch, HIGH);
 	MCU::delayUs(TA6281_LATCH_DELAY_US);
 	// Set Latch low
 	MCU::digitalOut(pin_latch, LOW);
+
+	resumeClock();
+}
+
+/*
+ ** releaseLatch
+ ** Stop holding the latch, and latch whatever it was held for.
+ */
+void TinyA6281::releaseLatch() {
+	if (latch_owed) {
+		pulseLatch();
+	}
+	latchReleased();
+}
+
+/*
+ ** latchReleased
+ ** What's left to do once a held latch has been pulsed.
+ */
+void TinyA6281::latchReleased() {
+	latch_held = false;
+	resumeClock();
+
+	if (latch_owed) {
+		latch_owed = false;
+		latch_count++;
+	}
+
+	if (correction_due) {
+		correction_due = false;
+		sendCorrection();
+	}
 }
 
 
 #ifdef TA6281_STATE_TRACKING_ENABLE
+/*
+ ** reverseState
+ ** Reverse the order of state_vector[from..to).
+ */
+void TinyA6281::reverseState(DriverNum from, DriverNum to)
+{
+	while (from + 1 < to)
+	{
+		to--;
+		StatePacket tmp = state_vector[from];
+		state_vector[from] = state_vector[to];
+		state_vector[to] = tmp;
+		from++;
+	}
+}
+
+/*
+ ** resizeState
+ ** Resize the state vector for num drivers, keeping the state of those
+ ** that remain (counting from the uC).  Added drivers are black.
+ */
+bool TinyA6281::resizeState(DriverNum num)
+{
+	bool saved = (state_vector_head_idx < num_drivers);
+
+	if (saved && state_vector_head_idx)
+	{
+		// put the ring in order, driver N in slot N (head goes to 0)
+		reverseState(0, state_vector_head_idx);
+		reverseState(state_vector_head_idx, num_drivers);
+		reverseState(0, num_drivers);
+	}
+
+	StatePacket black = {value:0};
+	for (DriverNum i=num; i < num_drivers; i++)
+	{
+		// falls off the end of the chain
+		TA6281_TRACKLIT(state_vector[i], black);
+		TA6281_TRACKPOWER(state_vector[i], black);
+	}
+
+	StatePacket * resized = num ?
+			(StatePacket*)realloc(state_vector, sizeof(StatePacket) * num) : NULL;
+	if (! resized)
+	{
+		free(state_vector);
+		state_vector = NULL;
+		lit_count = 0;
+		pwm_sum[0] = pwm_sum[1] = pwm_sum[2] = 0;
+		num_drivers = num;
+		if (num)
+		{
+			tracking_state = false;
+			return false;
+		}
+		return true;
+	}
+
+	if (num > num_drivers)
+	{
+		memset(resized + num_drivers, 0, sizeof(StatePacket) * (num - num_drivers));
+	}
+
+	state_vector = resized;
+	state_vector_head_idx = saved ? 0 : num;
+	num_drivers = num;
+
+	return true;
+}
+
 bool TinyA6281::setStateTracking(bool setTo)
 {
 	tracking_state = setTo;
@@ -395,6 +1388,8 @@ bool TinyA6281::setStateTracking(bool setTo)
 		{
 			memset(state_vector, 0, sizeof(StatePacket) * num_drivers);
 			state_vector_head_idx = num_drivers; // we initialize 1 unit out of bounds (decremented on send)
+			lit_count = 0;
+			pwm_sum[0] = pwm_sum[1] = pwm_sum[2] = 0;
 
 		} else {
 			tracking_state = false;
@@ -405,6 +1400,23 @@ bool TinyA6281::setStateTracking(bool setTo)
 
 }
 
+/*
+ ** stateSlot
+ ** Position, in the state ring buffer, of the state for a given driver.
+ ** See the commentary in sendPacket(): driver N is at (head + N) % num_drivers.
+ */
+DriverNum TinyA6281::stateSlot(DriverNum driver_index)
+{
+	// head + index may overflow DriverNum, so wrap without adding them.
+	DriverNum to_end = num_drivers - state_vector_head_idx;
+	if (driver_index < to_end)
+	{
+		return state_vector_head_idx + driver_index;
+	}
+
+	return driver_index - to_end;
+}
+
 StatePacket * TinyA6281::getState(DriverNum driver_index)
 {
 	if (driver_index >= num_drivers || ! state_vector)
@@ -412,8 +1424,202 @@ StatePacket * TinyA6281::getState(DriverNum driver_index)
 		return NULL;
 	}
 
-	return &(state_vector[driver_index]);
+	return &(state_vector[stateSlot(driver_index)]);
+
+}
+
+bool TinyA6281::setState(DriverNum driver_index, StatePacket packet)
+{
+	StatePacket * slot = getState(driver_index);
+	if (! slot)
+	{
+		return false;
+	}
+
+	TA6281_TRACKLIT(*slot, packet);
+	TA6281_TRACKPOWER(*slot, packet);
+	*slot = packet;
+	return true;
+}
+
+/*
+ ** setBlackoutDetection
+ ** Blank the chain through ~enable, rather than shifting, while all black.
+ */
+bool TinyA6281::setBlackoutDetection(bool setTo)
+{
+	if (! (using_nEnable && tracking_state && state_vector))
+	{
+		setTo = false;
+	}
+
+	blackout_detection = setTo;
+
+	if (! blackout_detection && blacked_out)
+	{
+		// bring the chain back up to date, and out of the dark
+		blacked_out = false;
+		refresh();
+		setEnabled(user_enabled);
+	}
+
+	return blackout_detection;
+}
+
+/*
+ ** setPowerLimit
+ ** Keep the chain's estimated current within budget_ma.
+ */
+bool TinyA6281::setPowerLimit(unsigned long budget_ma, unsigned int channel_ma)
+{
+	if (! (tracking_state && state_vector))
+	{
+		return false;
+	}
+
+	power_budget_ma = channel_ma ? budget_ma : 0;
+	power_channel_ma = channel_ma;
+
+	// apply it to what's displayed now
+	uint8_t applied = appliedScale();
+	power_scale = powerScaleNeeded();
+	if (appliedScale() != applied)
+	{
+		sendCorrection();
+	}
+
+	return true;
+}
+
+/*
+ ** powerLoad
+ ** Weighted sum of the tracked PWM values, with the dot-correction scaled
+ ** by mult / 128 (see scaledCommand()).
+ */
+unsigned long TinyA6281::powerLoad(uint16_t mult)
+{
+	A6281Packet peak = command_map ? correction_peak : command_base;
+	uint8_t dc[3] = {(uint8_t) peak.dotCorrect0, (uint8_t) peak.dotCorrect1,
+			(uint8_t) peak.dotCorrect2};
+	unsigned long load = 0;
+
+	for (uint8_t ch = 0; ch < 3; ch++)
+	{
+		unsigned long scaled = ((uint16_t) dc[ch] * mult) >> 7;
+		unsigned long weight = TA6281_CORRECTION_FLOOR
+				+ (scaled * (TA6281_CORRECTION_MAXVALUE - TA6281_CORRECTION_FLOOR))
+						/ TA6281_CORRECTION_MAXVALUE;
+		load += (pwm_sum[ch] >> TA6281_POWER_SHIFT) * weight;
+	}
+
+	return load;
+}
+
+/*
+ ** powerScaleNeeded
+ ** Highest correction scale that keeps the tracked state within budget.
+ */
+uint8_t TinyA6281::powerScaleNeeded()
+{
+	if (! (power_budget_ma && tracking_state && state_vector))
+	{
+		return TA6281_CORRECTION_MAXVALUE;
+	}
+
+	// the budget, in load units
+	unsigned long budget = (power_budget_ma / power_channel_ma) * TA6281_POWER_FULLSCALE
+			+ ((power_budget_ma % power_channel_ma) * TA6281_POWER_FULLSCALE) / power_channel_ma;
+	if (budget > TA6281_POWER_MAXLOAD)
+	{
+		budget = TA6281_POWER_MAXLOAD;
+	}
+
+	unsigned long full = powerLoad(TA6281_CORRECTION_MAXVALUE + 1);
+	if (full <= budget)
+	{
+		return TA6281_CORRECTION_MAXVALUE;
+	}
+
+	unsigned long lowest = powerLoad(1);
+	if (budget <= lowest)
+	{
+		// as low as it goes, and still over
+		return 0;
+	}
+
+	// the load grows (near enough) linearly with the scale, and rounding
+	// may leave it a step or so over
+	uint16_t mult = ((budget - lowest) << 7) / (full - lowest);
+	while (mult > 1 && powerLoad(mult) > budget)
+	{
+		mult--;
+	}
+
+	return mult ? mult - 1 : 0;
+}
+
+/*
+ ** powerEstimate
+ ** Current the tracked state draws at the dot-correction in use, in mA.
+ */
+unsigned long TinyA6281::powerEstimate()
+{
+	if (! (tracking_state && state_vector))
+	{
+		return 0;
+	}
+
+	unsigned long load = powerLoad(appliedScale() + 1);
+
+	return (load / TA6281_POWER_FULLSCALE) * power_channel_ma
+			+ ((load % TA6281_POWER_FULLSCALE) * power_channel_ma) / TA6281_POWER_FULLSCALE;
+}
+
+/*
+ ** shiftState
+ ** Shift the tracked state of every driver out, without latching.
+ */
+void TinyA6281::shiftState()
+{
+	if (! (tracking_state && state_vector))
+	{
+		return;
+	}
+
+	for (DriverNum i=0; i<num_drivers; i++)
+	{
+		// the state of the last driver always sits just before the head of
+		// the ring and, since sending it moves the head back one slot, it is
+		// stored right back where we read it.
+		DriverNum last_idx = (state_vector_head_idx ? state_vector_head_idx : num_drivers) - 1;
+		sendPacket( state_vector[last_idx] );
+	}
+}
+
+DriverNum TinyA6281::refresh(bool with_correction)
+{
+	if (! (tracking_state && state_vector))
+	{
+		return 0;
+	}
+
+	if (with_correction)
+	{
+		// the state goes back in after the commands anyway
+		return correctionPass(true);
+	}
+
+	bool tmpUpdate = auto_update_cycle;
+
+	auto_update_cycle = false; // disable auto-updates
+	beginUpdate();
+
+	shiftState();
+
+	DriverNum numSent = endUpdate();
+	auto_update_cycle = tmpUpdate;
 
+	return numSent;
 }
 
 DriverNum TinyA6281::saveState(StatePacket * a_state_vector)
@@ -468,9 +1674,10 @@ void TinyA6281::restoreState(StatePacket * a_state_vector)
 	beginUpdate();
 
 
-	for (DriverNum i=num_drivers-1; i>=0; i--)
+	// count down from num_drivers, as DriverNum is unsigned (i >= 0 never ends)
+	for (DriverNum i=num_drivers; i > 0; i--)
 	{
-		sendPacket( a_state_vector[i] );
+		sendPacket( a_state_vector[i - 1] );
 	}
 
 	endUpdate();
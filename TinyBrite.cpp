@@ -37,7 +37,7 @@
 	packet.clockMode = clockMode; \
 	packet.mode_correct = TA6281_MODE_CORRECT;
 
-TinyBrite::TinyBrite(uint8_t num_brites, bool auto_updates) :
+TinyBrite::TinyBrite(DriverNum num_brites, bool auto_updates) :
 		TinyA6281(num_brites, auto_updates) {
 }
 
@@ -62,19 +62,40 @@ BritePacket TinyBrite::commandPacket(unsigned int redCorrect,
 #define CREATE_TA6281PACKET_FROM_MEGABRITEPACKET(ta_packet_name, mb_packet) \
 	A6281Packet ta_packet_name = {value:mb_packet.value};
 
-void TinyBrite::sendPacket(BritePacket packet, uint8_t num_times) {
+void TinyBrite::sendPacket(BritePacket packet, DriverNum num_times) {
 	CREATE_TA6281PACKET_FROM_MEGABRITEPACKET(ta_packet, packet);
 
 	TinyA6281::sendPacket (ta_packet, num_times);
 
 }
 
-void TinyBrite::sendPackets(BritePacket * packets, uint8_t numPackets) {
+void TinyBrite::sendPackets(BritePacket * packets, DriverNum numPackets) {
 
 	TinyA6281::sendPackets((A6281Packet *) packets, numPackets);
 
 }
 
+bool TinyBrite::compileFrame(const BritePacket * packets, DriverNum numPackets,
+		BriteCompiledFrame & frame, uint8_t format) {
+
+	return TinyA6281::compileFrame((const A6281Packet *) packets, numPackets,
+			frame, format);
+
+}
+
+void TinyBrite::compileFlashFrame(const uint8_t * flash_bytes,
+		DriverNum numPackets, BriteCompiledFrame & frame) {
+
+	TinyA6281::compileFlashFrame(flash_bytes, numPackets, frame);
+
+}
+
+void TinyBrite::sendPackets(const BriteCompiledFrame & frame) {
+
+	TinyA6281::sendPackets(frame);
+
+}
+
 void TinyBrite::sendPacketToAll(BritePacket packet) {
 
 	CREATE_TA6281PACKET_FROM_MEGABRITEPACKET(ta_packet, packet);
@@ -96,11 +117,113 @@ void TinyBrite::sendCommand(unsigned int redDotCorrect,
 		unsigned int greenDotCorrect, unsigned int blueDotCorrect,
 		unsigned char clockMode) {
 
-	BritePacket mpacket = {value:0};
-	TMB_SETCOMMANDPACKET(mpacket, redDotCorrect, greenDotCorrect,
-			blueDotCorrect, clockMode);
+	// green, red, blue: see the BritePacket layout
+	TinyA6281::sendCommand(greenDotCorrect, redDotCorrect, blueDotCorrect,
+			clockMode);
 
-	sendPacket (mpacket);
+}
+
+/*
+ ** sendGradient
+ ** The device furthest from the uC goes out first, so the stops are
+ ** walked backwards, each segment stepping from its far stop towards
+ ** its near one.
+ */
+void TinyBrite::sendGradient(const BriteGradientStop * stops, uint8_t numStops,
+		DriverNum count) {
+	if (!(numStops && count)) {
+		return;
+	}
+
+	bool tmpUpdate = false;
+	if (autoUpdate() && !latchCoalescing()) {
+		// a single latch for the lot
+		tmpUpdate = true;
+		setAutoUpdate(false);
+		beginUpdate();
+	}
+
+	// devices [0, remaining) are still to be sent
+	DriverNum remaining = count;
+
+	const BriteGradientStop * last = &(stops[numStops - 1]);
+	if (last->position < remaining - 1) {
+		sendPacket(colorPacket(last->red, last->green, last->blue),
+				remaining - 1 - last->position);
+		remaining = last->position + 1;
+	}
+
+	for (uint8_t s = numStops - 1; s > 0; s--) {
+		const BriteGradientStop & near = stops[s - 1];
+		const BriteGradientStop & far = stops[s];
+
+		if (far.position <= near.position || near.position >= remaining - 1) {
+			// nothing in between, or all of it past the end
+			continue;
+		}
+
+		DriverNum span = far.position - near.position;
+		DriverNum first = (far.position < remaining - 1) ? far.position : remaining - 1;
+
+		long nearColor[3] = {(long) near.red, (long) near.green, (long) near.blue};
+		long farColor[3] = {(long) far.red, (long) far.green, (long) far.blue};
+		long step[3];
+		long acc[3];
+		for (uint8_t c = 0; c < 3; c++) {
+			step[c] = ((farColor[c] - nearColor[c]) * 65536L) / span;
+			acc[c] = (nearColor[c] * 65536L) + 0x8000
+					+ step[c] * (long) (first - near.position);
+		}
+
+		// down to (but not including) the near stop: the next segment, or
+		// the leading fill, sends it
+		for (DriverNum i = first; i > near.position; i--) {
+			sendPacket(colorPacket(acc[0] >> 16, acc[1] >> 16, acc[2] >> 16));
+			acc[0] -= step[0];
+			acc[1] -= step[1];
+			acc[2] -= step[2];
+		}
+
+		remaining = near.position + 1;
+	}
+
+	// the first stop, and anything before it
+	sendPacket(colorPacket(stops[0].red, stops[0].green, stops[0].blue),
+			remaining);
+
+	if (tmpUpdate) {
+		endUpdate();
+		setAutoUpdate(true);
+	}
+}
+
+void TinyBrite::sendRamp(TinyBriteColorValue fromRed,
+		TinyBriteColorValue fromGreen, TinyBriteColorValue fromBlue,
+		TinyBriteColorValue toRed, TinyBriteColorValue toGreen,
+		TinyBriteColorValue toBlue, DriverNum count) {
+
+	if (!count) {
+		return;
+	}
+
+	BriteGradientStop stops[2] = {
+			{0, fromRed, fromGreen, fromBlue},
+			{(DriverNum) (count - 1), toRed, toGreen, toBlue}
+	};
+	sendGradient(stops, 2, count);
+
+}
+
+void TinyBrite::sendFill(TinyBriteColorValue red, TinyBriteColorValue green,
+		TinyBriteColorValue blue, DriverNum count) {
+
+	if (count) {
+		sendPacket(colorPacket(red, green, blue), count);
+	}
+
+}
 
+void TinyBrite::setGlobalBrightness(uint8_t level) {
+	setCorrectionScale(level);
 }
 
@@ -125,6 +125,14 @@
  // Finally, you can manage the auto-update cycle handling any time using the
  // autoUpdate() (read) and setAutoUpdate(bool) methods.
 
+ // Auto-updating a whole chain means a latch for every colour sent.  To have a
+ // burst of sends latched once, when they stop coming, set a quiet interval (us):
+
+ brite_chain.setLatchCoalescing(500);
+ brite_chain.sendColor(0, 0, TINYBRITE_COLOR_MAXVALUE);
+ brite_chain.sendColor(TINYBRITE_COLOR_MAXVALUE, 0, 0);
+ brite_chain.flush(); // latch now, or call poll() regularly, rather than delay()
+
  Enjoy,
  Pat Deegan, psychogenic.com
 */
@@ -140,6 +148,7 @@
 #define TINYBRITE_COLOR_MAXVALUE		TA6281_PWM_MAXVALUE
 
 #define TINYBRITE_CORRECTION_MAXVALUE	TA6281_CORRECTION_MAXVALUE
+#define TINYBRITE_BRIGHTNESS_MAXVALUE	TA6281_CORRECTION_MAXVALUE
 #define TINYBRITE_COMMAND_CLOCK_800kHz	TA6281_COMMAND_CLOCK_800kHz
 #define TINYBRITE_COMMAND_CLOCK_400kHz	TA6281_COMMAND_CLOCK_400kHz
 #define TINYBRITE_COMMAND_CLOCK_200kHz	TA6281_COMMAND_CLOCK_200kHz
@@ -162,7 +171,7 @@
  ** In fact, you can completely forget them altogether if you use sendColor()/sendCommand() instead.
  */
 typedef union BritePacket {
-	unsigned long value;
+	uint32_t value;
 
 	struct {
 		unsigned green :10;
@@ -203,6 +212,31 @@ typedef union BritePacket {
  ** See TinyA6281.h and Examples -> TinyBrite -> BriteChain for details.
  */
 typedef unsigned int	TinyBriteColorValue;
+typedef A6281CompiledFrame	BriteCompiledFrame;
+
+/*
+ ** TINYBRITE_PACKED_COLOR
+ ** A colour packet as the 4 bytes of a packed frame, for flash frames
+ ** (see compileFlashFrame()), e.g.
+ **  const uint8_t alarm[] TINYBRITE_FLASH = {
+ **      TINYBRITE_PACKED_COLOR(1023, 0, 0), TINYBRITE_PACKED_COLOR(0, 0, 0)
+ **  };
+ ** Values aren't clamped: keep them to TINYBRITE_COLOR_MAXVALUE.
+ */
+#define TINYBRITE_PACKED_COLOR(red, green, blue) \
+	TA6281_PACKED_PACKET(((uint32_t) (blue) << 20) | ((uint32_t) (red) << 10) \
+			| (uint32_t) (green))
+
+/*
+ ** BriteGradientStop
+ ** A colour at a given position in a gradient (see sendGradient()).
+ */
+typedef struct BriteGradientStop {
+	DriverNum position;
+	TinyBriteColorValue red;
+	TinyBriteColorValue green;
+	TinyBriteColorValue blue;
+} BriteGradientStop;
 
 class TinyBrite: public TinyA6281
 
@@ -214,7 +248,7 @@ public:
 	 ** TinyBrite constructor.
 	 ** Call with the number of *Brites chained together.
 	 */
-	TinyBrite(uint8_t num_brites = 1, bool auto_update_cycle =
+	TinyBrite(DriverNum num_brites = 1, bool auto_update_cycle =
 			TINYBRITE_AUTOUPDATE_DISABLE);
 
 	/*  SETUP (method from base class)
@@ -250,13 +284,27 @@ public:
 	 ** sendPacket
 	 ** Send a packet of data to our chain of 'brites.
 	 */
-	void sendPacket(BritePacket packet, uint8_t num_times = 1);
+	void sendPacket(BritePacket packet, DriverNum num_times = 1);
 
 	/*
 	 ** sendPackets
 	 ** Send all the packets in an array to our chain of 'brites.
 	 */
-	void sendPackets(BritePacket * packets, uint8_t numPackets);
+	void sendPackets(BritePacket * packets, DriverNum numPackets);
+
+	/*
+	 ** compileFrame / compileFlashFrame / sendPackets(compiled frame)
+	 ** Compile packets once, for frames that are sent again and again,
+	 ** and send them with no per-bit work.  See TinyA6281.h for the
+	 ** formats and what each costs in RAM: flash frames, built with
+	 ** TINYBRITE_PACKED_COLOR(), cost none.
+	 */
+	bool compileFrame(const BritePacket * packets, DriverNum numPackets,
+			BriteCompiledFrame & frame,
+			uint8_t format = TA6281_COMPILE_STATES);
+	void compileFlashFrame(const uint8_t * flash_bytes, DriverNum numPackets,
+			BriteCompiledFrame & frame);
+	void sendPackets(const BriteCompiledFrame & frame);
 
 	/*
 	 ** sendPacketToAll
@@ -277,6 +325,65 @@ public:
 	void sendCommand(unsigned int redDotCorrect, unsigned int greenDotCorrect,
 			unsigned int blueDotCorrect, unsigned char clockMode);
 
+	/*
+	 ** Gradients and fills.
+	 ** These send count colour packets, computed as they go out (there's
+	 ** no frame buffer involved), so count devices from the uC take them
+	 ** once latched.  Like any other send, use them within an update
+	 ** cycle, along with other sends, or on their own with auto-update.
+	 **
+	 ** Colours are interpolated in 16.16 fixed point, a step per device,
+	 ** so the only divisions are one per stop and colour.
+	 */
+
+	/*
+	 ** sendGradient
+	 ** Send a gradient through numStops stops, in order of position (0 is
+	 ** the device closest to the uC).  Devices before the first stop take
+	 ** its colour, and those after the last one take that one's, e.g.
+
+	 BriteGradientStop sunset[] = {
+		 {0, 1023, 400, 0},
+		 {20, 800, 0, 200},
+		 {49, 0, 0, 300}
+	 };
+	 brite_chain.sendGradient(sunset, 3, 50);
+
+	 */
+	void sendGradient(const BriteGradientStop * stops, uint8_t numStops,
+			DriverNum count);
+
+	/*
+	 ** sendRamp
+	 ** Send a gradient from one colour (closest to the uC) to another.
+	 */
+	void sendRamp(TinyBriteColorValue fromRed, TinyBriteColorValue fromGreen,
+			TinyBriteColorValue fromBlue, TinyBriteColorValue toRed,
+			TinyBriteColorValue toGreen, TinyBriteColorValue toBlue,
+			DriverNum count);
+
+	/*
+	 ** sendFill
+	 ** Send the same colour count times.
+	 */
+	void sendFill(TinyBriteColorValue red, TinyBriteColorValue green,
+			TinyBriteColorValue blue, DriverNum count);
+
+	/*
+	 ** setGlobalBrightness
+	 ** Dim (or restore) the whole chain, from 0 to TINYBRITE_BRIGHTNESS_MAXVALUE,
+	 ** using the A6281 dot-correction registers: a single command pass
+	 ** and latch, no change to colours (or tracked state) and the clock
+	 ** mode of the last sendCommand() is kept.  If a calibration is set
+	 ** (see TinyBriteCalibration.h) each device's own values are scaled.
+	 **
+	 ** Must not be called within an update cycle.  Note that the A6281
+	 ** dot-correction range doesn't go all the way to off (see the
+	 ** datasheet), so use colours to fade to black.
+	 */
+	void setGlobalBrightness(uint8_t level);
+	uint8_t globalBrightness() { return correctionScale(); }
+
 };
 
 #endif
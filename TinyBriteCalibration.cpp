@@ -0,0 +1,153 @@
+/*
+
+ TinyBriteCalibration.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of per-device calibration maps.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteCalibration.h for details.
+ */
+
+#include "TinyBriteCalibration.h"
+
+TinyBriteCalibration::TinyBriteCalibration(TinyBrite & brite_chain) :
+		chain(brite_chain), num_devices(0), packets(NULL) {
+
+}
+
+TinyBriteCalibration::~TinyBriteCalibration() {
+	if (packets && chain.correctionMap() == (const A6281Packet *) packets) {
+		chain.setCorrectionMap(NULL, 0);
+	}
+	free(packets);
+}
+
+bool TinyBriteCalibration::begin() {
+	if (packets) {
+		return true;
+	}
+
+	num_devices = chain.numDrivers();
+	if (!num_devices) {
+		return false;
+	}
+
+	packets = (BritePacket*) malloc(sizeof(BritePacket) * num_devices);
+	if (!packets) {
+		return false;
+	}
+
+	for (DriverNum i = 0; i < num_devices; i++) {
+		packets[i] = TinyBrite::commandPacket(TINYBRITE_CORRECTION_MAXVALUE,
+				TINYBRITE_CORRECTION_MAXVALUE, TINYBRITE_CORRECTION_MAXVALUE,
+				TINYBRITE_COMMAND_CLOCK_800kHz);
+	}
+
+	// BritePacket and A6281Packet share their layout
+	chain.setCorrectionMap((const A6281Packet *) packets, num_devices);
+
+	return true;
+}
+
+void TinyBriteCalibration::set(DriverNum index, unsigned int redDotCorrect,
+		unsigned int greenDotCorrect, unsigned int blueDotCorrect,
+		unsigned char clockMode) {
+	if (!packets || index >= num_devices) {
+		return;
+	}
+
+	packets[index] = TinyBrite::commandPacket(redDotCorrect, greenDotCorrect,
+			blueDotCorrect, clockMode);
+}
+
+BritePacket TinyBriteCalibration::get(DriverNum index) {
+	if (!packets || index >= num_devices) {
+		BritePacket nothing = {value:0};
+		return nothing;
+	}
+
+	return packets[index];
+}
+
+void TinyBriteCalibration::setEntry(DriverNum index, const uint8_t * entry) {
+	set(index, entry[0], entry[1], entry[2], entry[3]);
+}
+
+bool TinyBriteCalibration::loadFromFlash(const uint8_t * table) {
+	if (!packets) {
+		return false;
+	}
+
+	uint8_t entry[TINYBRITE_CALIBRATION_ENTRY_SIZE];
+	for (DriverNum i = 0; i < num_devices; i++) {
+		MCU::flashRead(entry, table, TINYBRITE_CALIBRATION_ENTRY_SIZE);
+		setEntry(i, entry);
+		table += TINYBRITE_CALIBRATION_ENTRY_SIZE;
+	}
+
+	return true;
+}
+
+bool TinyBriteCalibration::loadFromEEPROM(unsigned int eeprom_address) {
+	if (!packets) {
+		return false;
+	}
+
+	uint8_t entry[TINYBRITE_CALIBRATION_ENTRY_SIZE];
+	for (DriverNum i = 0; i < num_devices; i++) {
+		if (!MCU::eepromRead(entry, eeprom_address,
+				TINYBRITE_CALIBRATION_ENTRY_SIZE)) {
+			return false;
+		}
+		setEntry(i, entry);
+		eeprom_address += TINYBRITE_CALIBRATION_ENTRY_SIZE;
+	}
+
+	return true;
+}
+
+bool TinyBriteCalibration::saveToEEPROM(unsigned int eeprom_address) {
+	if (!packets) {
+		return false;
+	}
+
+	uint8_t entry[TINYBRITE_CALIBRATION_ENTRY_SIZE];
+	for (DriverNum i = 0; i < num_devices; i++) {
+		entry[0] = packets[i].redDotCorrect;
+		entry[1] = packets[i].greenDotCorrect;
+		entry[2] = packets[i].blueDotCorrect;
+		entry[3] = packets[i].clockMode;
+
+		if (!MCU::eepromWrite(eeprom_address, entry,
+				TINYBRITE_CALIBRATION_ENTRY_SIZE)) {
+			return false;
+		}
+		eeprom_address += TINYBRITE_CALIBRATION_ENTRY_SIZE;
+	}
+
+	return true;
+}
+
+void TinyBriteCalibration::upload() {
+	if (!packets) {
+		return;
+	}
+
+	// make sure we're the map being sent
+	chain.setCorrectionMap((const A6281Packet *) packets, num_devices);
+	chain.sendCorrection();
+}
@@ -0,0 +1,152 @@
+/*
+
+ TinyBriteCalibration.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Per-device dot-correction and clock mode for a chain of 'brites.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ Modules from different batches rarely have the same colour balance.
+ The A6281 dot-correction registers can even this out, but sendCommand()
+ only addresses the head of the chain (or, through setGlobalBrightness(),
+ every device the same way).
+
+ TinyBriteCalibration holds a (red, green, blue) dot-correction and clock
+ mode for each device, and hands them to the chain as its correction map:
+ upload() then sends them all in a single pass of command packets and
+ latches.  Global brightness still applies, on top of the calibration.
+
+ Command packets are kept apart from the tracked PWM state, so saving and
+ restoring scenes never touches the calibration, and uploading it never
+ changes colours.  As the A6281 may drop its command registers on a
+ brown-out, the chain can re-upload automatically every so many latches
+ (see setCorrectionRefresh() in TinyA6281.h).
+
+ Calibrations can be loaded from a table in flash or from EEPROM, where
+ each device takes TINYBRITE_CALIBRATION_ENTRY_SIZE bytes: red, green and
+ blue dot-correction, then clock mode.
+
+ Usage:
+
+ const uint8_t calibration_table[] TINYBRITE_FLASH = {
+	 TINYBRITE_CALIBRATION(127, 110, 120, TINYBRITE_COMMAND_CLOCK_800kHz),
+	 TINYBRITE_CALIBRATION(100, 127, 127, TINYBRITE_COMMAND_CLOCK_800kHz),
+	 TINYBRITE_CALIBRATION(120, 115, 127, TINYBRITE_COMMAND_CLOCK_800kHz)
+ };
+
+ TinyBrite brite_chain(3);
+ TinyBriteCalibration calibration(brite_chain);
+
+ void setup() {
+	 brite_chain.setup(datapin, clockpin, latchpin);
+	 calibration.begin();
+	 calibration.loadFromFlash(calibration_table);
+	 calibration.upload();
+	 brite_chain.setCorrectionRefresh(100); // re-upload every 100 latches
+ }
+
+*/
+
+#ifndef TinyBriteCalibration_h
+#define TinyBriteCalibration_h
+
+#include "TinyBrite.h"
+
+#define TINYBRITE_CALIBRATION_ENTRY_SIZE	4
+
+/* Number of bytes a calibration for num_devices takes in flash or EEPROM */
+#define TINYBRITE_CALIBRATION_STORAGE_SIZE(num_devices) \
+	((num_devices) * TINYBRITE_CALIBRATION_ENTRY_SIZE)
+
+/* A device's entry, in a table of calibrations kept in flash */
+#define TINYBRITE_CALIBRATION(red, green, blue, clockMode) \
+	(red), (green), (blue), (clockMode)
+
+class TinyBriteCalibration
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteCalibration constructor.
+	 ** Call with the chain to calibrate.
+	 */
+	TinyBriteCalibration(TinyBrite & brite_chain);
+	~TinyBriteCalibration();
+
+	/*
+	 ** begin
+	 ** Allocate the calibration (every device at maximum dot-correction,
+	 ** 800kHz internal clock) and make it the chain's correction map.
+	 ** Returns false if out of memory.
+	 */
+	bool begin();
+
+	/*
+	 ** set
+	 ** Set the calibration of a device (0 is closest to the uC).  Use
+	 ** upload() to send it.
+	 */
+	void set(DriverNum index, unsigned int redDotCorrect,
+			unsigned int greenDotCorrect, unsigned int blueDotCorrect,
+			unsigned char clockMode);
+
+	/*
+	 ** get
+	 ** The command packet held for a device.
+	 */
+	BritePacket get(DriverNum index);
+
+	/*
+	 ** loadFromFlash
+	 ** Load the calibration of every device from a TINYBRITE_FLASH table
+	 ** of TINYBRITE_CALIBRATION() entries, in order from the uC.
+	 */
+	bool loadFromFlash(const uint8_t * table);
+
+	/*
+	 ** loadFromEEPROM / saveToEEPROM
+	 ** Load or store the calibration of every device, starting at an EEPROM
+	 ** address.  Return false if the platform has no EEPROM.
+	 */
+	bool loadFromEEPROM(unsigned int eeprom_address);
+	bool saveToEEPROM(unsigned int eeprom_address);
+
+	/*
+	 ** upload
+	 ** Send the calibration to every device in a single pass, and latch.
+	 ** Must not be called within an update cycle.
+	 */
+	void upload();
+
+private:
+
+	void setEntry(DriverNum index, const uint8_t * entry);
+
+	TinyBrite & chain;
+	DriverNum num_devices;
+
+	// command packets, in order from the uC
+	BritePacket * packets;
+
+};
+
+#endif
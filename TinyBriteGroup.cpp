@@ -0,0 +1,129 @@
+/*
+
+ TinyBriteGroup.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of chain groups.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteGroup.h for details.
+ */
+
+#include "TinyBriteGroup.h"
+
+TinyBriteGroup::TinyBriteGroup(uint8_t shift_order) :
+		num_chains(0), order(shift_order) {
+
+}
+
+bool TinyBriteGroup::add(TinyA6281 & chain) {
+	if (num_chains >= TINYBRITE_GROUP_MAXCHAINS) {
+		return false;
+	}
+
+	chains[num_chains++] = &chain;
+	return true;
+}
+
+void TinyBriteGroup::beginUpdate() {
+	for (uint8_t i = 0; i < num_chains; i++) {
+		chains[i]->holdLatch();
+		chains[i]->beginUpdate();
+	}
+}
+
+void TinyBriteGroup::sendPackets(A6281Packet ** frames) {
+	if (order == TINYBRITE_GROUP_ROUNDROBIN) {
+		DriverNum longest = 0;
+		for (uint8_t c = 0; c < num_chains; c++) {
+			if (frames[c] && chains[c]->numDrivers() > longest) {
+				longest = chains[c]->numDrivers();
+			}
+		}
+
+		for (DriverNum i = 0; i < longest; i++) {
+			for (uint8_t c = 0; c < num_chains; c++) {
+				if (frames[c] && i < chains[c]->numDrivers()) {
+					chains[c]->sendPacket(frames[c][i]);
+				}
+			}
+		}
+		return;
+	}
+
+	for (uint8_t c = 0; c < num_chains; c++) {
+		if (frames[c]) {
+			chains[c]->sendPackets(frames[c], chains[c]->numDrivers());
+		}
+	}
+}
+
+/*
+ ** fireLatches
+ ** Set the latch pin of every chain owed a latch, a port at a time where
+ ** possible.
+ */
+void TinyBriteGroup::fireLatches(bool value) {
+	uint8_t ports[TINYBRITE_GROUP_MAXCHAINS];
+	uint8_t masks[TINYBRITE_GROUP_MAXCHAINS];
+	uint8_t numPorts = 0;
+
+	for (uint8_t c = 0; c < num_chains; c++) {
+		TinyA6281 * chain = chains[c];
+		if (!chain->latch_owed) {
+			continue;
+		}
+
+		uint8_t port = MCU::pinPort(chain->pin_latch);
+		if (!port) {
+			MCU::digitalOut(chain->pin_latch, value);
+			continue;
+		}
+
+		uint8_t p = 0;
+		while (p < numPorts && ports[p] != port) {
+			p++;
+		}
+		if (p == numPorts) {
+			ports[numPorts] = port;
+			masks[numPorts++] = 0;
+		}
+		masks[p] |= MCU::pinMask(chain->pin_latch);
+	}
+
+	for (uint8_t p = 0; p < numPorts; p++) {
+		MCU::portOut(ports[p], masks[p], value);
+	}
+}
+
+DriverNum TinyBriteGroup::endUpdate() {
+	DriverNum numSent = 0;
+
+	// shifting is done (each chain's latch is now owed, if it sent anything)
+	for (uint8_t c = 0; c < num_chains; c++) {
+		numSent += chains[c]->endUpdate();
+	}
+
+	fireLatches(HIGH);
+	MCU::delayUs(TA6281_LATCH_DELAY_US);
+	fireLatches(LOW);
+
+	for (uint8_t c = 0; c < num_chains; c++) {
+		chains[c]->latchReleased();
+	}
+
+	return numSent;
+}
@@ -0,0 +1,130 @@
+/*
+
+ TinyBriteGroup.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Updates several chains together, latching them at the same time.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ When chains on different pins are each updated in turn, each latches
+ as soon as its own data is in: a frame shows up on the first chain
+ well before it does on the last, and a fast animation visibly tears
+ across them.
+
+ A TinyBriteGroup holds the latches back until every chain has been
+ shifted, then fires them back to back.  Latch pins on the same port
+ (on AVRs) are switched by a single port write, so they latch together.
+
+ The group's beginUpdate()/endUpdate() work like a single chain's: in
+ between, send to each chain as usual (sendColor(), sendPackets()...)
+ or hand the group a frame per chain with sendPackets(), which shifts
+ them either one chain after the other or a packet per chain in turn
+ (round-robin), so every chain's shift is spread over the whole update.
+
+ Only send PWM data within a group update: dot-correction passes latch
+ on their own (automatic refreshes, see setCorrectionRefresh(), are put
+ off until the group latches).
+
+ Usage:
+
+ TinyBrite left(10), right(10);
+ TinyBriteGroup both;
+
+ void setup() {
+	 left.setup(2, 3, 4);
+	 right.setup(5, 6, 7);  // latches on 4 and 7: the same port on an Uno
+	 both.add(left);
+	 both.add(right);
+ }
+
+ void loop() {
+	 both.beginUpdate();
+	 left.sendColor(...);
+	 right.sendColor(...);
+	 both.endUpdate(); // both latch here
+ }
+
+*/
+
+#ifndef TinyBriteGroup_h
+#define TinyBriteGroup_h
+
+#include "TinyBrite.h"
+
+#define TINYBRITE_GROUP_MAXCHAINS		8
+
+#define TINYBRITE_GROUP_SEQUENTIAL		0
+#define TINYBRITE_GROUP_ROUNDROBIN		1
+
+class TinyBriteGroup
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteGroup constructor.
+	 ** Call with the order in which sendPackets() shifts the chains.
+	 */
+	TinyBriteGroup(uint8_t shift_order = TINYBRITE_GROUP_SEQUENTIAL);
+
+	/*
+	 ** add
+	 ** Add a chain (already set up) to the group.  Returns false if the
+	 ** group is full.
+	 */
+	bool add(TinyA6281 & chain);
+
+	uint8_t numChains() { return num_chains; }
+
+	void setShiftOrder(uint8_t shift_order) { order = shift_order; }
+
+	/*
+	 ** beginUpdate
+	 ** Begin an update cycle on every chain, holding their latches.
+	 */
+	void beginUpdate();
+
+	/*
+	 ** endUpdate
+	 ** End the update cycle, and latch every chain that was sent something,
+	 ** all at once.  Returns the total number of packets sent.
+	 */
+	DriverNum endUpdate();
+
+	/*
+	 ** sendPackets
+	 ** Send a frame to each chain: frames[i] holds one packet per device of
+	 ** the i-th chain added (in the order they are sent), or is NULL to
+	 ** leave that chain alone.
+	 */
+	void sendPackets(A6281Packet ** frames);
+
+private:
+
+	void fireLatches(bool value);
+
+	TinyA6281 * chains[TINYBRITE_GROUP_MAXCHAINS];
+	uint8_t num_chains;
+	uint8_t order;
+
+};
+
+#endif
@@ -0,0 +1,272 @@
+/*
+
+ TinyBriteLayers.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the blended layer stack.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteLayers.h for details.
+ */
+
+#include "TinyBriteLayers.h"
+
+/* Mix from a to b by weight w (0: all a, 256: all b), in fixed point */
+#define TBL_LERP(a, b, w) \
+	(uint16_t)(((uint32_t)(a) * (256 - (w)) + (uint32_t)(b) * (w)) >> 8)
+
+/* Multiply two 10-bit colour values, where 1023 acts as 1.0 */
+#define TBL_MULTIPLY(a, b) \
+	(uint16_t)(((uint32_t)(a) * ((b) + 1)) >> 10)
+
+#define TBL_CLAMP(v) \
+	((v) > TINYBRITE_COLOR_MAXVALUE ? TINYBRITE_COLOR_MAXVALUE : (v))
+
+#define TBL_DIRTY_BYTES(n)	(((n) + 7) / 8)
+
+TinyBriteLayers::TinyBriteLayers(TinyBrite & brite_chain, uint8_t numLayers) :
+		chain(brite_chain), num_layers(numLayers), num_devices(0), pixels(NULL), opacities(
+				NULL), blend_modes(NULL), dirty(NULL), any_dirty(false), frame(NULL) {
+
+}
+
+TinyBriteLayers::~TinyBriteLayers() {
+	free(pixels);
+	free(opacities);
+	free(blend_modes);
+	free(dirty);
+	free(frame);
+}
+
+bool TinyBriteLayers::begin() {
+	if (pixels) {
+		return true;
+	}
+
+	num_devices = chain.numDrivers();
+	if (!num_devices || !num_layers) {
+		return false;
+	}
+
+	pixels = (TinyBriteLayerPixel*) malloc(
+			sizeof(TinyBriteLayerPixel) * num_devices * num_layers);
+	opacities = (uint8_t*) malloc(num_layers);
+	blend_modes = (uint8_t*) malloc(num_layers);
+	dirty = (uint8_t*) malloc(TBL_DIRTY_BYTES(num_devices));
+	frame = (BritePacket*) malloc(sizeof(BritePacket) * num_devices);
+
+	if (!(pixels && opacities && blend_modes && dirty && frame)) {
+		free(pixels);
+		free(opacities);
+		free(blend_modes);
+		free(dirty);
+		free(frame);
+		pixels = NULL;
+		opacities = NULL;
+		blend_modes = NULL;
+		dirty = NULL;
+		frame = NULL;
+		return false;
+	}
+
+	memset(pixels, 0, sizeof(TinyBriteLayerPixel) * num_devices * num_layers);
+	memset(frame, 0, sizeof(BritePacket) * num_devices);
+	memset(opacities, 255, num_layers);
+	memset(blend_modes, TINYBRITE_BLEND_ALPHA, num_layers);
+	blend_modes[0] = TINYBRITE_BLEND_REPLACE;
+
+	// everything needs compositing for the first show()
+	memset(dirty, 0xff, TBL_DIRTY_BYTES(num_devices));
+	any_dirty = true;
+
+	return true;
+}
+
+TinyBriteLayerPixel * TinyBriteLayers::layerPixel(uint8_t layer,
+		DriverNum index) {
+	if (!pixels || layer >= num_layers || index >= num_devices) {
+		return NULL;
+	}
+
+	return &(pixels[(unsigned long) layer * num_devices + index]);
+}
+
+void TinyBriteLayers::markDirty(DriverNum index) {
+	dirty[index >> 3] |= (1 << (index & 7));
+	any_dirty = true;
+}
+
+/*
+ ** markLayerDirty
+ ** A layer-wide setting changed: only the devices this layer actually
+ ** covers (non-zero alpha) can look any different.
+ */
+void TinyBriteLayers::markLayerDirty(uint8_t layer) {
+	TinyBriteLayerPixel * px = layerPixel(layer, 0);
+	if (!px) {
+		return;
+	}
+
+	for (DriverNum i = 0; i < num_devices; i++) {
+		if (px[i].alpha) {
+			markDirty(i);
+		}
+	}
+}
+
+void TinyBriteLayers::setPixel(uint8_t layer, DriverNum index,
+		TinyBriteColorValue red, TinyBriteColorValue green,
+		TinyBriteColorValue blue, uint8_t alpha) {
+	TinyBriteLayerPixel * px = layerPixel(layer, index);
+	if (!px) {
+		return;
+	}
+
+	px->red = TBL_CLAMP(red);
+	px->green = TBL_CLAMP(green);
+	px->blue = TBL_CLAMP(blue);
+	px->alpha = alpha;
+	markDirty(index);
+}
+
+void TinyBriteLayers::clearPixel(uint8_t layer, DriverNum index) {
+	TinyBriteLayerPixel * px = layerPixel(layer, index);
+	if (!px || !px->alpha) {
+		return;
+	}
+
+	px->alpha = TINYBRITE_ALPHA_TRANSPARENT;
+	markDirty(index);
+}
+
+void TinyBriteLayers::fillLayer(uint8_t layer, TinyBriteColorValue red,
+		TinyBriteColorValue green, TinyBriteColorValue blue, uint8_t alpha) {
+	for (DriverNum i = 0; i < num_devices; i++) {
+		setPixel(layer, i, red, green, blue, alpha);
+	}
+}
+
+void TinyBriteLayers::clearLayer(uint8_t layer) {
+	for (DriverNum i = 0; i < num_devices; i++) {
+		clearPixel(layer, i);
+	}
+}
+
+void TinyBriteLayers::setOpacity(uint8_t layer, uint8_t opacity) {
+	if (!opacities || layer >= num_layers || opacities[layer] == opacity) {
+		return;
+	}
+
+	opacities[layer] = opacity;
+	markLayerDirty(layer);
+}
+
+void TinyBriteLayers::setBlendMode(uint8_t layer, uint8_t mode) {
+	if (!blend_modes || layer >= num_layers || blend_modes[layer] == mode) {
+		return;
+	}
+
+	blend_modes[layer] = mode;
+	markLayerDirty(layer);
+}
+
+/*
+ ** composite
+ ** Blend all layers, bottom to top, for a single device.
+ */
+BritePacket TinyBriteLayers::composite(DriverNum index) {
+	uint16_t red = 0;
+	uint16_t green = 0;
+	uint16_t blue = 0;
+
+	TinyBriteLayerPixel * px = &(pixels[index]);
+
+	for (uint8_t layer = 0; layer < num_layers; layer++, px += num_devices) {
+		if (!(px->alpha && opacities[layer])) {
+			continue;
+		}
+
+		// combined alpha and opacity, as a weight from 0 to 256
+		uint16_t weight = ((uint16_t) px->alpha * opacities[layer] + 255) >> 8;
+		weight += weight >> 7;
+
+		switch (blend_modes[layer]) {
+		case TINYBRITE_BLEND_REPLACE:
+			// whatever is below is discarded
+			red = ((uint32_t) px->red * weight) >> 8;
+			green = ((uint32_t) px->green * weight) >> 8;
+			blue = ((uint32_t) px->blue * weight) >> 8;
+			break;
+
+		case TINYBRITE_BLEND_ADD:
+			red += ((uint32_t) px->red * weight) >> 8;
+			green += ((uint32_t) px->green * weight) >> 8;
+			blue += ((uint32_t) px->blue * weight) >> 8;
+			red = TBL_CLAMP(red);
+			green = TBL_CLAMP(green);
+			blue = TBL_CLAMP(blue);
+			break;
+
+		case TINYBRITE_BLEND_MULTIPLY:
+			red = TBL_LERP(red, TBL_MULTIPLY(red, px->red), weight);
+			green = TBL_LERP(green, TBL_MULTIPLY(green, px->green), weight);
+			blue = TBL_LERP(blue, TBL_MULTIPLY(blue, px->blue), weight);
+			break;
+
+		case TINYBRITE_BLEND_ALPHA:
+		default:
+			red = TBL_LERP(red, px->red, weight);
+			green = TBL_LERP(green, px->green, weight);
+			blue = TBL_LERP(blue, px->blue, weight);
+			break;
+		}
+	}
+
+	return TinyBrite::colorPacket(red, green, blue);
+}
+
+bool TinyBriteLayers::show(bool force) {
+	if (!frame) {
+		return false;
+	}
+
+	if (!(any_dirty || force)) {
+		return false;
+	}
+
+	if (any_dirty) {
+		for (DriverNum i = 0; i < num_devices; i++) {
+			if (dirty[i >> 3] & (1 << (i & 7))) {
+				// frame is kept in the order it is sent, last device first
+				frame[num_devices - 1 - i] = composite(i);
+			}
+		}
+
+		memset(dirty, 0, TBL_DIRTY_BYTES(num_devices));
+		any_dirty = false;
+	}
+
+	bool tmpUpdate = chain.autoUpdate();
+	chain.setAutoUpdate(false);
+
+	chain.beginUpdate();
+	chain.sendPackets(frame, num_devices);
+	chain.endUpdate();
+
+	chain.setAutoUpdate(tmpUpdate);
+
+	return true;
+}
@@ -0,0 +1,172 @@
+/*
+
+ TinyBriteLayers.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ A stack of blended colour layers over a chain of 'brites.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ TinyBriteLayers lets you keep an ambient scene on one layer and put
+ alerts, cursors or status indicators on layers above it, without
+ recomputing the scene when the overlays change.
+
+ Each layer holds a colour and an alpha (0: transparent, 255: opaque)
+ per device, plus an overall opacity and a blend mode:
+
+   TINYBRITE_BLEND_REPLACE    replaces what's below (faded by alpha)
+   TINYBRITE_BLEND_ALPHA      mixed with what's below, by alpha
+   TINYBRITE_BLEND_ADD        added to what's below (saturating)
+   TINYBRITE_BLEND_MULTIPLY   scales what's below (a filter/mask)
+
+ Layer 0 is the bottom of the stack.  Compositing is done in integer
+ fixed point, and only for the devices touched since the last show():
+ show() then sends the result in a single update cycle.
+
+ Each layer costs 7 bytes per device (8 on 32-bit platforms), so mind
+ your RAM on small chips.
+
+ Usage:
+
+ TinyBrite brite_chain(20);
+ TinyBriteLayers layers(brite_chain, 2);
+
+ void setup() {
+	 brite_chain.setup(datapin, clockpin, latchpin);
+	 layers.begin();
+	 layers.setBlendMode(1, TINYBRITE_BLEND_ALPHA);
+ }
+
+ void loop() {
+	 layers.fillLayer(0, 100, 100, 300);                   // ambient
+	 layers.setPixel(1, 5, TINYBRITE_COLOR_MAXVALUE, 0, 0); // alert
+	 layers.setOpacity(1, pulse);
+	 layers.show();
+ }
+
+*/
+
+#ifndef TinyBriteLayers_h
+#define TinyBriteLayers_h
+
+#include "TinyBrite.h"
+
+#define TINYBRITE_BLEND_REPLACE		0
+#define TINYBRITE_BLEND_ALPHA		1
+#define TINYBRITE_BLEND_ADD			2
+#define TINYBRITE_BLEND_MULTIPLY	3
+
+#define TINYBRITE_ALPHA_OPAQUE		255
+#define TINYBRITE_ALPHA_TRANSPARENT	0
+
+typedef struct TinyBriteLayerPixel {
+	uint16_t red;
+	uint16_t green;
+	uint16_t blue;
+	uint8_t alpha;
+} TinyBriteLayerPixel;
+
+class TinyBriteLayers
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteLayers constructor.
+	 ** Call with the chain and the number of layers.
+	 */
+	TinyBriteLayers(TinyBrite & brite_chain, uint8_t num_layers);
+	~TinyBriteLayers();
+
+	/*
+	 ** begin
+	 ** Allocate the layers (all transparent, opacity 255, alpha blending
+	 ** except for layer 0, which replaces).  Returns false if out of memory.
+	 */
+	bool begin();
+
+	uint8_t numLayers() { return num_layers; }
+
+	/*
+	 ** setPixel
+	 ** Set the colour and alpha of a device on a layer (device 0 is closest
+	 ** to the uC).
+	 */
+	void setPixel(uint8_t layer, DriverNum index, TinyBriteColorValue red,
+			TinyBriteColorValue green, TinyBriteColorValue blue,
+			uint8_t alpha = TINYBRITE_ALPHA_OPAQUE);
+
+	/*
+	 ** clearPixel
+	 ** Make a device transparent on a layer.
+	 */
+	void clearPixel(uint8_t layer, DriverNum index);
+
+	/*
+	 ** fillLayer / clearLayer
+	 ** Set every device of a layer to a colour, or make the layer transparent.
+	 */
+	void fillLayer(uint8_t layer, TinyBriteColorValue red,
+			TinyBriteColorValue green, TinyBriteColorValue blue,
+			uint8_t alpha = TINYBRITE_ALPHA_OPAQUE);
+	void clearLayer(uint8_t layer);
+
+	/*
+	 ** setOpacity
+	 ** Overall opacity of a layer, 0 (invisible) to 255.
+	 */
+	void setOpacity(uint8_t layer, uint8_t opacity);
+
+	/*
+	 ** setBlendMode
+	 ** How a layer combines with those below it (TINYBRITE_BLEND_*).
+	 */
+	void setBlendMode(uint8_t layer, uint8_t mode);
+
+	/*
+	 ** show
+	 ** Composite the devices that changed and, if any did (or force is set),
+	 ** send the chain in a single update cycle.  Returns true if sent.
+	 */
+	bool show(bool force = false);
+
+private:
+
+	TinyBriteLayerPixel * layerPixel(uint8_t layer, DriverNum index);
+	void markDirty(DriverNum index);
+	void markLayerDirty(uint8_t layer);
+	BritePacket composite(DriverNum index);
+
+	TinyBrite & chain;
+	uint8_t num_layers;
+	DriverNum num_devices;
+
+	TinyBriteLayerPixel * pixels;
+	uint8_t * opacities;
+	uint8_t * blend_modes;
+	uint8_t * dirty;
+	bool any_dirty;
+
+	// composited output, in the order it is sent
+	BritePacket * frame;
+
+};
+
+#endif
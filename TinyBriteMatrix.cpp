@@ -0,0 +1,221 @@
+/*
+
+ TinyBriteMatrix.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the 2D matrix layout mapper.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteMatrix.h for details.
+ */
+
+#include "TinyBriteMatrix.h"
+
+TinyBriteMatrix::TinyBriteMatrix(TinyBrite & brite_chain, uint8_t width,
+		uint8_t height, uint8_t wiringPattern, uint8_t rotate) :
+		chain(brite_chain), panel_width(width), panel_height(height), logical_width(
+				width), logical_height(height), wiring(wiringPattern), rotation(
+				rotate), num_pixels(0), index_table(NULL), frame_buffer(NULL) {
+
+	if (rotation == TINYBRITE_MATRIX_ROTATE_90
+			|| rotation == TINYBRITE_MATRIX_ROTATE_270) {
+		logical_width = height;
+		logical_height = width;
+	}
+}
+
+TinyBriteMatrix::~TinyBriteMatrix() {
+	free(index_table);
+	free(frame_buffer);
+}
+
+/*
+ ** physicalIndex
+ ** Chain position (0 closest to the uC) of a pixel on the panel as wired.
+ */
+DriverNum TinyBriteMatrix::physicalIndex(uint8_t px, uint8_t py) {
+	switch (wiring) {
+	case TINYBRITE_MATRIX_SERPENTINE:
+		if (py & 1) {
+			px = panel_width - 1 - px;
+		}
+		return (DriverNum) py * panel_width + px;
+
+	case TINYBRITE_MATRIX_COLUMNMAJOR:
+		return (DriverNum) px * panel_height + py;
+
+	case TINYBRITE_MATRIX_COLUMNSERPENTINE:
+		if (px & 1) {
+			py = panel_height - 1 - py;
+		}
+		return (DriverNum) px * panel_height + py;
+
+	case TINYBRITE_MATRIX_ROWMAJOR:
+	default:
+		return (DriverNum) py * panel_width + px;
+	}
+}
+
+DriverNum TinyBriteMatrix::chainIndex(uint8_t x, uint8_t y) {
+	uint8_t px = x;
+	uint8_t py = y;
+
+	// go from viewer coordinates to the panel, as wired
+	switch (rotation) {
+	case TINYBRITE_MATRIX_ROTATE_90:
+		px = y;
+		py = panel_height - 1 - x;
+		break;
+	case TINYBRITE_MATRIX_ROTATE_180:
+		px = panel_width - 1 - x;
+		py = panel_height - 1 - y;
+		break;
+	case TINYBRITE_MATRIX_ROTATE_270:
+		px = panel_width - 1 - y;
+		py = x;
+		break;
+	default:
+		break;
+	}
+
+	return physicalIndex(px, py);
+}
+
+bool TinyBriteMatrix::begin() {
+	if (index_table) {
+		return true;
+	}
+
+	unsigned long numPixels = (unsigned long) panel_width * panel_height;
+	num_pixels = (DriverNum) numPixels;
+	if (!num_pixels || num_pixels != numPixels
+			|| num_pixels > chain.numDrivers()) {
+		// doesn't fit in a DriverNum (see TinyBriteConfig.h) or in the chain.
+		num_pixels = 0;
+		return false;
+	}
+
+	index_table = (DriverNum*) malloc(sizeof(DriverNum) * num_pixels);
+	frame_buffer = (BritePacket*) malloc(sizeof(BritePacket) * num_pixels);
+	if (!(index_table && frame_buffer)) {
+		free(index_table);
+		free(frame_buffer);
+		index_table = NULL;
+		frame_buffer = NULL;
+		num_pixels = 0;
+		return false;
+	}
+
+	memset(frame_buffer, 0, sizeof(BritePacket) * num_pixels);
+
+	/*
+	 * The frame is kept in the order it is sent: the first packet sent
+	 * winds up furthest down the chain, so chain position N is at
+	 * frame slot (num_pixels - 1 - N).
+	 */
+	DriverNum * entry = index_table;
+	for (uint8_t y = 0; y < logical_height; y++) {
+		for (uint8_t x = 0; x < logical_width; x++) {
+			*entry++ = num_pixels - 1 - chainIndex(x, y);
+		}
+	}
+
+	return true;
+}
+
+void TinyBriteMatrix::setPixel(uint8_t x, uint8_t y, BritePacket packet) {
+	if (!index_table || x >= logical_width || y >= logical_height) {
+		return;
+	}
+
+	frame_buffer[index_table[(DriverNum) y * logical_width + x]] = packet;
+}
+
+void TinyBriteMatrix::setPixel(uint8_t x, uint8_t y, TinyBriteColorValue red,
+		TinyBriteColorValue green, TinyBriteColorValue blue) {
+	setPixel(x, y, TinyBrite::colorPacket(red, green, blue));
+}
+
+BritePacket TinyBriteMatrix::getPixel(uint8_t x, uint8_t y) {
+	if (!index_table || x >= logical_width || y >= logical_height) {
+		BritePacket nothing = {value:0};
+		return nothing;
+	}
+
+	return frame_buffer[index_table[(DriverNum) y * logical_width + x]];
+}
+
+void TinyBriteMatrix::fill(BritePacket packet) {
+	for (DriverNum i = 0; i < num_pixels; i++) {
+		frame_buffer[i] = packet;
+	}
+}
+
+void TinyBriteMatrix::fillRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h,
+		BritePacket packet) {
+	if (!index_table || x >= logical_width || y >= logical_height) {
+		return;
+	}
+
+	// clip
+	if (w > logical_width - x) {
+		w = logical_width - x;
+	}
+	if (h > logical_height - y) {
+		h = logical_height - y;
+	}
+
+	for (uint8_t row = y; row < y + h; row++) {
+		DriverNum * entry = &(index_table[(DriverNum) row * logical_width + x]);
+		for (uint8_t col = 0; col < w; col++) {
+			frame_buffer[*entry++] = packet;
+		}
+	}
+}
+
+void TinyBriteMatrix::blit(uint8_t x, uint8_t y, uint8_t w, uint8_t h,
+		const BritePacket * packets) {
+	if (!index_table || x >= logical_width || y >= logical_height) {
+		return;
+	}
+
+	uint8_t clip_w = (w > logical_width - x) ? logical_width - x : w;
+	uint8_t clip_h = (h > logical_height - y) ? logical_height - y : h;
+
+	for (uint8_t row = 0; row < clip_h; row++) {
+		DriverNum * entry = &(index_table[(DriverNum)(y + row) * logical_width
+				+ x]);
+		const BritePacket * src = &(packets[(unsigned int) row * w]);
+		for (uint8_t col = 0; col < clip_w; col++) {
+			frame_buffer[*entry++] = *src++;
+		}
+	}
+}
+
+void TinyBriteMatrix::show() {
+	if (!frame_buffer) {
+		return;
+	}
+
+	bool tmpUpdate = chain.autoUpdate();
+	chain.setAutoUpdate(false);
+
+	chain.beginUpdate();
+	chain.sendPackets(frame_buffer, num_pixels);
+	chain.endUpdate();
+
+	chain.setAutoUpdate(tmpUpdate);
+}
@@ -0,0 +1,180 @@
+/*
+
+ TinyBriteMatrix.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ 2D (x,y) access to a grid of 'brites wired as a single chain.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ Panels of 'brites are usually wired as one long chain that snakes
+ through the grid.  TinyBriteMatrix works out, once, where each (x,y)
+ lands in the chain and keeps a frame in chain order, so drawing is a
+ table lookup and show() sends the whole frame in a single update cycle.
+
+ Wiring is described from the point of view of the panel as built: the
+ first device in the chain (closest to the uC) is at (0,0), then
+
+   TINYBRITE_MATRIX_ROWMAJOR            every row runs left to right
+   TINYBRITE_MATRIX_SERPENTINE          rows alternate left-to-right, right-to-left
+   TINYBRITE_MATRIX_COLUMNMAJOR         every column runs top to bottom
+   TINYBRITE_MATRIX_COLUMNSERPENTINE    columns alternate down, up
+
+ If the panel is mounted rotated (clockwise, as seen by the viewer), pass
+ one of the TINYBRITE_MATRIX_ROTATE_* values and draw using the viewer's
+ coordinates (width() and height() are swapped for 90 and 270 degree
+ rotations).
+
+ The matrix covers the first width * height devices of the chain.
+
+ Usage:
+
+ TinyBrite brite_chain(8 * 4);
+ TinyBriteMatrix panel(brite_chain, 8, 4, TINYBRITE_MATRIX_SERPENTINE);
+
+ void setup() {
+	 brite_chain.setup(datapin, clockpin, latchpin);
+	 panel.begin(); // allocates the tables, returns false if out of memory
+ }
+
+ void loop() {
+	 panel.fill(TinyBrite::colorPacket(0, 0, 0));
+	 panel.setPixel(x, y, TINYBRITE_COLOR_MAXVALUE, 0, 0);
+	 panel.show();
+ }
+
+*/
+
+#ifndef TinyBriteMatrix_h
+#define TinyBriteMatrix_h
+
+#include "TinyBrite.h"
+
+#define TINYBRITE_MATRIX_ROWMAJOR			0
+#define TINYBRITE_MATRIX_SERPENTINE			1
+#define TINYBRITE_MATRIX_COLUMNMAJOR		2
+#define TINYBRITE_MATRIX_COLUMNSERPENTINE	3
+
+#define TINYBRITE_MATRIX_ROTATE_0			0
+#define TINYBRITE_MATRIX_ROTATE_90			1
+#define TINYBRITE_MATRIX_ROTATE_180			2
+#define TINYBRITE_MATRIX_ROTATE_270			3
+
+class TinyBriteMatrix
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteMatrix constructor.
+	 ** Call with the chain, the panel's width and height as wired, the
+	 ** wiring pattern and the rotation.
+	 */
+	TinyBriteMatrix(TinyBrite & brite_chain, uint8_t panel_width,
+			uint8_t panel_height, uint8_t wiring = TINYBRITE_MATRIX_SERPENTINE,
+			uint8_t rotation = TINYBRITE_MATRIX_ROTATE_0);
+	~TinyBriteMatrix();
+
+	/*
+	 ** begin
+	 ** Allocate and pre-compute the index table and frame.  Returns false
+	 ** if there isn't enough memory (in which case drawing does nothing).
+	 */
+	bool begin();
+
+	/*
+	 ** width/height
+	 ** Dimensions as seen by the viewer, i.e. taking rotation into account.
+	 */
+	uint8_t width() { return logical_width; }
+	uint8_t height() { return logical_height; }
+
+	/*
+	 ** chainIndex
+	 ** The position of (x,y) in the chain, where 0 is closest to the uC.
+	 */
+	DriverNum chainIndex(uint8_t x, uint8_t y);
+
+	/*
+	 ** setPixel
+	 ** Set the colour of a pixel (out of bounds coordinates are ignored).
+	 */
+	void setPixel(uint8_t x, uint8_t y, BritePacket packet);
+	void setPixel(uint8_t x, uint8_t y, TinyBriteColorValue red,
+			TinyBriteColorValue green, TinyBriteColorValue blue);
+
+	/*
+	 ** getPixel
+	 ** Get the colour of a pixel in the frame being drawn.
+	 */
+	BritePacket getPixel(uint8_t x, uint8_t y);
+
+	/*
+	 ** fill
+	 ** Set every pixel to the same colour.
+	 */
+	void fill(BritePacket packet);
+
+	/*
+	 ** fillRect
+	 ** Set every pixel in a rectangle, clipped to the matrix.
+	 */
+	void fillRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h,
+			BritePacket packet);
+
+	/*
+	 ** blit
+	 ** Copy a w * h block of packets (row by row) to (x,y), clipped to the matrix.
+	 */
+	void blit(uint8_t x, uint8_t y, uint8_t w, uint8_t h,
+			const BritePacket * packets);
+
+	/*
+	 ** show
+	 ** Send the frame to the chain in a single update cycle.
+	 */
+	void show();
+
+	/*
+	 ** frame
+	 ** The frame, in the order it is sent to the chain.
+	 */
+	BritePacket * frame() { return frame_buffer; }
+
+private:
+
+	DriverNum physicalIndex(uint8_t px, uint8_t py);
+
+	TinyBrite & chain;
+
+	uint8_t panel_width;
+	uint8_t panel_height;
+	uint8_t logical_width;
+	uint8_t logical_height;
+	uint8_t wiring;
+	uint8_t rotation;
+
+	DriverNum num_pixels;
+	DriverNum * index_table;
+	BritePacket * frame_buffer;
+
+};
+
+#endif
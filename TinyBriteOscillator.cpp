@@ -0,0 +1,152 @@
+/*
+
+ TinyBriteOscillator.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Waveform and easing tables, and the oscillators that read them.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteOscillator.h for details.
+ */
+
+#include "TinyBriteOscillator.h"
+
+/*
+ * Table generation.
+ *
+ * Every entry is computed by the compiler, through constexpr functions
+ * (single expressions, for C++11), so the tables are plain constant data
+ * that can go to flash.  Nothing here is evaluated at run time.
+ */
+
+#define TBO_PI		3.14159265358979323846
+
+/* Position of entry i, from 0 to 1 */
+#define TBO_T(i)	((double) (i) / (TINYBRITE_WAVE_STEPS - 1))
+
+/* sin(x), |x| <= pi, as a Taylor series (16 terms is plenty) */
+constexpr double tboSinSeries(double x2, double term, int n, int left) {
+	return left ? term
+					+ tboSinSeries(x2, -term * x2 / ((2.0 * n) * (2.0 * n + 1)),
+							n + 1, left - 1) : 0.0;
+}
+
+constexpr double tboSin(double x) {
+	return tboSinSeries(x * x, x, 1, 16);
+}
+
+/* e^x for |x| <= 1, as a Taylor series */
+constexpr double tboExpSeries(double x, double term, int n, int left) {
+	return left ? term + tboExpSeries(x, term * x / n, n + 1, left - 1) : 0.0;
+}
+
+constexpr double tboSquare(double x) {
+	return x * x;
+}
+
+/* 2^y for -10 <= y <= 0: e^(y ln 2), from e^(y ln 2 / 16) squared 4 times */
+constexpr double tboPow2(double y) {
+	return tboSquare(tboSquare(tboSquare(tboSquare(
+			tboExpSeries(y * 0.69314718055994530942 / 16.0, 1.0, 1, 16)))));
+}
+
+constexpr double tboCube(double x) {
+	return x * x * x;
+}
+
+/* A value from 0 to 1, in PWM units, rounded */
+constexpr uint16_t tboPWM(double v) {
+	return (uint16_t) (v * TINYBRITE_COLOR_MAXVALUE + 0.5);
+}
+
+/* Sine entries cover a whole period, so i = STEPS would be i = 0 again */
+constexpr uint16_t tboSine(int i) {
+	return tboPWM(0.5 + 0.5 * tboSin((i < TINYBRITE_WAVE_STEPS / 2 ? i : i - TINYBRITE_WAVE_STEPS)
+					* (2.0 * TBO_PI / TINYBRITE_WAVE_STEPS)));
+}
+
+constexpr uint16_t tboTriangle(int i) {
+	return tboPWM(i < TINYBRITE_WAVE_STEPS / 2 ?
+			(double) i / (TINYBRITE_WAVE_STEPS / 2) :
+			(double) (TINYBRITE_WAVE_STEPS - i) / (TINYBRITE_WAVE_STEPS / 2));
+}
+
+constexpr uint16_t tboCubicIn(int i) {
+	return tboPWM(tboCube(TBO_T(i)));
+}
+
+constexpr uint16_t tboCubicOut(int i) {
+	return tboPWM(1.0 - tboCube(1.0 - TBO_T(i)));
+}
+
+constexpr uint16_t tboCubicInOut(int i) {
+	return tboPWM(TBO_T(i) < 0.5 ?
+			4.0 * tboCube(TBO_T(i)) : 1.0 - tboCube(2.0 - 2.0 * TBO_T(i)) / 2.0);
+}
+
+constexpr uint16_t tboExpoIn(int i) {
+	return i ? tboPWM(tboPow2(10.0 * TBO_T(i) - 10.0)) : 0;
+}
+
+constexpr uint16_t tboExpoOut(int i) {
+	return (i < TINYBRITE_WAVE_STEPS - 1) ?
+			tboPWM(1.0 - tboPow2(-10.0 * TBO_T(i))) : TINYBRITE_COLOR_MAXVALUE;
+}
+
+/* f(0), f(1), ... f(255) */
+#define TBO_ENTRIES4(f, i)		f(i), f((i) + 1), f((i) + 2), f((i) + 3)
+#define TBO_ENTRIES16(f, i) \
+	TBO_ENTRIES4(f, i), TBO_ENTRIES4(f, (i) + 4), \
+	TBO_ENTRIES4(f, (i) + 8), TBO_ENTRIES4(f, (i) + 12)
+#define TBO_ENTRIES64(f, i) \
+	TBO_ENTRIES16(f, i), TBO_ENTRIES16(f, (i) + 16), \
+	TBO_ENTRIES16(f, (i) + 32), TBO_ENTRIES16(f, (i) + 48)
+#define TBO_TABLE(f) \
+	{ TBO_ENTRIES64(f, 0), TBO_ENTRIES64(f, 64), \
+	  TBO_ENTRIES64(f, 128), TBO_ENTRIES64(f, 192) }
+
+#if TINYBRITE_WAVE_STEPS != 256 || TINYBRITE_WAVE_PHASESHIFT != 8
+#error "TBO_TABLE() generates 256 entries"
+#endif
+
+static_assert(tboSine(64) == TINYBRITE_COLOR_MAXVALUE && tboSine(192) == 0,
+		"sine table off");
+
+const uint16_t tinybrite_wave_sine[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH =
+		TBO_TABLE(tboSine);
+const uint16_t tinybrite_wave_triangle[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH =
+		TBO_TABLE(tboTriangle);
+const uint16_t tinybrite_ease_cubic_in[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH =
+		TBO_TABLE(tboCubicIn);
+const uint16_t tinybrite_ease_cubic_out[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH =
+		TBO_TABLE(tboCubicOut);
+const uint16_t tinybrite_ease_cubic_inout[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH =
+		TBO_TABLE(tboCubicInOut);
+const uint16_t tinybrite_ease_expo_in[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH =
+		TBO_TABLE(tboExpoIn);
+const uint16_t tinybrite_ease_expo_out[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH =
+		TBO_TABLE(tboExpoOut);
+
+TinyBriteOscillator::TinyBriteOscillator(TinyBriteWaveShape shape,
+		uint16_t increment, uint16_t phase) :
+		table(shape), phase_increment(increment), current_phase(phase) {
+
+}
+
+void TinyBriteOscillator::setPeriod(uint16_t num_steps) {
+	// a period of 1 (or 0) steps doesn't move: 65536 wraps around to 0
+	phase_increment = num_steps ? (uint16_t) (65536UL / num_steps) : 0;
+}
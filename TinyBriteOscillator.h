@@ -0,0 +1,196 @@
+/*
+
+ TinyBriteOscillator.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Waveform and easing tables, and the oscillators that read them.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ Pulses, breathing, waves running down the chain, fades: most effects
+ come down to a sine or an easing curve, evaluated for every device, on
+ every frame.  With sin() or pow() that's far too slow on an AVR.
+
+ The shapes here are tables of TINYBRITE_WAVE_STEPS values, already in
+ PWM units (0 to TINYBRITE_COLOR_MAXVALUE), computed by the compiler and
+ kept in flash:
+
+   TINYBRITE_WAVE_SINE          one period, starting (and ending) at
+                                mid-level, on the way up
+   TINYBRITE_WAVE_TRIANGLE      up from 0 to full, and back down
+   TINYBRITE_EASE_CUBIC_IN      0 to full, starting slow
+   TINYBRITE_EASE_CUBIC_OUT     0 to full, ending slow
+   TINYBRITE_EASE_CUBIC_INOUT   0 to full, slow at both ends
+   TINYBRITE_EASE_EXPO_IN       0 to full, exponentially (2^(10t - 10))
+   TINYBRITE_EASE_EXPO_OUT      0 to full, exponentially (1 - 2^(-10t))
+
+ Each table takes 512 bytes of flash, but only those a sketch uses are
+ linked in (as Arduino builds do, with --gc-sections).
+
+ A TinyBriteOscillator runs through a shape with a 16-bit phase
+ accumulator: a full period is 65536 and each step adds the increment,
+ so getting a value costs a table read and an add, with no multiply,
+ divide or floating point.  Use at() to read a value at some offset
+ from the current phase, e.g. to spread a wave along the chain, and
+ advance() once per frame to move it.
+
+ Usage:
+
+ TinyBrite brite_chain(30);
+ TinyBriteOscillator wave(TINYBRITE_WAVE_SINE);
+
+ void setup() {
+	 brite_chain.setup(datapin, clockpin, latchpin);
+	 wave.setPeriod(120); // a full period every 120 frames
+ }
+
+ void loop() {
+	 uint16_t offset = 0;
+	 brite_chain.beginUpdate();
+	 for (DriverNum i = 0; i < 30; i++) {
+		 brite_chain.sendColor(wave.at(offset), 0, 200);
+		 offset += 4096; // a whole period spread over 16 devices
+	 }
+	 brite_chain.endUpdate();
+	 wave.advance();
+	 delay(20);
+ }
+
+ Easing curves work the same way, and ease() reads one at t, from 0 to
+ TINYBRITE_EASE_MAXVALUE, for a one-off transition.
+
+*/
+
+#ifndef TinyBriteOscillator_h
+#define TinyBriteOscillator_h
+
+#include "TinyBrite.h"
+
+/* Values per table, and how far to shift a phase to index one */
+#define TINYBRITE_WAVE_STEPS			256
+#define TINYBRITE_WAVE_PHASESHIFT		8
+
+#define TINYBRITE_EASE_MAXVALUE			(TINYBRITE_WAVE_STEPS - 1)
+
+/*
+ ** TinyBriteWaveShape
+ ** A shape is its table, in flash, so only the shapes a sketch uses end
+ ** up in its build.
+ */
+typedef const uint16_t * TinyBriteWaveShape;
+
+extern const uint16_t tinybrite_wave_sine[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH;
+extern const uint16_t tinybrite_wave_triangle[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH;
+extern const uint16_t tinybrite_ease_cubic_in[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH;
+extern const uint16_t tinybrite_ease_cubic_out[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH;
+extern const uint16_t tinybrite_ease_cubic_inout[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH;
+extern const uint16_t tinybrite_ease_expo_in[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH;
+extern const uint16_t tinybrite_ease_expo_out[TINYBRITE_WAVE_STEPS] TINYBRITE_FLASH;
+
+#define TINYBRITE_WAVE_SINE				tinybrite_wave_sine
+#define TINYBRITE_WAVE_TRIANGLE			tinybrite_wave_triangle
+#define TINYBRITE_EASE_CUBIC_IN			tinybrite_ease_cubic_in
+#define TINYBRITE_EASE_CUBIC_OUT		tinybrite_ease_cubic_out
+#define TINYBRITE_EASE_CUBIC_INOUT		tinybrite_ease_cubic_inout
+#define TINYBRITE_EASE_EXPO_IN			tinybrite_ease_expo_in
+#define TINYBRITE_EASE_EXPO_OUT			tinybrite_ease_expo_out
+
+class TinyBriteOscillator
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteOscillator constructor.
+	 ** Call with the shape, and optionally the phase increment per step
+	 ** (65536 per period) and the starting phase.
+	 */
+	TinyBriteOscillator(TinyBriteWaveShape shape = TINYBRITE_WAVE_SINE,
+			uint16_t increment = 256, uint16_t phase = 0);
+
+	/*
+	 ** setShape
+	 ** Switch to another shape, keeping the phase.
+	 */
+	void setShape(TinyBriteWaveShape shape) { table = shape; }
+
+	/*
+	 ** setPeriod
+	 ** Set the increment so a full period takes num_steps calls to next()
+	 ** or advance() (as near as 65536 / num_steps allows).
+	 */
+	void setPeriod(uint16_t num_steps);
+
+	void setIncrement(uint16_t increment) { phase_increment = increment; }
+	uint16_t increment() { return phase_increment; }
+
+	void setPhase(uint16_t phase) { current_phase = phase; }
+	uint16_t phase() { return current_phase; }
+
+	/*
+	 ** next
+	 ** The value at the current phase, then step.
+	 */
+	TinyBriteColorValue next() {
+		TinyBriteColorValue value = at(0);
+		current_phase += phase_increment;
+		return value;
+	}
+
+	/*
+	 ** at
+	 ** The value at an offset from the current phase, without stepping.
+	 */
+	TinyBriteColorValue at(uint16_t offset) {
+		return MCU::flashReadWord(table
+				+ ((uint16_t) (current_phase + offset) >> TINYBRITE_WAVE_PHASESHIFT));
+	}
+
+	/*
+	 ** advance
+	 ** Step without reading.
+	 */
+	void advance() { current_phase += phase_increment; }
+
+	/*
+	 ** wave
+	 ** The value of a shape at a given phase.
+	 */
+	static TinyBriteColorValue wave(TinyBriteWaveShape shape, uint16_t phase) {
+		return MCU::flashReadWord(shape + (phase >> TINYBRITE_WAVE_PHASESHIFT));
+	}
+
+	/*
+	 ** ease
+	 ** The value of an easing curve at t, from 0 to TINYBRITE_EASE_MAXVALUE.
+	 */
+	static TinyBriteColorValue ease(TinyBriteWaveShape curve, uint8_t t) {
+		return MCU::flashReadWord(curve + t);
+	}
+
+private:
+
+	TinyBriteWaveShape table;
+	uint16_t phase_increment;
+	uint16_t current_phase;
+
+};
+
+#endif
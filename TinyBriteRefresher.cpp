@@ -0,0 +1,86 @@
+/*
+
+ TinyBriteRefresher.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the idle-time refresh scheduler.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteRefresher.h for details.
+ */
+
+#include "TinyBriteRefresher.h"
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+
+TinyBriteRefresher::TinyBriteRefresher(TinyA6281 & brite_chain,
+		unsigned long idle_interval_ms, bool correction) :
+		chain(brite_chain), interval(idle_interval_ms), include_correction(
+				correction), armed(false), last_activity(0), seen_latches(
+				brite_chain.latchCount()), num_refreshes(0) {
+
+}
+
+bool TinyBriteRefresher::service() {
+	return service(MCU::millis());
+}
+
+bool TinyBriteRefresher::service(unsigned long now_ms) {
+	if (!interval) {
+		return false;
+	}
+
+	if (chain.updatePending() || chain.latchCount() != seen_latches) {
+		// the application is busy, or just displayed something: the chain
+		// is fresh, and we start counting idle time from here.
+		seen_latches = chain.latchCount();
+		last_activity = now_ms;
+		armed = true;
+		return false;
+	}
+
+	if (!armed) {
+		// nothing displayed yet: the tracked state is meaningless
+		return false;
+	}
+
+	if (now_ms - last_activity < interval) {
+		return false;
+	}
+
+	last_activity = now_ms;
+	return refreshNow();
+}
+
+bool TinyBriteRefresher::refreshNow() {
+	if (chain.updatePending() || !chain.stateTracking()) {
+		return false;
+	}
+
+	// the correction is followed by the state, in a single pass
+	bool refreshed = (chain.refresh(include_correction) != 0);
+
+	// our own latches don't count as application activity
+	seen_latches = chain.latchCount();
+
+	if (refreshed) {
+		num_refreshes++;
+	}
+
+	return refreshed;
+}
+
+#endif /* TA6281_STATE_TRACKING_ENABLE */
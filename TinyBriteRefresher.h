@@ -0,0 +1,125 @@
+/*
+
+ TinyBriteRefresher.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Idle-time re-sending of the tracked state, for noisy chains.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ On long cable runs the odd bit error leaves a device showing the wrong
+ colour until the next update, which may be a long time coming when only
+ changes are sent.
+
+ A TinyBriteRefresher re-sends the whole chain, from its tracked state
+ (so state tracking must be on), once the application has displayed
+ something and then been idle for a given interval.  It never interrupts
+ the application: nothing is done while an update is pending (begun, or
+ packets shifted but not yet latched) and any latch by the application
+ restarts the idle interval.
+ Since the devices are latched with the values they should already
+ have, a refresh is invisible unless it fixes something.
+
+ Optionally, the dot-correction (see sendCorrection() and
+ TinyBriteCalibration.h) is re-sent as well.
+
+ A refresh takes as long as a full update (32 clocks per device) so, if
+ you have your own idea of when there's time to spare, call refreshNow().
+
+ Usage:
+
+ TinyBrite brite_chain(20);
+ TinyBriteRefresher refresher(brite_chain, 2000); // after 2s idle
+
+ void setup() {
+	 brite_chain.setup(datapin, clockpin, latchpin);
+	 brite_chain.setStateTracking(true);
+ }
+
+ void loop() {
+	 // ... update the chain, now and then ...
+	 refresher.service();
+ }
+
+*/
+
+#ifndef TinyBriteRefresher_h
+#define TinyBriteRefresher_h
+
+#include "TinyBrite.h"
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+
+class TinyBriteRefresher
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteRefresher constructor.
+	 ** Call with the chain and the idle time, in ms, after which to refresh
+	 ** (0 disables refreshes).
+	 */
+	TinyBriteRefresher(TinyA6281 & chain, unsigned long idle_interval_ms,
+			bool include_correction = false);
+
+	void setInterval(unsigned long idle_interval_ms) { interval = idle_interval_ms; }
+	unsigned long intervalMs() { return interval; }
+
+	void setIncludeCorrection(bool setTo) { include_correction = setTo; }
+
+	/*
+	 ** service
+	 ** Call this often (e.g. on each loop()): refreshes the chain if it's
+	 ** been idle long enough.  Returns true if it did.  The second version
+	 ** takes the current time, in ms, for platforms without MCU::millis().
+	 */
+	bool service();
+	bool service(unsigned long now_ms);
+
+	/*
+	 ** refreshNow
+	 ** Refresh right away, unless an update is pending.  Returns true if
+	 ** the chain was refreshed.
+	 */
+	bool refreshNow();
+
+	/*
+	 ** numRefreshes
+	 ** How many refreshes were done so far.
+	 */
+	uint16_t numRefreshes() { return num_refreshes; }
+
+private:
+
+	TinyA6281 & chain;
+	unsigned long interval;
+	bool include_correction;
+
+	bool armed;
+	unsigned long last_activity;
+	uint16_t seen_latches;
+	uint16_t num_refreshes;
+
+};
+
+#endif /* TA6281_STATE_TRACKING_ENABLE */
+
+#endif
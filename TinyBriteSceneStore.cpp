@@ -0,0 +1,328 @@
+/*
+
+ TinyBriteSceneStore.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the EEPROM scene store.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteSceneStore.h for details.
+ */
+
+#include "TinyBriteSceneStore.h"
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+
+/*
+ * Slot layout (multi-byte values are big-endian):
+ *
+ *  0  sequence number (2)
+ *  2  number of devices (2)
+ *  4  flags (1)
+ *  5  CRC-16/CCITT (2) of bytes 0-4 and the payload
+ *  7  scene: one packet per device, in the order they are sent
+ *     (i.e. last device first), 4 bytes each
+ *  7 + 4N  dot-correction, same order, if TBSS_FLAG_CORRECTION
+ *
+ * The payload is written first and the header last, so a slot that was
+ * being written when the power went fails its CRC.
+ */
+#define TBSS_FLAG_CORRECTION	0x01
+#define TBSS_CRC_OFFSET			5
+
+#define TBSS_CRC_INIT			0xFFFF
+
+static uint16_t tbssCRC(uint16_t crc, const uint8_t * data, uint8_t len) {
+	while (len--) {
+		crc ^= ((uint16_t) *data++) << 8;
+		for (uint8_t i = 0; i < 8; i++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+static void tbssPackPacket(uint8_t * bytes, A6281Packet packet) {
+	uint32_t v = packet.value;
+	bytes[0] = v >> 24;
+	bytes[1] = v >> 16;
+	bytes[2] = v >> 8;
+	bytes[3] = v;
+}
+
+static A6281Packet tbssUnpackPacket(const uint8_t * bytes) {
+	A6281Packet packet = {value:0};
+	packet.value = ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16)
+			| ((uint32_t) bytes[2] << 8) | bytes[3];
+	return packet;
+}
+
+TinyBriteSceneStore::TinyBriteSceneStore(TinyA6281 & brite_chain,
+		unsigned int eeprom_address, uint8_t numSlots) :
+		chain(brite_chain), base_address(eeprom_address), num_slots(numSlots), restore_us(
+				0), first_latch_us(0) {
+
+	if (!num_slots) {
+		num_slots = 1;
+	} else if (num_slots > TINYBRITE_SCENESTORE_MAXSLOTS) {
+		num_slots = TINYBRITE_SCENESTORE_MAXSLOTS;
+	}
+}
+
+unsigned int TinyBriteSceneStore::slotAddress(uint8_t slot) {
+	return base_address
+			+ (unsigned int) slot
+					* TINYBRITE_SCENESTORE_SLOT_SIZE(chain.numDrivers());
+}
+
+/*
+ ** readHeader
+ ** Read a slot's header: false if it can't be read, or isn't for this chain.
+ */
+bool TinyBriteSceneStore::readHeader(uint8_t slot, uint16_t * sequence,
+		uint8_t * flags, uint16_t * crc) {
+	uint8_t header[TINYBRITE_SCENESTORE_HEADER_SIZE];
+
+	if (!MCU::eepromRead(header, slotAddress(slot),
+			TINYBRITE_SCENESTORE_HEADER_SIZE)) {
+		return false;
+	}
+
+	if ((((uint16_t) header[2] << 8) | header[3]) != chain.numDrivers()) {
+		return false;
+	}
+
+	*sequence = ((uint16_t) header[0] << 8) | header[1];
+	*flags = header[4];
+	*crc = ((uint16_t) header[TBSS_CRC_OFFSET] << 8)
+			| header[TBSS_CRC_OFFSET + 1];
+
+	return true;
+}
+
+/*
+ ** checkSlot
+ ** Go over a slot's contents, and compare with its CRC.
+ */
+bool TinyBriteSceneStore::checkSlot(uint8_t slot, uint8_t flags,
+		uint16_t crc) {
+	unsigned int address = slotAddress(slot);
+	uint8_t bytes[TINYBRITE_SCENESTORE_HEADER_SIZE];
+
+	MCU::eepromRead(bytes, address, TBSS_CRC_OFFSET);
+	uint16_t computed = tbssCRC(TBSS_CRC_INIT, bytes, TBSS_CRC_OFFSET);
+
+	// the scene, then the correction: may be more than a DriverNum holds
+	unsigned int numPackets = chain.numDrivers();
+	if (flags & TBSS_FLAG_CORRECTION) {
+		numPackets *= 2;
+	}
+
+	address += TINYBRITE_SCENESTORE_HEADER_SIZE;
+	for (unsigned int i = 0; i < numPackets; i++) {
+		MCU::eepromRead(bytes, address, TINYBRITE_SCENESTORE_PACKET_SIZE);
+		computed = tbssCRC(computed, bytes, TINYBRITE_SCENESTORE_PACKET_SIZE);
+		address += TINYBRITE_SCENESTORE_PACKET_SIZE;
+	}
+
+	return computed == crc;
+}
+
+/*
+ ** findLatest
+ ** The slot holding the newest valid scene, or -1.
+ */
+int8_t TinyBriteSceneStore::findLatest(uint16_t * sequence, uint8_t * flags) {
+	uint16_t rejected = 0;
+
+	for (;;) {
+		int8_t best = -1;
+		uint16_t bestSequence = 0;
+		uint8_t bestFlags = 0;
+		uint16_t bestCRC = 0;
+
+		for (uint8_t slot = 0; slot < num_slots; slot++) {
+			uint16_t seq, crc;
+			uint8_t flg;
+
+			if ((rejected & (1 << slot))
+					|| !readHeader(slot, &seq, &flg, &crc)) {
+				continue;
+			}
+
+			// sequence numbers wrap around: compare the difference
+			if (best < 0 || (int16_t) (seq - bestSequence) > 0) {
+				best = slot;
+				bestSequence = seq;
+				bestFlags = flg;
+				bestCRC = crc;
+			}
+		}
+
+		if (best < 0) {
+			return -1;
+		}
+
+		if (checkSlot(best, bestFlags, bestCRC)) {
+			*sequence = bestSequence;
+			*flags = bestFlags;
+			return best;
+		}
+
+		// corrupt (or half-written): try the next newest
+		rejected |= (1 << best);
+	}
+}
+
+bool TinyBriteSceneStore::hasScene() {
+	uint16_t sequence;
+	uint8_t flags;
+	return findLatest(&sequence, &flags) >= 0;
+}
+
+bool TinyBriteSceneStore::saveScene(bool include_correction) {
+	DriverNum numDrivers = chain.numDrivers();
+
+	if (!(chain.stateTracking() && numDrivers)) {
+		return false;
+	}
+
+	uint16_t sequence = 0;
+	uint8_t flags = 0;
+	int8_t latest = findLatest(&sequence, &flags);
+
+	// spread the writes: always move on to the next slot
+	uint8_t slot = 0;
+	if (latest >= 0) {
+		slot = (latest + 1) % num_slots;
+		sequence++;
+	}
+
+	uint8_t header[TINYBRITE_SCENESTORE_HEADER_SIZE];
+	header[0] = sequence >> 8;
+	header[1] = sequence;
+	header[2] = numDrivers >> 8;
+	header[3] = numDrivers;
+	header[4] = include_correction ? TBSS_FLAG_CORRECTION : 0;
+
+	uint16_t crc = tbssCRC(TBSS_CRC_INIT, header, TBSS_CRC_OFFSET);
+
+	unsigned int address = slotAddress(slot)
+			+ TINYBRITE_SCENESTORE_HEADER_SIZE;
+	uint8_t bytes[TINYBRITE_SCENESTORE_PACKET_SIZE];
+
+	// the scene, last device first
+	for (DriverNum i = numDrivers; i > 0; i--) {
+		tbssPackPacket(bytes, *(chain.getState(i - 1)));
+		crc = tbssCRC(crc, bytes, TINYBRITE_SCENESTORE_PACKET_SIZE);
+
+		if (!MCU::eepromWrite(address, bytes,
+				TINYBRITE_SCENESTORE_PACKET_SIZE)) {
+			return false;
+		}
+		address += TINYBRITE_SCENESTORE_PACKET_SIZE;
+	}
+
+	if (include_correction) {
+		for (DriverNum i = numDrivers; i > 0; i--) {
+			tbssPackPacket(bytes, chain.correctionPacket(i - 1));
+			crc = tbssCRC(crc, bytes, TINYBRITE_SCENESTORE_PACKET_SIZE);
+
+			if (!MCU::eepromWrite(address, bytes,
+					TINYBRITE_SCENESTORE_PACKET_SIZE)) {
+				return false;
+			}
+			address += TINYBRITE_SCENESTORE_PACKET_SIZE;
+		}
+	}
+
+	// header goes last: only now does this slot become the newest
+	header[TBSS_CRC_OFFSET] = crc >> 8;
+	header[TBSS_CRC_OFFSET + 1] = crc;
+
+	return MCU::eepromWrite(slotAddress(slot), header,
+			TINYBRITE_SCENESTORE_HEADER_SIZE);
+}
+
+/*
+ ** streamPackets
+ ** Send a slot's worth of packets straight from EEPROM.
+ */
+DriverNum TinyBriteSceneStore::streamPackets(unsigned int address) {
+	uint8_t bytes[TINYBRITE_SCENESTORE_PACKET_SIZE];
+	DriverNum numDrivers = chain.numDrivers();
+
+	for (DriverNum i = 0; i < numDrivers; i++) {
+		MCU::eepromRead(bytes, address, TINYBRITE_SCENESTORE_PACKET_SIZE);
+		chain.sendPacket(tbssUnpackPacket(bytes));
+		address += TINYBRITE_SCENESTORE_PACKET_SIZE;
+	}
+
+	return numDrivers;
+}
+
+bool TinyBriteSceneStore::restoreLastScene() {
+	unsigned long start = MCU::micros();
+
+	uint16_t sequence;
+	uint8_t flags;
+	int8_t slot = findLatest(&sequence, &flags);
+	if (slot < 0) {
+		return false;
+	}
+
+	unsigned int address = slotAddress(slot) + TINYBRITE_SCENESTORE_HEADER_SIZE;
+
+	bool tmpUpdate = chain.autoUpdate();
+	chain.setAutoUpdate(false);
+
+	if (flags & TBSS_FLAG_CORRECTION) {
+		// dot-correction first, so the scene comes up with the right balance
+		chain.beginUpdate();
+		streamPackets(
+				address
+						+ (unsigned int) chain.numDrivers()
+								* TINYBRITE_SCENESTORE_PACKET_SIZE);
+		chain.endUpdate();
+	}
+
+	chain.beginUpdate();
+	streamPackets(address);
+	chain.endUpdate();
+
+	first_latch_us = MCU::micros();
+	restore_us = first_latch_us - start;
+
+	chain.setAutoUpdate(tmpUpdate);
+
+	return true;
+}
+
+void TinyBriteSceneStore::clear() {
+	for (uint8_t slot = 0; slot < num_slots; slot++) {
+		uint8_t crcByte;
+		unsigned int address = slotAddress(slot) + TBSS_CRC_OFFSET;
+
+		if (!MCU::eepromRead(&crcByte, address, 1)) {
+			return;
+		}
+
+		crcByte ^= 0xFF;
+		MCU::eepromWrite(address, &crcByte, 1);
+	}
+}
+
+#endif /* TA6281_STATE_TRACKING_ENABLE */
@@ -0,0 +1,161 @@
+/*
+
+ TinyBriteSceneStore.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Keeps the last scene in EEPROM, to come back up in it after power loss.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ TinyBriteSceneStore saves the tracked state of the chain (and, unless
+ told otherwise, the dot-correction each device was given) to EEPROM,
+ so fixtures can come back up in their last scene as soon as they are
+ powered.
+
+ EEPROM cells wear out, so scenes aren't always written to the same
+ place: the store is a ring of slots, each save going to the slot after
+ the last one, tagged with a sequence number and a CRC.  The newest slot
+ with a valid CRC is the one restored, so a save interrupted by a power
+ loss just means the previous scene comes back.  Only bytes that changed
+ are actually written.
+
+ restoreLastScene() streams packets straight from EEPROM into the chain
+ (no RAM copy is made, beyond the chain's own tracked state) and latches
+ the dot-correction, then the scene.  Call it first thing in setup():
+ firstLatchUs() then reports when, after power-on, the scene was
+ latched (as measured by MCU::micros(), so it doesn't include any time
+ spent in a bootloader), and restoreTimeUs() how long the restore took.
+
+ The restored dot-correction is what the devices had when saved: set up
+ any TinyBriteCalibration or global brightness afterwards, as usual, so
+ that later correction passes agree.
+
+ Each slot takes TINYBRITE_SCENESTORE_SLOT_SIZE(num_devices) bytes of
+ EEPROM, and at most TINYBRITE_SCENESTORE_MAXSLOTS slots may be used.
+
+ Usage:
+
+ TinyBrite brite_chain(10);
+ TinyBriteSceneStore scenes(brite_chain, 0, 4); // 4 slots from address 0
+
+ void setup() {
+	 brite_chain.setup(datapin, clockpin, latchpin);
+	 brite_chain.setStateTracking(true);
+	 if (! scenes.restoreLastScene()) {
+		 // first boot: show a default scene
+	 }
+ }
+
+ void loop() {
+	 // ... when the scene changes (and not too often!) ...
+	 scenes.saveScene();
+ }
+
+*/
+
+#ifndef TinyBriteSceneStore_h
+#define TinyBriteSceneStore_h
+
+#include "TinyBrite.h"
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+
+#define TINYBRITE_SCENESTORE_MAXSLOTS		16
+
+/* sequence (2), number of devices (2), flags (1), CRC (2) */
+#define TINYBRITE_SCENESTORE_HEADER_SIZE	7
+#define TINYBRITE_SCENESTORE_PACKET_SIZE	4
+
+/* room for the scene and the dot-correction */
+#define TINYBRITE_SCENESTORE_SLOT_SIZE(num_devices) \
+	(TINYBRITE_SCENESTORE_HEADER_SIZE + \
+		(unsigned int) (num_devices) * 2 * TINYBRITE_SCENESTORE_PACKET_SIZE)
+
+#define TINYBRITE_SCENESTORE_SIZE(num_devices, num_slots) \
+	((unsigned int) (num_slots) * TINYBRITE_SCENESTORE_SLOT_SIZE(num_devices))
+
+class TinyBriteSceneStore
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteSceneStore constructor.
+	 ** Call with the chain, the EEPROM address where the store begins and
+	 ** the number of slots to spread writes over.
+	 */
+	TinyBriteSceneStore(TinyA6281 & chain, unsigned int eeprom_address,
+			uint8_t num_slots);
+
+	/*
+	 ** saveScene
+	 ** Save the tracked state and (optionally) the dot-correction of every
+	 ** device to the next slot.  Returns false if there is no EEPROM, or
+	 ** state isn't being tracked.
+	 */
+	bool saveScene(bool include_correction = true);
+
+	/*
+	 ** restoreLastScene
+	 ** Send the newest valid scene to the chain and latch it.  Returns false
+	 ** if there is none (or no EEPROM).  Must not be called within an
+	 ** update cycle.
+	 */
+	bool restoreLastScene();
+
+	/*
+	 ** hasScene
+	 ** Whether a valid scene is stored.
+	 */
+	bool hasScene();
+
+	/*
+	 ** clear
+	 ** Invalidate every slot (one byte written per slot).
+	 */
+	void clear();
+
+	/*
+	 ** Timing of the last restoreLastScene(), in microseconds.
+	 */
+	unsigned long restoreTimeUs() { return restore_us; }
+	unsigned long firstLatchUs() { return first_latch_us; }
+
+private:
+
+	unsigned int slotAddress(uint8_t slot);
+	bool readHeader(uint8_t slot, uint16_t * sequence, uint8_t * flags,
+			uint16_t * crc);
+	bool checkSlot(uint8_t slot, uint8_t flags, uint16_t crc);
+	int8_t findLatest(uint16_t * sequence, uint8_t * flags);
+	DriverNum streamPackets(unsigned int address);
+
+	TinyA6281 & chain;
+	unsigned int base_address;
+	uint8_t num_slots;
+
+	unsigned long restore_us;
+	unsigned long first_latch_us;
+
+};
+
+#endif /* TA6281_STATE_TRACKING_ENABLE */
+
+#endif
@@ -0,0 +1,154 @@
+/*
+
+ TinyBriteScheduler.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the frame-rate scheduler.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteScheduler.h for details.
+ */
+
+#include "TinyBriteScheduler.h"
+
+/* Whether time t has come, allowing for micros() wrapping around */
+#define TBS_REACHED(now, t)		((long)((now) - (t)) >= 0)
+
+/* Fold a sample into a running average (seeded by the first) and a maximum */
+#define TBS_SAMPLE(avg, max, sample) \
+	if (avg) avg = (long) avg + ((long) (sample) - (long) avg) / 8; \
+	else avg = (sample); \
+	if ((sample) > max) max = (sample);
+
+TinyBriteScheduler::TinyBriteScheduler(TinyA6281 & brite_chain,
+		uint8_t frames_per_second, TinyBriteSchedulerCallback render_callback,
+		TinyBriteSchedulerCallback transmit_callback, void * callback_context,
+		uint8_t missed_policy) :
+		chain(brite_chain), render(render_callback), transmit(
+				transmit_callback), context(callback_context), policy(
+				missed_policy), period(0), frame_number(0), deadline(0), last_latch(
+				0), started(false) {
+
+	setFrameRate(frames_per_second);
+	resetStats();
+}
+
+void TinyBriteScheduler::setFrameRate(uint8_t frames_per_second) {
+	period = 1000000UL / (frames_per_second ? frames_per_second : 1);
+}
+
+void TinyBriteScheduler::resetStats() {
+	frame_min = 0;
+	frame_avg = 0;
+	frame_max = 0;
+	jitter_avg = 0;
+	jitter_max = 0;
+	render_avg = 0;
+	render_max = 0;
+	transmit_avg = 0;
+	transmit_max = 0;
+	frames_shown = 0;
+	frames_missed = 0;
+}
+
+void TinyBriteScheduler::begin() {
+	resetStats();
+
+	frame_number = 0;
+	renderFrame();
+
+	// frame 0 is due right away
+	deadline = MCU::micros();
+	last_latch = deadline;
+	started = true;
+}
+
+void TinyBriteScheduler::renderFrame() {
+	unsigned long start = MCU::micros();
+
+	if (render) {
+		render(frame_number, context);
+	}
+
+	unsigned long renderTime = MCU::micros() - start;
+	TBS_SAMPLE(render_avg, render_max, renderTime);
+}
+
+bool TinyBriteScheduler::service() {
+	if (!started) {
+		return false;
+	}
+
+	unsigned long start = MCU::micros();
+
+	// start early enough (with a little margin) for the transmit to be
+	// done by the frame boundary
+	unsigned long lead = transmit_avg + (transmit_avg >> 3);
+	if (!TBS_REACHED(start + lead, deadline)) {
+		return false;
+	}
+
+	bool tmpUpdate = chain.autoUpdate();
+	chain.setAutoUpdate(false);
+
+	chain.beginUpdate();
+	if (transmit) {
+		transmit(frame_number, context);
+	}
+
+	unsigned long transmitTime = MCU::micros() - start;
+	TBS_SAMPLE(transmit_avg, transmit_max, transmitTime);
+
+	// hold the latch until the boundary
+	while (!TBS_REACHED(MCU::micros(), deadline)) {
+	}
+
+	chain.endUpdate();
+	unsigned long latched = MCU::micros();
+
+	chain.setAutoUpdate(tmpUpdate);
+
+	unsigned long late = latched - deadline;
+	TBS_SAMPLE(jitter_avg, jitter_max, late);
+
+	if (frames_shown) {
+		unsigned long frameTime = latched - last_latch;
+		TBS_SAMPLE(frame_avg, frame_max, frameTime);
+		if (!frame_min || frameTime < frame_min) {
+			frame_min = frameTime;
+		}
+	}
+	last_latch = latched;
+	frames_shown++;
+
+	// on to the next frame, taking any we overran into account
+	unsigned long missed = late / period;
+	frames_missed += missed;
+
+	if (missed && policy == TINYBRITE_SCHEDULER_MERGE) {
+		// start the timeline over from this frame
+		frame_number++;
+		deadline = latched + period;
+	} else {
+		// stay on the timeline, skipping whatever we missed
+		frame_number += missed + 1;
+		deadline += (missed + 1) * period;
+	}
+
+	renderFrame();
+
+	return true;
+}
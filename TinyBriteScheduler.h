@@ -0,0 +1,182 @@
+/*
+
+ TinyBriteScheduler.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Runs animations at a fixed frame rate, with frame timing statistics.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ Pacing an animation with delay() makes its speed depend on the length
+ of the chain and on how long the colours take to compute.
+ TinyBriteScheduler keeps frames on a fixed timeline instead.  Each
+ frame is handled in two steps, each with its own callback:
+
+	 render(frame, context)    compute frame number "frame" (e.g. into
+	                           a buffer), without sending anything
+	 transmit(frame, context)  send it to the chain (sendPackets(),
+	                           matrix.show() with auto-update off...)
+
+ The scheduler wraps transmit() in beginUpdate()/endUpdate(), and starts
+ it early enough (going by how long transmits have been taking) to
+ hold the latch until the frame's boundary.  The next frame is then
+ rendered straight away, while there's time.
+
+ When a frame is late by one or more frame periods, what happens
+ to the frames it overran depends on the policy:
+
+	 TINYBRITE_SCHEDULER_DROP   they are skipped: frame numbers jump, so
+	                            animations stay in step with the clock
+	 TINYBRITE_SCHEDULER_MERGE  they are folded into the late frame: the
+	                            timeline restarts from it and frame numbers
+	                            stay consecutive (animations slow down)
+
+ Timing uses MCU::micros(), and all figures are in microseconds. The
+ averages are running averages, weighted towards recent frames.
+
+ Usage:
+
+ TinyBrite brite_chain(20);
+ BritePacket frame_buffer[20];
+
+ void render(unsigned long frame, void * context) {
+	 // fill frame_buffer for this frame
+ }
+ void transmit(unsigned long frame, void * context) {
+	 brite_chain.sendPackets(frame_buffer, 20);
+ }
+
+ TinyBriteScheduler scheduler(brite_chain, 30, render, transmit);
+
+ void setup() {
+	 brite_chain.setup(datapin, clockpin, latchpin);
+	 scheduler.begin();
+ }
+
+ void loop() {
+	 scheduler.service();
+	 // ... anything else, as long as it's quick ...
+ }
+
+*/
+
+#ifndef TinyBriteScheduler_h
+#define TinyBriteScheduler_h
+
+#include "TinyBrite.h"
+
+#define TINYBRITE_SCHEDULER_DROP	0
+#define TINYBRITE_SCHEDULER_MERGE	1
+
+typedef void (*TinyBriteSchedulerCallback)(unsigned long frame,
+		void * context);
+
+class TinyBriteScheduler
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteScheduler constructor.
+	 ** Call with the chain, the target frame rate, the render and transmit
+	 ** callbacks (and their context) and the policy for missed frames.
+	 */
+	TinyBriteScheduler(TinyA6281 & chain, uint8_t frames_per_second,
+			TinyBriteSchedulerCallback render_callback,
+			TinyBriteSchedulerCallback transmit_callback,
+			void * callback_context = NULL,
+			uint8_t missed_policy = TINYBRITE_SCHEDULER_DROP);
+
+	/*
+	 ** begin
+	 ** Start the timeline: renders frame 0, which is sent on the next
+	 ** service().  Also resets the statistics.
+	 */
+	void begin();
+
+	/*
+	 ** service
+	 ** Call this as often as possible: sends the current frame when its
+	 ** boundary comes up, then renders the next.  Returns true if a frame
+	 ** was latched.
+	 */
+	bool service();
+
+	void setFrameRate(uint8_t frames_per_second);
+	unsigned long framePeriodUs() { return period; }
+	void setPolicy(uint8_t missed_policy) { policy = missed_policy; }
+
+	/*
+	 ** frame
+	 ** The number of the frame to be sent next.
+	 */
+	unsigned long frame() { return frame_number; }
+
+	/*
+	 ** Statistics.
+	 ** Frame time is the time between successive latches, jitter the
+	 ** distance between a latch and its frame boundary.
+	 */
+	unsigned long frameTimeMin() { return frame_min; }
+	unsigned long frameTimeAvg() { return frame_avg; }
+	unsigned long frameTimeMax() { return frame_max; }
+	unsigned long jitterAvg() { return jitter_avg; }
+	unsigned long jitterMax() { return jitter_max; }
+	unsigned long renderTimeAvg() { return render_avg; }
+	unsigned long renderTimeMax() { return render_max; }
+	unsigned long transmitTimeAvg() { return transmit_avg; }
+	unsigned long transmitTimeMax() { return transmit_max; }
+
+	unsigned long framesShown() { return frames_shown; }
+	unsigned long framesMissed() { return frames_missed; }
+
+	void resetStats();
+
+private:
+
+	void renderFrame();
+
+	TinyA6281 & chain;
+	TinyBriteSchedulerCallback render;
+	TinyBriteSchedulerCallback transmit;
+	void * context;
+	uint8_t policy;
+
+	unsigned long period;
+	unsigned long frame_number;
+	unsigned long deadline;
+	unsigned long last_latch;
+	bool started;
+
+	unsigned long frame_min;
+	unsigned long frame_avg;
+	unsigned long frame_max;
+	unsigned long jitter_avg;
+	unsigned long jitter_max;
+	unsigned long render_avg;
+	unsigned long render_max;
+	unsigned long transmit_avg;
+	unsigned long transmit_max;
+	unsigned long frames_shown;
+	unsigned long frames_missed;
+
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*
+
+ TinyBriteSegment.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of chain segments and their compositor.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteSegment.h for details.
+ */
+
+#include "TinyBriteSegment.h"
+
+/*
+ * The compositor's frame is kept in the order it is sent, so the first
+ * device of the chain is the *last* slot of the frame.  Each segment
+ * points at the slot of its own last device, so segment index i is at
+ * pixels[segment_length - 1 - i].
+ */
+#define TBSEG_SLOT(index)	pixels[segment_length - 1 - (index)]
+
+TinyBriteSegment::TinyBriteSegment(DriverNum first_device,
+		DriverNum num_devices, TinyBriteSegmentRender render_callback,
+		void * render_context) :
+		segment_offset(first_device), segment_length(num_devices), render(
+				render_callback), context(render_context), needs_render(true), has_changed(
+				false), pixels(NULL), next(NULL) {
+
+}
+
+void TinyBriteSegment::setPixel(DriverNum index, BritePacket packet) {
+	if (!pixels || index >= segment_length) {
+		return;
+	}
+
+	TBSEG_SLOT(index) = packet;
+	has_changed = true;
+}
+
+void TinyBriteSegment::setPixel(DriverNum index, TinyBriteColorValue red,
+		TinyBriteColorValue green, TinyBriteColorValue blue) {
+	setPixel(index, TinyBrite::colorPacket(red, green, blue));
+}
+
+BritePacket TinyBriteSegment::getPixel(DriverNum index) {
+	if (!pixels || index >= segment_length) {
+		BritePacket nothing = {value:0};
+		return nothing;
+	}
+
+	return TBSEG_SLOT(index);
+}
+
+void TinyBriteSegment::fill(BritePacket packet) {
+	if (!pixels) {
+		return;
+	}
+
+	for (DriverNum i = 0; i < segment_length; i++) {
+		pixels[i] = packet;
+	}
+	has_changed = true;
+}
+
+TinyBriteCompositor::TinyBriteCompositor(TinyBrite & brite_chain) :
+		chain(brite_chain), frame(NULL), num_devices(0), segments(NULL) {
+
+}
+
+TinyBriteCompositor::~TinyBriteCompositor() {
+	free(frame);
+}
+
+bool TinyBriteCompositor::begin() {
+	if (frame) {
+		return true;
+	}
+
+	if (!chain.numDrivers()) {
+		return false;
+	}
+
+	frame = (BritePacket*) malloc(sizeof(BritePacket) * chain.numDrivers());
+	if (!frame) {
+		return false;
+	}
+
+	// the frame keeps this length, even if the chain is resized
+	num_devices = chain.numDrivers();
+	memset(frame, 0, sizeof(BritePacket) * num_devices);
+	return true;
+}
+
+bool TinyBriteCompositor::addSegment(TinyBriteSegment & segment) {
+	DriverNum numDrivers = num_devices;
+
+	if (!frame || !segment.segment_length || segment.segment_offset >= numDrivers
+			|| segment.segment_length > numDrivers - segment.segment_offset) {
+		return false;
+	}
+
+	for (TinyBriteSegment * seg = segments; seg; seg = seg->next) {
+		if (seg == &segment) {
+			// linking it again would loop the list
+			return false;
+		}
+	}
+
+	segment.pixels = &(frame[numDrivers - segment.segment_offset
+			- segment.segment_length]);
+	segment.needs_render = true;
+
+	segment.next = segments;
+	segments = &segment;
+
+	return true;
+}
+
+bool TinyBriteCompositor::show(bool force) {
+	if (!frame) {
+		return false;
+	}
+
+	bool anyChange = force;
+
+	for (TinyBriteSegment * seg = segments; seg; seg = seg->next) {
+		if (seg->needs_render && seg->render) {
+			seg->render(*seg, seg->context);
+		}
+		seg->needs_render = false;
+
+		if (seg->has_changed) {
+			anyChange = true;
+			seg->has_changed = false;
+		}
+	}
+
+	if (!anyChange) {
+		// nothing new to display
+		return false;
+	}
+
+	bool tmpUpdate = chain.autoUpdate();
+	chain.setAutoUpdate(false);
+
+	chain.beginUpdate();
+	chain.sendPackets(frame, num_devices);
+	chain.endUpdate();
+
+	chain.setAutoUpdate(tmpUpdate);
+
+	return true;
+}
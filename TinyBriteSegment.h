@@ -0,0 +1,190 @@
+/*
+
+ TinyBriteSegment.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Logical segments of a chain, composited and sent in a single pass.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ When different stretches of a chain run different effects, each effect
+ can be given a TinyBriteSegment: a view of (offset, length) devices,
+ indexed from 0 within the segment.  Effects only need to know their own
+ segment and never send anything themselves.
+
+ A TinyBriteCompositor holds the frame for the whole chain, which the
+ segments draw into.  Its show() method:
+	 * calls the render callback of every segment that was invalidated
+	   (segments that weren't are left alone, not re-rendered);
+	 * if anything changed, sends the whole chain in one
+	   beginUpdate()/endUpdate() cycle, so there is a single latch.
+
+ Device offsets count from the uC (offset 0 is the first device).
+
+ Usage:
+
+ void renderPulse(TinyBriteSegment & seg, void * context) {
+	 for (DriverNum i=0; i < seg.length(); i++)
+		 seg.setPixel(i, ...);
+ }
+
+ TinyBrite brite_chain(30);
+ TinyBriteCompositor compositor(brite_chain);
+ TinyBriteSegment left(0, 10, renderPulse);
+ TinyBriteSegment right(10, 20);  // drawn directly with setPixel()
+
+ void setup() {
+	 brite_chain.setup(datapin, clockpin, latchpin);
+	 compositor.begin();
+	 compositor.addSegment(left);
+	 compositor.addSegment(right);
+ }
+
+ void loop() {
+	 left.invalidate();  // re-render the pulse on the next show()
+	 right.setPixel(3, TINYBRITE_COLOR_MAXVALUE, 0, 0);
+	 compositor.show();
+ }
+
+*/
+
+#ifndef TinyBriteSegment_h
+#define TinyBriteSegment_h
+
+#include "TinyBrite.h"
+
+class TinyBriteSegment;
+
+typedef void (*TinyBriteSegmentRender)(TinyBriteSegment & segment,
+		void * context);
+
+class TinyBriteSegment
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteSegment constructor.
+	 ** Call with the position of the first device of the segment, the number
+	 ** of devices and, optionally, a render callback (and its context).
+	 */
+	TinyBriteSegment(DriverNum first_device, DriverNum num_devices,
+			TinyBriteSegmentRender render_callback = NULL,
+			void * render_context = NULL);
+
+	DriverNum offset() { return segment_offset; }
+	DriverNum length() { return segment_length; }
+
+	/*
+	 ** setPixel
+	 ** Set the packet for a device of the segment (0 is the segment's first).
+	 */
+	void setPixel(DriverNum index, BritePacket packet);
+	void setPixel(DriverNum index, TinyBriteColorValue red,
+			TinyBriteColorValue green, TinyBriteColorValue blue);
+
+	/*
+	 ** getPixel
+	 ** The packet currently held for a device of the segment.
+	 */
+	BritePacket getPixel(DriverNum index);
+
+	/*
+	 ** fill
+	 ** Set every device of the segment to the same packet.
+	 */
+	void fill(BritePacket packet);
+
+	/*
+	 ** invalidate
+	 ** Ask for the render callback to be called on the next show().
+	 */
+	void invalidate() { needs_render = true; }
+
+	/*
+	 ** changed
+	 ** Whether the segment was drawn into since it was last sent.
+	 */
+	bool changed() { return has_changed; }
+
+private:
+
+	friend class TinyBriteCompositor;
+
+	DriverNum segment_offset;
+	DriverNum segment_length;
+	TinyBriteSegmentRender render;
+	void * context;
+
+	bool needs_render;
+	bool has_changed;
+
+	// where the segment lives in the compositor's frame (NULL until added)
+	BritePacket * pixels;
+	TinyBriteSegment * next;
+
+};
+
+class TinyBriteCompositor
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteCompositor constructor.
+	 ** Call with the chain the segments belong to.
+	 */
+	TinyBriteCompositor(TinyBrite & brite_chain);
+	~TinyBriteCompositor();
+
+	/*
+	 ** begin
+	 ** Allocate the frame for the whole chain (at its current length, see
+	 ** setNumDrivers()).  Returns false if out of memory.
+	 */
+	bool begin();
+
+	/*
+	 ** addSegment
+	 ** Attach a segment.  Returns false if it doesn't fit within the chain,
+	 ** is already attached (or begin() hasn't succeeded).  Overlapping
+	 ** segments are allowed: the one drawn last wins.
+	 */
+	bool addSegment(TinyBriteSegment & segment);
+
+	/*
+	 ** show
+	 ** Render invalidated segments and, if anything changed (or force is
+	 ** set), send the whole chain in a single update cycle.  Returns true
+	 ** if the chain was updated.
+	 */
+	bool show(bool force = false);
+
+private:
+
+	TinyBrite & chain;
+	BritePacket * frame;
+	DriverNum num_devices;
+	TinyBriteSegment * segments;
+
+};
+
+#endif
@@ -0,0 +1,323 @@
+/*
+
+ TinyBriteSerialSink.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the serial frame sink.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteSerialSink.h and includes/TinyBriteFrameProtocol.h for details.
+ */
+
+#include "TinyBriteSerialSink.h"
+
+/* parser states */
+#define TBSS_STATE_SYNC0		0
+#define TBSS_STATE_SYNC1		1
+#define TBSS_STATE_TYPE			2
+#define TBSS_STATE_LEN_HI		3
+#define TBSS_STATE_LEN_LO		4
+#define TBSS_STATE_PAYLOAD		5
+#define TBSS_STATE_CHECK1		6
+#define TBSS_STATE_CHECK2		7
+
+#define TBSS_ACCUMULATE(aByte) \
+	sum1 += aByte; \
+	sum2 += sum1;
+
+TinyBriteSerialSink::TinyBriteSerialSink(TinyBrite & brite_chain,
+		uint16_t max_delta_entries) :
+		chain(brite_chain), parse_state(TBSS_STATE_SYNC0), frame_type(0), entry_bytes(
+				0), sum1(0), sum2(0), received_sum1(0), saved_auto_update(false), need_keyframe(
+				false), delta_bad_index(false), entry(0), delta_index(0), frame_len(
+				0), num_received(0), frames_latched(0), frames_dropped(0), staged(
+				NULL), staged_size(0) {
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	if (max_delta_entries) {
+		staged = (TinyBriteStagedDelta*) malloc(
+				sizeof(TinyBriteStagedDelta) * max_delta_entries);
+		if (staged) {
+			staged_size = max_delta_entries;
+		}
+	}
+#endif
+}
+
+TinyBriteSerialSink::~TinyBriteSerialSink() {
+	free(staged);
+}
+
+void TinyBriteSerialSink::reset() {
+	if (parse_state >= TBSS_STATE_PAYLOAD) {
+		// we were in the middle of a frame, abandon it.
+		endFrame(false);
+	}
+	parse_state = TBSS_STATE_SYNC0;
+}
+
+uint16_t TinyBriteSerialSink::ingest(const uint8_t * bytes, uint16_t len) {
+	uint16_t numLatched = 0;
+	for (uint16_t i = 0; i < len; i++) {
+		if (ingest(bytes[i])) {
+			numLatched++;
+		}
+	}
+	return numLatched;
+}
+
+bool TinyBriteSerialSink::ingest(uint8_t aByte) {
+
+	switch (parse_state) {
+	case TBSS_STATE_SYNC0:
+		if (aByte == TINYBRITE_FRAME_SYNC0) {
+			parse_state = TBSS_STATE_SYNC1;
+		}
+		break;
+
+	case TBSS_STATE_SYNC1:
+		if (aByte == TINYBRITE_FRAME_SYNC1) {
+			parse_state = TBSS_STATE_TYPE;
+		} else if (aByte != TINYBRITE_FRAME_SYNC0) {
+			parse_state = TBSS_STATE_SYNC0;
+		}
+		break;
+
+	case TBSS_STATE_TYPE:
+		sum1 = 0;
+		sum2 = 0;
+		TBSS_ACCUMULATE(aByte);
+		frame_type = aByte;
+		parse_state = TBSS_STATE_LEN_HI;
+		break;
+
+	case TBSS_STATE_LEN_HI:
+		TBSS_ACCUMULATE(aByte);
+		frame_len = aByte;
+		parse_state = TBSS_STATE_LEN_LO;
+		break;
+
+	case TBSS_STATE_LEN_LO:
+		TBSS_ACCUMULATE(aByte);
+		frame_len = (frame_len << 8) | aByte;
+
+		if (!frameAcceptable()) {
+			// not something we can handle, go back to looking for a header
+			frames_dropped++;
+			parse_state = TBSS_STATE_SYNC0;
+			break;
+		}
+
+		beginFrame();
+		parse_state = TBSS_STATE_PAYLOAD;
+		break;
+
+	case TBSS_STATE_PAYLOAD:
+		TBSS_ACCUMULATE(aByte);
+		entry_bytes++;
+
+		if (frame_type == TINYBRITE_FRAME_TYPE_DELTA
+				&& entry_bytes <= TINYBRITE_FRAME_INDEX_SIZE) {
+			// leading bytes of a delta entry are the device index
+			delta_index = (delta_index << 8) | aByte;
+			break;
+		}
+
+		entry = (entry << 8) | aByte;
+		if (entry_bytes < entrySize()) {
+			break;
+		}
+
+		if (frame_type == TINYBRITE_FRAME_TYPE_DELTA) {
+			stageDelta();
+		} else {
+			// we have a complete entry: shift it out right away
+			chain.sendPacket(entryPacket());
+		}
+		entry = 0;
+		entry_bytes = 0;
+		delta_index = 0;
+
+		if (++num_received >= frame_len) {
+			parse_state = TBSS_STATE_CHECK1;
+		}
+		break;
+
+	case TBSS_STATE_CHECK1:
+		received_sum1 = aByte;
+		parse_state = TBSS_STATE_CHECK2;
+		break;
+
+	case TBSS_STATE_CHECK2:
+	{
+		parse_state = TBSS_STATE_SYNC0;
+		return endFrame(received_sum1 == sum1 && aByte == sum2);
+	}
+
+	default:
+		parse_state = TBSS_STATE_SYNC0;
+		break;
+	}
+
+	return false;
+
+}
+
+/*
+ ** beginFrame
+ ** Start an update cycle for the incoming frame.  Auto-updates are suspended
+ ** for the duration, as we only want to latch once the frame is complete.
+ */
+void TinyBriteSerialSink::beginFrame() {
+	saved_auto_update = chain.autoUpdate();
+	chain.setAutoUpdate(false);
+
+	if (frame_type == TINYBRITE_FRAME_TYPE_FULL) {
+		chain.beginUpdate();
+	}
+
+	entry = 0;
+	entry_bytes = 0;
+	delta_index = 0;
+	delta_bad_index = false;
+	num_received = 0;
+}
+
+/*
+ ** frameAcceptable
+ ** Called once the header has arrived: checks we can handle this frame.
+ */
+bool TinyBriteSerialSink::frameAcceptable() {
+	if (!frame_len || frame_len > chain.numDrivers()) {
+		return false;
+	}
+
+	if (frame_type == TINYBRITE_FRAME_TYPE_FULL) {
+		return true;
+	}
+
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	if (frame_type == TINYBRITE_FRAME_TYPE_DELTA) {
+		// deltas are applied to the tracked state, and are useless
+		// until we've seen a keyframe since the last error.
+		if (!(chain.stateTracking() && !need_keyframe)) {
+			return false;
+		}
+		if (frame_len > staged_size) {
+			// too many changes to stage: the deltas that follow would
+			// build on the ones we skip
+			need_keyframe = true;
+			return false;
+		}
+		return true;
+	}
+#endif
+
+	return false;
+}
+
+uint8_t TinyBriteSerialSink::entrySize() {
+	return (frame_type == TINYBRITE_FRAME_TYPE_DELTA) ?
+			TINYBRITE_FRAME_DELTA_ENTRY_SIZE : TINYBRITE_FRAME_ENTRY_SIZE;
+}
+
+BritePacket TinyBriteSerialSink::entryPacket() {
+	return TinyBrite::colorPacket(
+			(entry >> TINYBRITE_FRAME_ENTRY_RED_SHIFT)
+					& TINYBRITE_FRAME_ENTRY_COLORMASK,
+			(entry >> TINYBRITE_FRAME_ENTRY_GREEN_SHIFT)
+					& TINYBRITE_FRAME_ENTRY_COLORMASK,
+			(entry >> TINYBRITE_FRAME_ENTRY_BLUE_SHIFT)
+					& TINYBRITE_FRAME_ENTRY_COLORMASK);
+}
+
+/*
+ ** stageDelta
+ ** Keep a delta entry until the frame is complete and verified: neither
+ ** the chain nor its tracked state change until then.
+ **
+ ** Indices are frame positions (0 is furthest from the uC), whereas
+ ** tracked state is indexed from the uC, hence the flip.
+ */
+void TinyBriteSerialSink::stageDelta() {
+	if (delta_index >= chain.numDrivers()) {
+		delta_bad_index = true;
+		return;
+	}
+
+	// frameAcceptable() made sure there's room for frame_len entries
+	staged[num_received].index = chain.numDrivers() - 1 - delta_index;
+	staged[num_received].packet = entryPacket();
+}
+
+/*
+ ** applyDeltas
+ ** Put the staged entries of a verified delta in the tracked state.
+ */
+void TinyBriteSerialSink::applyDeltas() {
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	for (DriverNum i = 0; i < num_received; i++) {
+		StatePacket state = {value:staged[i].packet.value};
+		chain.setState(staged[i].index, state);
+	}
+#endif
+}
+
+/*
+ ** endFrame
+ ** Latch the frame if it was valid.  If not, the data sitting in the
+ ** shift registers is simply never latched, so nothing visible changes.
+ ** Returns whether the frame was latched.
+ */
+bool TinyBriteSerialSink::endFrame(bool valid) {
+	if (frame_type == TINYBRITE_FRAME_TYPE_DELTA) {
+		valid = valid && !delta_bad_index;
+	}
+
+	if (valid) {
+		if (frame_type == TINYBRITE_FRAME_TYPE_DELTA) {
+#ifdef TA6281_STATE_TRACKING_ENABLE
+			// the tracked state now holds the complete frame: one pass
+			applyDeltas();
+			chain.refresh();
+#endif
+		} else {
+			chain.endUpdate();
+			if (num_received >= chain.numDrivers()) {
+				// a full frame for the whole chain is a keyframe
+				need_keyframe = false;
+			}
+		}
+		frames_latched++;
+	} else {
+		// a full frame's packets, as they were shifted in, may already be
+		// in the tracked state, and the sender's next deltas build on this
+		// frame, whatever it was: wait for the next keyframe.
+#ifdef TA6281_STATE_TRACKING_ENABLE
+		if (chain.stateTracking()) {
+			need_keyframe = true;
+		}
+#endif
+		if (frame_type == TINYBRITE_FRAME_TYPE_FULL) {
+			// don't leave the chain looking busy (e.g. to a refresher)
+			chain.abortUpdate();
+		}
+		frames_dropped++;
+	}
+
+	chain.setAutoUpdate(saved_auto_update);
+	return valid;
+}
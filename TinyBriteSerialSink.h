@@ -0,0 +1,190 @@
+/*
+
+ TinyBriteSerialSink.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Streams frames received over a serial link straight into a chain.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ When a PC (or other host) drives the chain, you don't need to buffer
+ a whole frame before sending it.  The TinyBriteSerialSink parses the
+ framed protocol described in includes/TinyBriteFrameProtocol.h and
+ shifts each device's packet out as soon as its 4 bytes have arrived,
+ so transmission to the chain overlaps with reception.
+
+ The data is only latched once the complete frame has arrived and its
+ checksum matches.  Corrupt frames are dropped without a latch, so the
+ 'brites keep displaying the last good frame.
+
+ Delta frames, carrying only the devices that changed, are supported
+ when state tracking is on (see setStateTracking()): the changes are
+ staged as they arrive and, once the checksum matches, applied to the
+ tracked state and the whole chain is re-sent in a single pass.  Up to
+ max_delta_entries changes (see the constructor) can be staged: larger
+ deltas are dropped, so have the sender keep under that (see
+ TinyBriteFrameEncoder::setMaxDeltaEntries()).  The host side encoder is
+ in host/TinyBriteFrameEncoder.h.
+
+ With state tracking on, a dropped full frame may have left its data in
+ the tracked state, and the sender's next deltas build on any dropped
+ frame, so deltas are refused until the next keyframe (a full frame for
+ the whole chain).  Until then, needKeyframe() is true: hold off anything
+ that re-sends the tracked state, such as a TinyBriteRefresher.
+
+ Usage:
+
+ TinyBrite brite_chain(20);
+ TinyBriteSerialSink sink(brite_chain);
+
+ void setup() {
+	 Serial.begin(115200);
+	 brite_chain.setup(datapin, clockpin, latchpin);
+ }
+
+ void loop() {
+	 sink.poll(Serial);
+ }
+
+ Anything that provides available() and read() may be passed to poll()
+ and you may also feed bytes directly with ingest(), e.g. from a file
+ descriptor on a Linux host.
+
+ host/TinyBriteSinkCheck.cpp does that, through a pseudo-terminal, to
+ check the sink against host/TinyBriteFrameEncoder's output.
+
+*/
+
+#ifndef TinyBriteSerialSink_h
+#define TinyBriteSerialSink_h
+
+#include "TinyBrite.h"
+#include "includes/TinyBriteFrameProtocol.h"
+
+/* delta entries staged until their frame's checksum is in, by default */
+#define TINYBRITE_SINK_DEFAULT_DELTA_ENTRIES	16
+
+typedef struct TinyBriteStagedDelta {
+	DriverNum index;
+	BritePacket packet;
+} TinyBriteStagedDelta;
+
+class TinyBriteSerialSink
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteSerialSink constructor.
+	 ** Call with the chain the frames are destined for and, optionally, the
+	 ** most changes a delta frame may carry (each takes 6 bytes of RAM, on
+	 ** an AVR, with state tracking on).
+	 */
+	TinyBriteSerialSink(TinyBrite & brite_chain, uint16_t max_delta_entries =
+			TINYBRITE_SINK_DEFAULT_DELTA_ENTRIES);
+	~TinyBriteSerialSink();
+
+	/*
+	 ** ingest
+	 ** Process one received byte.  Returns true if this byte completed a
+	 ** valid frame (which has now been latched).
+	 */
+	bool ingest(uint8_t aByte);
+
+	/*
+	 ** ingest
+	 ** Process a buffer of received bytes.  Returns the number of frames
+	 ** latched.
+	 */
+	uint16_t ingest(const uint8_t * bytes, uint16_t len);
+
+	/*
+	 ** poll
+	 ** Consume every byte currently available on a Stream-like source
+	 ** (anything with available() and read(), like Serial).  Returns
+	 ** the number of frames latched.
+	 */
+	template<class STREAM> uint16_t poll(STREAM & source) {
+		uint16_t numLatched = 0;
+		while (source.available() > 0) {
+			if (ingest((uint8_t) source.read())) {
+				numLatched++;
+			}
+		}
+		return numLatched;
+	}
+
+	/*
+	 ** reset
+	 ** Abandon any partially received frame and wait for the next header.
+	 */
+	void reset();
+
+	/*
+	 ** framesLatched / framesDropped
+	 ** Counters of valid frames sent to the chain, and of frames rejected
+	 ** (bad header or checksum).
+	 */
+	uint16_t framesLatched() { return frames_latched; }
+	uint16_t framesDropped() { return frames_dropped; }
+
+	/*
+	 ** needKeyframe
+	 ** True after a dropped frame, with state tracking on, until the next
+	 ** keyframe: the tracked state can't be trusted meanwhile.
+	 */
+	bool needKeyframe() { return need_keyframe; }
+
+private:
+
+	void beginFrame();
+	bool endFrame(bool valid);
+	bool frameAcceptable();
+	uint8_t entrySize();
+	BritePacket entryPacket();
+	void stageDelta();
+	void applyDeltas();
+
+	TinyBrite & chain;
+
+	uint8_t parse_state;
+	uint8_t frame_type;
+	uint8_t entry_bytes;
+	uint8_t sum1;
+	uint8_t sum2;
+	uint8_t received_sum1;
+	bool saved_auto_update;
+	bool need_keyframe;
+	bool delta_bad_index;
+
+	unsigned long entry;
+	uint16_t delta_index;
+	uint16_t frame_len; // full 16-bit length from the header, checked against the chain
+	DriverNum num_received;
+
+	uint16_t frames_latched;
+	uint16_t frames_dropped;
+
+	TinyBriteStagedDelta * staged;
+	uint16_t staged_size;
+
+};
+
+#endif
@@ -0,0 +1,334 @@
+/*
+
+ TinyBriteChainCheck.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Checks long chains (past 255 devices) packet by packet, on the host.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ Runs sendPacketToAll(), sendPackets(), the tracked state accessors
+ (getState(), setState(), saveState()), restoreState() and refresh() on
+ chains of 256, 1000 and 4096 devices (or the lengths given), sending to
+ a file, then reads back every packet that went out and checks it, and
+ the tracked state, against what the chain should hold.  Build, from the
+ library directory, with:
+
+	g++ -O2 -DTINYBRITE_PLATFORM_LINUX -I. -o tinybrite-chaincheck *.cpp \
+		host/TinyBriteLinuxTransport.cpp host/TinyBriteChainCheck.cpp
+
+ and run:
+
+	./tinybrite-chaincheck
+	./tinybrite-chaincheck -n 600 -n 65535
+
+ It exits with 0 if everything matched, and 2 otherwise.
+
+ Options:
+	-n DEVICES  check a chain of this length (repeatable; default 256,
+	            1000 and 4096)
+	-o PATH     scratch file for the packets (default: a temporary file)
+
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "TinyBrite.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+#define TBCC_MAXLENGTHS		16
+
+/* failures reported per step, before just counting them */
+#define TBCC_MAXREPORTS		4
+
+static unsigned long tbccFailures = 0;
+
+/*
+ ** ChainCheck
+ ** A chain sending to a file, and what we've read back from it.
+ */
+typedef struct ChainCheck {
+	TinyBrite * chain;
+	DriverNum num_devices;
+	int read_fd;
+	uint32_t * sent;
+	unsigned long num_sent;
+	unsigned long reports;
+} ChainCheck;
+
+static void fail(ChainCheck & check, const char * step, unsigned long index,
+		uint32_t got, uint32_t expected) {
+	tbccFailures++;
+	if (check.reports++ < TBCC_MAXREPORTS) {
+		fprintf(stderr, "%u devices, %s: #%lu is 0x%08x, not 0x%08x\n",
+				check.num_devices, step, index, got, expected);
+	}
+}
+
+/*
+ ** readSent
+ ** Read back whatever went out since the last call, as packets.
+ */
+static void readSent(ChainCheck & check) {
+	uint8_t bytes[4];
+	check.num_sent = 0;
+
+	while (read(check.read_fd, bytes, sizeof(bytes)) == sizeof(bytes)) {
+		if (check.num_sent < 2UL * check.num_devices) {
+			check.sent[check.num_sent] = ((uint32_t) bytes[0] << 24)
+					| ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8)
+					| bytes[3];
+		}
+		check.num_sent++;
+	}
+}
+
+/*
+ ** expectSent
+ ** What went out must be exactly the given packets, in order (or the
+ ** same one num_devices times, if repeat).
+ */
+static void expectSent(ChainCheck & check, const char * step,
+		const A6281Packet * packets, bool repeat) {
+	readSent(check);
+
+	if (check.num_sent != check.num_devices) {
+		tbccFailures++;
+		fprintf(stderr, "%u devices, %s: %lu packets sent\n",
+				check.num_devices, step, check.num_sent);
+		return;
+	}
+
+	for (DriverNum i = 0; i < check.num_devices; i++) {
+		uint32_t expected = packets[repeat ? 0 : i].value;
+		if (check.sent[i] != expected) {
+			fail(check, step, i, check.sent[i], expected);
+		}
+	}
+}
+
+/*
+ ** expectState
+ ** The tracked state must be what was sent: device 0, closest to the uC,
+ ** got the last packet.
+ */
+static void expectState(ChainCheck & check, const char * step,
+		const A6281Packet * packets, bool repeat) {
+	for (DriverNum i = 0; i < check.num_devices; i++) {
+		StatePacket * state = check.chain->getState(i);
+		uint32_t expected =
+				packets[repeat ? 0 : check.num_devices - 1 - i].value;
+		if (!state) {
+			fail(check, step, i, 0, expected);
+		} else if (state->value != expected) {
+			fail(check, step, i, state->value, expected);
+		}
+	}
+}
+
+static bool checkChain(DriverNum numDevices, const char * path) {
+	unsigned long failuresBefore = tbccFailures;
+	TinyBriteLinuxTransport & transport = TinyBriteLinuxTransport::instance();
+
+	if (!transport.openFile(path)) {
+		perror(path);
+		return false;
+	}
+
+	ChainCheck check;
+	check.num_devices = numDevices;
+	check.reports = 0;
+	check.read_fd = open(path, O_RDONLY);
+	check.sent = (uint32_t *) malloc(sizeof(uint32_t) * 2 * numDevices);
+
+	A6281Packet * frame = (A6281Packet *) malloc(
+			sizeof(A6281Packet) * numDevices);
+	StatePacket * saved = (StatePacket *) malloc(
+			sizeof(StatePacket) * numDevices);
+
+	if (check.read_fd < 0 || !(check.sent && frame && saved)) {
+		perror("setup");
+		transport.close();
+		return false;
+	}
+
+	TinyBrite chain(numDevices);
+	check.chain = &chain;
+	chain.setup(0, 0, 25);
+	chain.setAutoUpdate(false);
+	if (!chain.setStateTracking(true)) {
+		fprintf(stderr, "%u devices: can't track state\n", numDevices);
+		tbccFailures++;
+	}
+	// setup() may have sent commands: start from here
+	readSent(check);
+
+	// the same packet, to every device (used to stop at 255)
+	BritePacket all = TinyBrite::colorPacket(100, 200, 300);
+	A6281Packet allPacket = {value:all.value};
+	chain.beginUpdate();
+	chain.sendPacketToAll(all);
+	chain.endUpdate();
+	expectSent(check, "sendPacketToAll", &allPacket, true);
+	expectState(check, "state after sendPacketToAll", &allPacket, true);
+
+	// a different packet for each device, past any 8-bit index
+	for (DriverNum i = 0; i < numDevices; i++) {
+		BritePacket packet = TinyBrite::colorPacket(
+				i & TINYBRITE_COLOR_MAXVALUE, (i >> 10) & TINYBRITE_COLOR_MAXVALUE,
+				(i * 7) & TINYBRITE_COLOR_MAXVALUE);
+		frame[i].value = packet.value;
+	}
+	chain.beginUpdate();
+	chain.sendPackets((BritePacket *) frame, numDevices);
+	chain.endUpdate();
+	expectSent(check, "sendPackets", frame, false);
+	expectState(check, "state after sendPackets", frame, false);
+
+	// saveState() gives the state from the uC: the frame, backwards
+	if (chain.saveState(saved) != numDevices) {
+		fprintf(stderr, "%u devices: saveState() saved too little\n",
+				numDevices);
+		tbccFailures++;
+	}
+	for (DriverNum i = 0; i < numDevices; i++) {
+		if (saved[i].value != frame[numDevices - 1 - i].value) {
+			fail(check, "saveState", i, saved[i].value,
+					frame[numDevices - 1 - i].value);
+		}
+	}
+
+	// wipe it, then put it back: restoreState() sends the last device first
+	chain.beginUpdate();
+	chain.sendPacketToAll(all);
+	chain.endUpdate();
+	readSent(check);
+
+	chain.restoreState(saved);
+	expectSent(check, "restoreState", frame, false);
+	expectState(check, "state after restoreState", frame, false);
+
+	// change the far end through setState(), and refresh() it out
+	DriverNum last = numDevices - 1;
+	BritePacket far = TinyBrite::colorPacket(1, 2, 3);
+	StatePacket farState = {value:far.value};
+	frame[0].value = far.value;
+	if (!chain.setState(last, farState) || chain.setState(numDevices,
+			farState)) {
+		fprintf(stderr, "%u devices: setState() bounds are wrong\n",
+				numDevices);
+		tbccFailures++;
+	}
+	if (chain.getState(numDevices)) {
+		fprintf(stderr, "%u devices: getState() bounds are wrong\n",
+				numDevices);
+		tbccFailures++;
+	}
+	if (chain.refresh() != numDevices) {
+		fprintf(stderr, "%u devices: refresh() sent too little\n", numDevices);
+		tbccFailures++;
+	}
+	expectSent(check, "refresh", frame, false);
+
+	if (transport.errors()) {
+		fprintf(stderr, "%u devices: %lu transport errors\n", numDevices,
+				transport.errors());
+		tbccFailures++;
+	}
+
+	transport.close();
+	close(check.read_fd);
+	free(check.sent);
+	free(frame);
+	free(saved);
+
+	bool ok = (tbccFailures == failuresBefore);
+	printf("%5u devices: %s\n", numDevices, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+static void usage(const char * name) {
+	fprintf(stderr, "usage: %s [-n DEVICES]... [-o PATH]\n", name);
+}
+
+int main(int argc, char * argv[]) {
+	unsigned long lengths[TBCC_MAXLENGTHS];
+	uint8_t numLengths = 0;
+	const char * path = NULL;
+	char tempPath[] = "/tmp/tinybrite-chaincheck-XXXXXX";
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:o:")) != -1) {
+		switch (opt) {
+		case 'n':
+			if (numLengths == TBCC_MAXLENGTHS) {
+				usage(argv[0]);
+				return 1;
+			}
+			lengths[numLengths++] = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!numLengths) {
+		lengths[numLengths++] = 256;
+		lengths[numLengths++] = 1000;
+		lengths[numLengths++] = 4096;
+	}
+
+	for (uint8_t i = 0; i < numLengths; i++) {
+		if (!lengths[i] || lengths[i] > (DriverNum) ~0) {
+			fprintf(stderr, "%lu devices: not a DriverNum\n", lengths[i]);
+			return 1;
+		}
+	}
+
+	if (!path) {
+		int fd = mkstemp(tempPath);
+		if (fd < 0) {
+			perror(tempPath);
+			return 1;
+		}
+		close(fd);
+		path = tempPath;
+	}
+
+	for (uint8_t i = 0; i < numLengths; i++) {
+		checkChain(lengths[i], path);
+	}
+
+	if (path == tempPath) {
+		unlink(tempPath);
+	}
+
+	if (tbccFailures) {
+		printf("%lu failures\n", tbccFailures);
+		return 2;
+	}
+	return 0;
+}
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
@@ -0,0 +1,166 @@
+/*
+
+ TinyBriteChainSimulator.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the simulated chain.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See includes/TB_Platform_Simulator.h for details.
+ */
+
+#include "../includes/TinyBritePlatform.h"
+
+#ifdef TINYBRITE_PLATFORM_SIMULATOR
+
+/* the packet's mode bit: set for command packets */
+#define TBCS_MODE_COMMAND		(1UL << 30)
+
+TinyBriteChainSimulator & TinyBriteChainSimulator::instance() {
+	static TinyBriteChainSimulator theSimulator;
+	return theSimulator;
+}
+
+TinyBriteChainSimulator::TinyBriteChainSimulator() :
+		num_devices(0), bits(NULL), num_bits(0), head(0), pwm(NULL), command(
+				NULL), stuck_device(TINYBRITE_SIMULATOR_NONE), pin_data(
+				TA6281_DEFAULT_DATAPIN), pin_clock(TA6281_DEFAULT_CLOCKPIN), pin_latch(
+				TA6281_DEFAULT_LATCHPIN), pin_loopback(TINYBRITE_SIMULATOR_MAX_PINS), num_clocks(
+				0), num_latches(0) {
+
+	memset(levels, 0, sizeof(levels));
+}
+
+TinyBriteChainSimulator::~TinyBriteChainSimulator() {
+	free(bits);
+	free(pwm);
+	free(command);
+}
+
+bool TinyBriteChainSimulator::setLength(uint16_t numDevices) {
+	free(bits);
+	free(pwm);
+	free(command);
+
+	num_devices = numDevices;
+	num_bits = (unsigned long) numDevices * 32;
+	head = 0;
+	bits = (uint8_t*) calloc(num_bits ? num_bits : 1, 1);
+	pwm = (uint32_t*) calloc(numDevices ? numDevices : 1, sizeof(uint32_t));
+	command = (uint32_t*) calloc(numDevices ? numDevices : 1, sizeof(uint32_t));
+
+	if (!(bits && pwm && command)) {
+		num_devices = 0;
+		num_bits = 0;
+		return false;
+	}
+	return true;
+}
+
+void TinyBriteChainSimulator::attach(uint8_t datapin, uint8_t clockpin,
+		uint8_t latchpin, uint8_t loopbackpin) {
+	pin_data = datapin;
+	pin_clock = clockpin;
+	pin_latch = latchpin;
+	pin_loopback = loopbackpin;
+}
+
+/*
+ ** bit
+ ** A bit of the chain, as a whole: position 0 is the one DI was last
+ ** shifted into, and position 32 * N + 31 is bit 31 of device N.
+ */
+uint8_t & TinyBriteChainSimulator::bit(unsigned long position) {
+	return bits[(head + position) % num_bits];
+}
+
+/*
+ ** clock
+ ** Everything moves one position down the chain, with DI coming in.
+ */
+void TinyBriteChainSimulator::clock() {
+	num_clocks++;
+	if (!num_bits) {
+		return;
+	}
+
+	// the last bit falls out of DO, and its slot becomes position 0
+	head = head ? head - 1 : num_bits - 1;
+	bit(0) = levels[pin_data] ? 1 : 0;
+
+	if (stuck_device < num_devices) {
+		// what comes into it (from DI, or the device before) never arrives
+		bit((unsigned long) stuck_device * 32) = 0;
+	}
+}
+
+uint32_t TinyBriteChainSimulator::shiftRegister(uint16_t device) {
+	if (device >= num_devices) {
+		return 0;
+	}
+
+	uint32_t value = 0;
+	for (uint8_t b = 32; b > 0; b--) {
+		value = (value << 1) | bit((unsigned long) device * 32 + b - 1);
+	}
+	return value;
+}
+
+uint32_t TinyBriteChainSimulator::latchedPWM(uint16_t device) {
+	return (device < num_devices) ? pwm[device] : 0;
+}
+
+uint32_t TinyBriteChainSimulator::latchedCommand(uint16_t device) {
+	return (device < num_devices) ? command[device] : 0;
+}
+
+void TinyBriteChainSimulator::latch() {
+	num_latches++;
+	for (uint16_t d = 0; d < num_devices; d++) {
+		uint32_t value = shiftRegister(d);
+		if (value & TBCS_MODE_COMMAND) {
+			command[d] = value;
+		} else {
+			pwm[d] = value;
+		}
+	}
+}
+
+void TinyBriteChainSimulator::setLine(uint8_t pin, bool value) {
+	if (pin >= TINYBRITE_SIMULATOR_MAX_PINS) {
+		return;
+	}
+
+	bool rising = value && !levels[pin];
+	levels[pin] = value;
+
+	if (rising && pin == pin_clock) {
+		clock();
+	} else if (rising && pin == pin_latch) {
+		latch();
+	}
+}
+
+bool TinyBriteChainSimulator::getLine(uint8_t pin) {
+	if (pin == pin_loopback) {
+		// DO of the last device: its bit 31
+		return num_bits && bit(num_bits - 1);
+	}
+
+	return (pin < TINYBRITE_SIMULATOR_MAX_PINS) && levels[pin];
+}
+
+#endif /* TINYBRITE_PLATFORM_SIMULATOR */
@@ -0,0 +1,189 @@
+/*
+
+ TinyBriteColorFrame.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the bulk colour frame encoder.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteColorFrame.h for details.
+ */
+
+#include <string.h>
+
+#include "TinyBriteColorFrame.h"
+
+#ifdef TINYBRITE_COLORFRAME_X86
+#include <immintrin.h>
+#endif
+
+#define TBCF_CLAMP(v) \
+	((v) > TINYBRITE_COLORFRAME_MAXVALUE ? TINYBRITE_COLORFRAME_MAXVALUE : (v))
+
+static inline uint32_t tbcfPacket(const uint16_t * rgb) {
+	return ((uint32_t) TBCF_CLAMP(rgb[1]) << TINYBRITE_COLORFRAME_GREEN_SHIFT)
+			| ((uint32_t) TBCF_CLAMP(rgb[0]) << TINYBRITE_COLORFRAME_RED_SHIFT)
+			| ((uint32_t) TBCF_CLAMP(rgb[2]) << TINYBRITE_COLORFRAME_BLUE_SHIFT);
+}
+
+void encodeColorFrameScalar(const uint16_t * rgb, uint32_t * out,
+		size_t num_devices) {
+	for (size_t i = 0; i < num_devices; i++) {
+		out[i] = tbcfPacket(rgb + 3 * i);
+	}
+}
+
+#ifdef TINYBRITE_COLORFRAME_X86
+
+/*
+ * Both SIMD versions work the same way: each device's triplet is loaded
+ * as four 16-bit lanes (r, g, b and the next device's red, which is
+ * ignored), clamped, then run through pmaddwd with (1024, 1, 16, 0),
+ * which gives r << 10 | g and b << 4 as two 32-bit lanes.  Shifting the
+ * latter up by 16 and or-ing the two gives the packet.
+ *
+ * Those 64-bit loads run one lane past the device, so the last device
+ * (at least) is always left to the scalar code.
+ */
+#define TBCF_MADD_WEIGHTS	1024, 1, 16, 0
+
+__attribute__((target("sse2")))
+static inline __m128i tbcfClamp128(__m128i v) {
+	// min(v, max) = v - saturate(v - max): SSE2 has no unsigned 16-bit min
+	return _mm_sub_epi16(v,
+			_mm_subs_epu16(v, _mm_set1_epi16(TINYBRITE_COLORFRAME_MAXVALUE)));
+}
+
+__attribute__((target("sse2")))
+void encodeColorFrameSSE2(const uint16_t * rgb, uint32_t * out,
+		size_t num_devices) {
+	const __m128i weights = _mm_setr_epi16(TBCF_MADD_WEIGHTS, TBCF_MADD_WEIGHTS);
+	size_t i = 0;
+
+	for (; i + 5 <= num_devices; i += 4) {
+		const uint16_t * p = rgb + 3 * i;
+
+		// devices 0 and 1, then 2 and 3, in each 128-bit register
+		__m128i d01 = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) p),
+				_mm_loadl_epi64((const __m128i*) (p + 3)));
+		__m128i d23 = _mm_unpacklo_epi64(
+				_mm_loadl_epi64((const __m128i*) (p + 6)),
+				_mm_loadl_epi64((const __m128i*) (p + 9)));
+
+		// (rg0, b0, rg1, b1) -> (rg0, rg1, b0, b1)
+		__m128i m01 = _mm_shuffle_epi32(
+				_mm_madd_epi16(tbcfClamp128(d01), weights),
+				_MM_SHUFFLE(3, 1, 2, 0));
+		__m128i m23 = _mm_shuffle_epi32(
+				_mm_madd_epi16(tbcfClamp128(d23), weights),
+				_MM_SHUFFLE(3, 1, 2, 0));
+
+		__m128i rg = _mm_unpacklo_epi64(m01, m23);
+		__m128i b = _mm_unpackhi_epi64(m01, m23);
+
+		_mm_storeu_si128((__m128i*) (out + i),
+				_mm_or_si128(rg, _mm_slli_epi32(b, 16)));
+	}
+
+	encodeColorFrameScalar(rgb + 3 * i, out + i, num_devices - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i tbcfLoadPairs(const uint16_t * p) {
+	__m128i lo = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) p),
+			_mm_loadl_epi64((const __m128i*) (p + 3)));
+	__m128i hi = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) (p + 6)),
+			_mm_loadl_epi64((const __m128i*) (p + 9)));
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+__attribute__((target("avx2")))
+void encodeColorFrameAVX2(const uint16_t * rgb, uint32_t * out,
+		size_t num_devices) {
+	const __m256i weights = _mm256_setr_epi16(TBCF_MADD_WEIGHTS,
+			TBCF_MADD_WEIGHTS, TBCF_MADD_WEIGHTS, TBCF_MADD_WEIGHTS);
+	const __m256i maxValue = _mm256_set1_epi16(TINYBRITE_COLORFRAME_MAXVALUE);
+	size_t i = 0;
+
+	for (; i + 9 <= num_devices; i += 8) {
+		const uint16_t * p = rgb + 3 * i;
+
+		// devices (0, 1 | 2, 3) and (4, 5 | 6, 7)
+		__m256i d0 = _mm256_min_epu16(tbcfLoadPairs(p), maxValue);
+		__m256i d1 = _mm256_min_epu16(tbcfLoadPairs(p + 12), maxValue);
+
+		__m256i m0 = _mm256_shuffle_epi32(_mm256_madd_epi16(d0, weights),
+				_MM_SHUFFLE(3, 1, 2, 0));
+		__m256i m1 = _mm256_shuffle_epi32(_mm256_madd_epi16(d1, weights),
+				_MM_SHUFFLE(3, 1, 2, 0));
+
+		// (0, 1, 4, 5 | 2, 3, 6, 7): put the middle 64-bit lanes back in order
+		__m256i packets = _mm256_or_si256(_mm256_unpacklo_epi64(m0, m1),
+				_mm256_slli_epi32(_mm256_unpackhi_epi64(m0, m1), 16));
+		_mm256_storeu_si256((__m256i*) (out + i),
+				_mm256_permute4x64_epi64(packets, _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+
+	encodeColorFrameSSE2(rgb + 3 * i, out + i, num_devices - i);
+}
+
+#endif /* TINYBRITE_COLORFRAME_X86 */
+
+bool encodeColorFrameHas(const char * version) {
+	if (!strcmp(version, "scalar")) {
+		return true;
+	}
+
+#ifdef TINYBRITE_COLORFRAME_X86
+	__builtin_cpu_init();
+	if (!strcmp(version, "sse2")) {
+		return __builtin_cpu_supports("sse2");
+	}
+	if (!strcmp(version, "avx2")) {
+		return __builtin_cpu_supports("avx2");
+	}
+#endif
+
+	return false;
+}
+
+const char * encodeColorFrameVersion() {
+	static const char * version =
+			encodeColorFrameHas("avx2") ? "avx2" :
+			encodeColorFrameHas("sse2") ? "sse2" : "scalar";
+	return version;
+}
+
+typedef void (*TBCFEncoder)(const uint16_t *, uint32_t *, size_t);
+
+static TBCFEncoder tbcfChooseEncoder() {
+#ifdef TINYBRITE_COLORFRAME_X86
+	const char * version = encodeColorFrameVersion();
+	if (!strcmp(version, "avx2")) {
+		return encodeColorFrameAVX2;
+	}
+	if (!strcmp(version, "sse2")) {
+		return encodeColorFrameSSE2;
+	}
+#endif
+	return encodeColorFrameScalar;
+}
+
+void encodeColorFrame(const uint16_t * rgb, uint32_t * out,
+		size_t num_devices) {
+	static TBCFEncoder encoder = tbcfChooseEncoder();
+	encoder(rgb, out, num_devices);
+}
@@ -0,0 +1,103 @@
+/*
+
+ TinyBriteColorFrame.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Bulk encoding of RGB frames into A6281 colour packets, for host builds.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ This code runs on a Linux (or other) host, for chains of thousands of
+ devices where building packets one colorPacket() at a time is too slow.
+
+ encodeColorFrame() takes n devices' worth of interleaved red, green
+ and blue values (rgb[3*i], rgb[3*i + 1], rgb[3*i + 2] for device i),
+ clamps each to TINYBRITE_COLOR_MAXVALUE and packs it into the 32-bit
+ packet value, in the same order.  The result is bit-for-bit what
+ TinyBrite::colorPacket() gives for the clamped values, ready for
+ sendPackets() or a TinyBriteFrameEncoder.
+
+ On x86, SSE2 and AVX2 versions are used when the CPU has them (chosen
+ once, at the first call); elsewhere, the plain C++ version is.
+
+ host/TinyBriteColorFrameBench.cpp checks all versions against
+ colorPacket() and measures their throughput.
+
+ Usage:
+
+ uint16_t rgb[3 * num_devices];
+ uint32_t packets[num_devices];
+
+ // for each frame, fill rgb then
+ encodeColorFrame(rgb, packets, num_devices);
+
+ To build, compile TinyBriteColorFrame.cpp along with your program,
+ with the library root on the include path, e.g.
+	g++ -O2 -I path/to/TinyBrite myshow.cpp path/to/TinyBrite/host/TinyBriteColorFrame.cpp
+
+*/
+
+#ifndef TinyBriteColorFrame_h
+#define TinyBriteColorFrame_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* same as TINYBRITE_COLOR_MAXVALUE, without pulling in a platform */
+#define TINYBRITE_COLORFRAME_MAXVALUE		1023
+
+/* where each channel goes in a colour packet (see BritePacket) */
+#define TINYBRITE_COLORFRAME_GREEN_SHIFT	0
+#define TINYBRITE_COLORFRAME_RED_SHIFT		10
+#define TINYBRITE_COLORFRAME_BLUE_SHIFT		20
+
+/*
+ ** encodeColorFrame
+ ** Pack num_devices RGB triplets from rgb into colour packet values in out.
+ */
+void encodeColorFrame(const uint16_t * rgb, uint32_t * out, size_t num_devices);
+
+/*
+ ** encodeColorFrameScalar / SSE2 / AVX2
+ ** The individual versions.  The SIMD ones are only available on x86 and
+ ** must only be called if encodeColorFrameHas() says the CPU supports them.
+ */
+void encodeColorFrameScalar(const uint16_t * rgb, uint32_t * out,
+		size_t num_devices);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TINYBRITE_COLORFRAME_X86
+void encodeColorFrameSSE2(const uint16_t * rgb, uint32_t * out,
+		size_t num_devices);
+void encodeColorFrameAVX2(const uint16_t * rgb, uint32_t * out,
+		size_t num_devices);
+#endif
+
+/*
+ ** encodeColorFrameHas
+ ** Whether the named version ("scalar", "sse2" or "avx2") can run here.
+ */
+bool encodeColorFrameHas(const char * version);
+
+/*
+ ** encodeColorFrameVersion
+ ** Name of the version encodeColorFrame() uses.
+ */
+const char * encodeColorFrameVersion();
+
+#endif
@@ -0,0 +1,191 @@
+/*
+
+ TinyBriteColorFrameBench.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Check and benchmark for the bulk colour frame encoder.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ Compares every version of encodeColorFrame() available on this CPU
+ with TinyBrite::colorPacket() (over all chain lengths up to 64, so
+ every tail case is hit, and over out-of-range values), then times each
+ on a large frame.  Throughput is given in GB/s of RGB input (6 bytes
+ per device) and in millions of devices per second.  Build, from the
+ library directory, with:
+
+	g++ -O2 -DTINYBRITE_PLATFORM_LINUX -I. -o tinybrite-colorbench *.cpp \
+		host/TinyBriteLinuxTransport.cpp host/TinyBriteColorFrame.cpp \
+		host/TinyBriteColorFrameBench.cpp
+
+ and run it with the number of devices and passes, optionally:
+
+	./tinybrite-colorbench [DEVICES [PASSES]]
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "TinyBrite.h"
+#include "host/TinyBriteColorFrame.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+#if TINYBRITE_COLORFRAME_MAXVALUE != TINYBRITE_COLOR_MAXVALUE
+#error "TINYBRITE_COLORFRAME_MAXVALUE out of step with TINYBRITE_COLOR_MAXVALUE"
+#endif
+
+#define TBCFB_CHECK_DEVICES		64
+
+typedef void (*ColorFrameEncoder)(const uint16_t *, uint32_t *, size_t);
+
+typedef struct ColorFrameVersion {
+	const char * name;
+	ColorFrameEncoder encode;
+} ColorFrameVersion;
+
+static const ColorFrameVersion versions[] = {
+	{ "scalar", encodeColorFrameScalar },
+#ifdef TINYBRITE_COLORFRAME_X86
+	{ "sse2", encodeColorFrameSSE2 },
+	{ "avx2", encodeColorFrameAVX2 },
+#endif
+	{ "dispatch", encodeColorFrame },
+};
+
+#define TBCFB_NUM_VERSIONS	(sizeof(versions) / sizeof(versions[0]))
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint16_t clamped(uint16_t v) {
+	return v > TINYBRITE_COLOR_MAXVALUE ? TINYBRITE_COLOR_MAXVALUE : v;
+}
+
+static bool check(const ColorFrameVersion & version) {
+	uint16_t rgb[3 * TBCFB_CHECK_DEVICES + 3];
+	uint32_t out[TBCFB_CHECK_DEVICES + 1];
+
+	for (int round = 0; round < 200; round++) {
+		for (size_t i = 0; i < 3 * TBCFB_CHECK_DEVICES + 3; i++) {
+			// mostly in range, with the edges and some way out
+			switch (rand() % 8) {
+			case 0:
+				rgb[i] = 0xFFFF;
+				break;
+			case 1:
+				rgb[i] = TINYBRITE_COLOR_MAXVALUE + (rand() & 1);
+				break;
+			default:
+				rgb[i] = rand() & TINYBRITE_COLOR_MAXVALUE;
+				break;
+			}
+		}
+
+		for (size_t n = 0; n <= TBCFB_CHECK_DEVICES; n++) {
+			// sentinel, to catch writes past the end
+			out[n] = 0xDEADBEEF;
+			version.encode(rgb, out, n);
+
+			for (size_t i = 0; i < n; i++) {
+				BritePacket expected = TinyBrite::colorPacket(
+						clamped(rgb[3 * i]), clamped(rgb[3 * i + 1]),
+						clamped(rgb[3 * i + 2]));
+				if (out[i] != expected.value) {
+					fprintf(stderr,
+							"%s: device %lu of %lu: got 0x%08lx, expected 0x%08lx\n",
+							version.name, (unsigned long) i, (unsigned long) n,
+							(unsigned long) out[i],
+							(unsigned long) expected.value);
+					return false;
+				}
+			}
+			if (out[n] != 0xDEADBEEF) {
+				fprintf(stderr, "%s: wrote past %lu devices\n", version.name,
+						(unsigned long) n);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char * argv[]) {
+	size_t numDevices = argc > 1 ? strtoul(argv[1], NULL, 0) : 100000;
+	unsigned long passes = argc > 2 ? strtoul(argv[2], NULL, 0) : 200;
+
+	if (!numDevices || !passes) {
+		fprintf(stderr, "usage: %s [DEVICES [PASSES]]\n", argv[0]);
+		return 1;
+	}
+
+	uint16_t * rgb = (uint16_t*) malloc(3 * numDevices * sizeof(uint16_t));
+	uint32_t * out = (uint32_t*) malloc(numDevices * sizeof(uint32_t));
+	if (!(rgb && out)) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	for (size_t i = 0; i < 3 * numDevices; i++) {
+		rgb[i] = rand() & 0x7FF;
+	}
+
+	printf("encodeColorFrame() uses: %s\n", encodeColorFrameVersion());
+	printf("%lu devices, %lu passes\n", (unsigned long) numDevices, passes);
+
+	int failed = 0;
+	for (size_t v = 0; v < TBCFB_NUM_VERSIONS; v++) {
+		const ColorFrameVersion & version = versions[v];
+		if (version.encode != encodeColorFrame
+				&& !encodeColorFrameHas(version.name)) {
+			printf("%-9s not supported by this CPU\n", version.name);
+			continue;
+		}
+
+		if (!check(version)) {
+			failed = 1;
+			continue;
+		}
+
+		// once to warm up the caches
+		version.encode(rgb, out, numDevices);
+
+		double start = now();
+		for (unsigned long p = 0; p < passes; p++) {
+			version.encode(rgb, out, numDevices);
+		}
+		double elapsed = now() - start;
+
+		double devices = (double) numDevices * passes;
+		printf("%-9s %7.2f GB/s %9.1f Mdevices/s\n", version.name,
+				devices * 3 * sizeof(uint16_t) / elapsed / 1e9,
+				devices / elapsed / 1e6);
+	}
+
+	free(rgb);
+	free(out);
+
+	return failed;
+}
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
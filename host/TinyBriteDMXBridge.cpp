@@ -0,0 +1,272 @@
+/*
+
+ TinyBriteDMXBridge.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Drives chains from Art-Net or sACN (E1.31), and reports how it went.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ Sets up a TinyBriteDMXReceiver and a TinyBritePipeline with one chain
+ per output, each chain taking as many universes as it needs, in order
+ (170 devices per universe, or 85 with 16-bit channels), and prints the
+ statistics every second.  Build, from the library directory, with:
+
+	g++ -O2 -pthread -DTINYBRITE_PLATFORM_LINUX -I. -o tinybrite-dmx *.cpp \
+		host/TinyBriteLinuxTransport.cpp host/TinyBriteColorFrame.cpp \
+		host/TinyBritePipeline.cpp host/TinyBriteDMXReceiver.cpp \
+		host/TinyBriteDMXBridge.cpp
+
+ and run it against the hardware:
+
+	./tinybrite-dmx -g /dev/gpiochip0 -s /dev/spidev0.0 -l 25 \
+		-s /dev/spidev1.0 -l 26 -n 680
+
+ or, to try it out on localhost with host/TinyBriteDMXGenerator.cpp,
+ 32 universes over 4 chains:
+
+	./tinybrite-dmx -o /dev/null -o /dev/null -o /dev/null -o /dev/null \
+		-n 1360 -t 12 &
+	./tinybrite-dmxgen -n 32 -r 44 -s -f 440
+
+ Options:
+	-s DEVICE     a chain on this spidev device
+	-o PATH       a chain sent to this file or pipe, instead of SPI
+	-l LINE       latch line of the chain just given (default 25)
+	-S HZ         SPI clock rate (default 2000000)
+	-g DEVICE     GPIO chip with the latch lines
+	-n DEVICES    length of each chain (default 170)
+	-u FIRST      universe of the first chain's first devices (default 1)
+	-w            16-bit channels
+	-p PROTOCOL   artnet, e131 or both (default)
+	-i ADDRESS    interface to take E1.31 multicast on
+	-r FPS        latch at this rate, rather than on sync or as frames
+	              come in
+	-t SECONDS    stop after this long (default: when interrupted)
+
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "TinyBrite.h"
+#include "host/TinyBriteDMXReceiver.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+typedef struct BridgeOutput {
+	const char * spi_device;
+	const char * path;
+	uint8_t latch_line;
+} BridgeOutput;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int) {
+	stopping = 1;
+}
+
+static void usage(const char * name) {
+	fprintf(stderr,
+			"usage: %s (-s SPIDEV [-l LINE] | -o PATH)... [-S HZ] [-g GPIOCHIP]\n"
+					"\t[-n DEVICES] [-u FIRST] [-w] [-p artnet|e131|both]\n"
+					"\t[-i ADDRESS] [-r FPS] [-t SECONDS]\n", name);
+}
+
+int main(int argc, char * argv[]) {
+	BridgeOutput outputs[TINYBRITE_PIPELINE_MAXCHAINS];
+	uint8_t numOutputs = 0;
+	const char * gpioChip = NULL;
+	const char * interfaceAddress = NULL;
+	uint32_t speed = 2000000;
+	unsigned long numDevices = 170;
+	unsigned long firstUniverse = 1;
+	uint8_t depth = TINYBRITE_DMX_8BIT;
+	uint8_t protocols = TINYBRITE_DMX_ARTNET | TINYBRITE_DMX_E131;
+	unsigned long fps = 0;
+	unsigned long seconds = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "s:o:l:S:g:n:u:wp:i:r:t:")) != -1) {
+		switch (opt) {
+		case 's':
+		case 'o':
+			if (numOutputs == TINYBRITE_PIPELINE_MAXCHAINS) {
+				fprintf(stderr, "at most %d chains\n",
+						TINYBRITE_PIPELINE_MAXCHAINS);
+				return 1;
+			}
+			outputs[numOutputs].spi_device = (opt == 's') ? optarg : NULL;
+			outputs[numOutputs].path = (opt == 'o') ? optarg : NULL;
+			outputs[numOutputs].latch_line = 25;
+			numOutputs++;
+			break;
+		case 'l':
+			if (!numOutputs) {
+				usage(argv[0]);
+				return 1;
+			}
+			outputs[numOutputs - 1].latch_line = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			speed = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			gpioChip = optarg;
+			break;
+		case 'n':
+			numDevices = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			firstUniverse = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			depth = TINYBRITE_DMX_16BIT;
+			break;
+		case 'p':
+			protocols = !strcmp(optarg, "artnet") ? TINYBRITE_DMX_ARTNET :
+						!strcmp(optarg, "e131") ? TINYBRITE_DMX_E131 :
+						!strcmp(optarg, "both") ?
+								TINYBRITE_DMX_ARTNET | TINYBRITE_DMX_E131 : 0;
+			break;
+		case 'i':
+			interfaceAddress = optarg;
+			break;
+		case 'r':
+			fps = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!numOutputs || !numDevices || numDevices > 0xFFFF || !protocols) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	TinyBritePipeline pipeline(fps);
+	TinyBrite * chains[TINYBRITE_PIPELINE_MAXCHAINS];
+	TinyBriteLinuxTransport buses[TINYBRITE_PIPELINE_MAXCHAINS];
+
+	for (uint8_t c = 0; c < numOutputs; c++) {
+		TinyBriteLinuxTransport & bus = buses[c];
+		BridgeOutput & out = outputs[c];
+
+		if (out.spi_device && !bus.openSPI(out.spi_device, speed)) {
+			perror(out.spi_device);
+			return 1;
+		}
+		if (out.path && !bus.openFile(out.path)) {
+			perror(out.path);
+			return 1;
+		}
+		if (gpioChip && out.spi_device && !bus.openGPIO(gpioChip)) {
+			perror(gpioChip);
+			return 1;
+		}
+
+		TinyBriteLinuxTransport::use(&bus);
+		chains[c] = new TinyBrite(numDevices);
+		chains[c]->setup(0, 0, out.latch_line);
+		if (pipeline.addChain(*chains[c], bus) < 0) {
+			fprintf(stderr, "can't add chain %d\n", c);
+			return 1;
+		}
+	}
+	TinyBriteLinuxTransport::use(NULL);
+
+	TinyBriteDMXReceiver receiver(pipeline);
+	unsigned long perUniverse = TINYBRITE_DMX_CHANNELS / (3 * depth);
+	unsigned long universe = firstUniverse;
+
+	for (uint8_t c = 0; c < numOutputs; c++) {
+		unsigned long firstInChain = universe;
+		for (unsigned long d = 0; d < numDevices; d += perUniverse) {
+			unsigned long num = numDevices - d;
+			if (num > perUniverse) {
+				num = perUniverse;
+			}
+			if (universe > 0x7FFF
+					|| !receiver.addUniverse(universe, c, d, num, 1, depth)) {
+				fprintf(stderr, "can't map universe %lu\n", universe);
+				return 1;
+			}
+			universe++;
+		}
+		printf("chain %d: universes %lu to %lu\n", c, firstInChain,
+				universe - 1);
+	}
+
+	if (!receiver.begin(protocols, interfaceAddress)) {
+		perror("can't listen");
+		return 1;
+	}
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+	pipeline.start();
+
+	unsigned long start = MCU::millis();
+	unsigned long lastReport = start;
+	unsigned long lastPackets = 0;
+
+	while (!stopping && (!seconds || MCU::millis() - start < seconds * 1000)) {
+		if (!receiver.service(100)) {
+			perror("receive");
+			break;
+		}
+
+		unsigned long now = MCU::millis();
+		if (now - lastReport >= 1000) {
+			unsigned long packets = receiver.packetsReceived();
+			printf("%lu packets/s, %lu syncs, %lu ignored, %lu out of order, "
+					"sync %s\n", (packets - lastPackets) * 1000 / (now - lastReport),
+					receiver.syncsReceived(), receiver.packetsIgnored(),
+					receiver.packetsOutOfOrder(),
+					(receiver.syncMode(TINYBRITE_DMX_ARTNET)
+							|| receiver.syncMode(TINYBRITE_DMX_E131)) ? "on" : "off");
+			lastPackets = packets;
+			lastReport = now;
+		}
+	}
+
+	pipeline.stop();
+	receiver.end();
+
+	printf("%lu packets, %lu frames published\n", receiver.packetsReceived(),
+			receiver.framesPublished());
+	printf("chain    shown  dropped  missed  late  transmit avg/max (us)\n");
+	for (uint8_t c = 0; c < numOutputs; c++) {
+		printf("%5d %8lu %8lu %7lu %5lu  %11lu / %lu\n", c,
+				pipeline.framesShown(c), pipeline.framesDropped(c),
+				pipeline.ticksMissed(c), pipeline.ticksLate(c),
+				pipeline.transmitTimeAvg(c), pipeline.transmitTimeMax(c));
+		buses[c].close();
+		delete chains[c];
+	}
+
+	return 0;
+}
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
@@ -0,0 +1,321 @@
+/*
+
+ TinyBriteDMXGenerator.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Sends Art-Net or sACN (E1.31) test packets, like a lighting desk would.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ Sends a run of universes, a frame at a time, at a steady rate, with a
+ sync packet after each frame if asked to.  Every channel ramps up,
+ each one a step ahead of the one before, so a frame's data is easy to
+ check:
+
+	channel c (from 0) of universe u (from the first) = frame + u + c
+
+ modulo 256.  It needs nothing but the standard library, so it can run
+ on the controller itself, or anywhere else.  Build with:
+
+	g++ -O2 -o tinybrite-dmxgen host/TinyBriteDMXGenerator.cpp
+
+ and, with host/TinyBriteDMXBridge.cpp listening, try:
+
+	./tinybrite-dmxgen -n 32 -r 44 -s -f 440
+	./tinybrite-dmxgen -p e131 -n 32 -r 44 -s -f 440
+
+ Options:
+	-p PROTOCOL  artnet (default) or e131
+	-d ADDRESS   where to send (default 127.0.0.1)
+	-m           E1.31 only: send each universe to its multicast group
+	-u FIRST     first universe (default 1)
+	-n COUNT     number of universes (default 32)
+	-c CHANNELS  channels per universe (default 512)
+	-r FPS       frames per second (default 44)
+	-f FRAMES    frames to send (default 0: until interrupted)
+	-s           send a sync packet after each frame
+	-S UNIVERSE  E1.31 sync universe (default 63999)
+
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define TBDG_ARTNET_PORT		6454
+#define TBDG_E131_PORT			5568
+#define TBDG_ARTNET_HEADER		18
+#define TBDG_ARTNET_SYNC_SIZE	14
+#define TBDG_E131_HEADER		126
+#define TBDG_E131_SYNC_SIZE		49
+#define TBDG_MAXUNIVERSES		1024
+
+static const uint8_t tbdg_cid[16] = { 0x54, 0x42, 0x44, 0x47, 0x00, 0x01,
+		0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B };
+
+static void putBE16(uint8_t * p, uint16_t value) {
+	p[0] = value >> 8;
+	p[1] = value;
+}
+
+static void putBE32(uint8_t * p, uint32_t value) {
+	putBE16(p, value >> 16);
+	putBE16(p + 2, value);
+}
+
+/*
+ ** E1.31 root layer: preamble, packet identifier, flags and length, vector
+ ** and CID.  Each layer's flags and length count from its own start.
+ */
+static void e131Root(uint8_t * p, size_t len, uint32_t vector) {
+	static const uint8_t id[16] = { 0x00, 0x10, 0x00, 0x00, 'A', 'S', 'C',
+			'-', 'E', '1', '.', '1', '7', 0x00, 0x00, 0x00 };
+	memset(p, 0, len);
+	memcpy(p, id, sizeof(id));
+	putBE16(p + 16, 0x7000 | (len - 16));
+	putBE32(p + 18, vector);
+	memcpy(p + 22, tbdg_cid, sizeof(tbdg_cid));
+}
+
+static size_t e131Data(uint8_t * p, uint16_t universe, uint16_t numChannels,
+		uint16_t syncUniverse) {
+	size_t len = TBDG_E131_HEADER + numChannels;
+	e131Root(p, len, 0x00000004);
+
+	putBE16(p + 38, 0x7000 | (len - 38));
+	putBE32(p + 40, 0x00000002);
+	strcpy((char *) p + 44, "tinybrite-dmxgen");
+	p[108] = 100; // priority
+	putBE16(p + 109, syncUniverse);
+	putBE16(p + 113, universe);
+
+	putBE16(p + 115, 0x7000 | (len - 115));
+	p[117] = 0x02; // set property
+	p[118] = 0xA1; // address and data type
+	putBE16(p + 121, 1); // address increment
+	putBE16(p + 123, numChannels + 1);
+	// p[125], the start code, stays 0: dimmer data
+	return len;
+}
+
+static size_t e131Sync(uint8_t * p, uint16_t syncUniverse) {
+	e131Root(p, TBDG_E131_SYNC_SIZE, 0x00000008);
+	putBE16(p + 38, 0x7000 | (TBDG_E131_SYNC_SIZE - 38));
+	putBE32(p + 40, 0x00000001);
+	putBE16(p + 45, syncUniverse);
+	return TBDG_E131_SYNC_SIZE;
+}
+
+static size_t artnetHeader(uint8_t * p, uint16_t opcode) {
+	memcpy(p, "Art-Net", 8);
+	p[8] = opcode;
+	p[9] = opcode >> 8;
+	p[10] = 0;
+	p[11] = 14; // protocol version
+	p[12] = p[13] = 0;
+	return TBDG_ARTNET_SYNC_SIZE;
+}
+
+static size_t artnetDmx(uint8_t * p, uint16_t universe, uint16_t numChannels) {
+	artnetHeader(p, 0x5000);
+	p[14] = universe;
+	p[15] = (universe >> 8) & 0x7F;
+	putBE16(p + 16, numChannels);
+	return TBDG_ARTNET_HEADER + numChannels;
+}
+
+static void usage(const char * name) {
+	fprintf(stderr,
+			"usage: %s [-p artnet|e131] [-d ADDRESS] [-m] [-u FIRST] [-n COUNT]\n"
+					"\t[-c CHANNELS] [-r FPS] [-f FRAMES] [-s] [-S UNIVERSE]\n",
+			name);
+}
+
+int main(int argc, char * argv[]) {
+	bool e131 = false;
+	bool multicast = false;
+	const char * address = "127.0.0.1";
+	unsigned long first = 1;
+	unsigned long count = 32;
+	unsigned long numChannels = 512;
+	unsigned long fps = 44;
+	unsigned long numFrames = 0;
+	bool sendSync = false;
+	unsigned long syncUniverse = 63999;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "p:d:mu:n:c:r:f:sS:")) != -1) {
+		switch (opt) {
+		case 'p':
+			e131 = !strcmp(optarg, "e131");
+			if (!e131 && strcmp(optarg, "artnet")) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'd':
+			address = optarg;
+			break;
+		case 'm':
+			multicast = true;
+			break;
+		case 'u':
+			first = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			numChannels = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			fps = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			numFrames = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			sendSync = true;
+			break;
+		case 'S':
+			syncUniverse = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	// Art-Net wants an even number of channels, from 2
+	if (!count || count > TBDG_MAXUNIVERSES || !fps || !numChannels
+			|| numChannels > 512 || (!e131 && (numChannels & 1))
+			|| first + count - 1 > (e131 ? 63999UL : 0x7FFFUL)
+			|| (e131 && (!first || !syncUniverse || syncUniverse > 63999))) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	struct sockaddr_in dest;
+	memset(&dest, 0, sizeof(dest));
+	dest.sin_family = AF_INET;
+	dest.sin_port = htons(e131 ? TBDG_E131_PORT : TBDG_ARTNET_PORT);
+	if (inet_pton(AF_INET, address, &dest.sin_addr) != 1) {
+		fprintf(stderr, "%s: not an IPv4 address\n", address);
+		return 1;
+	}
+
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	int on = 1;
+	if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on))) {
+		perror("socket");
+		return 1;
+	}
+
+	// a frame is count packets, plus the sync, all sent at once
+	size_t packetSize = (e131 ? TBDG_E131_HEADER : TBDG_ARTNET_HEADER)
+			+ numChannels;
+	uint8_t * packets = (uint8_t*) malloc(packetSize * (count + 1));
+	struct sockaddr_in * dests = (struct sockaddr_in *) malloc(
+			sizeof(struct sockaddr_in) * (count + 1));
+	struct iovec * vectors = (struct iovec *) malloc(
+			sizeof(struct iovec) * (count + 1));
+	struct mmsghdr * messages = (struct mmsghdr *) calloc(count + 1,
+			sizeof(struct mmsghdr));
+	if (!(packets && dests && vectors && messages)) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	for (unsigned long u = 0; u <= count; u++) {
+		uint8_t * p = packets + u * packetSize;
+		size_t len;
+		dests[u] = dest;
+		if (u == count) {
+			len = e131 ?
+					e131Sync(p, syncUniverse) : artnetHeader(p, 0x5200);
+			if (e131 && multicast) {
+				dests[u].sin_addr.s_addr = htonl(0xEFFF0000UL | syncUniverse);
+			}
+		} else if (e131) {
+			len = e131Data(p, first + u, numChannels,
+					sendSync ? syncUniverse : 0);
+			if (multicast) {
+				dests[u].sin_addr.s_addr = htonl(0xEFFF0000UL | (first + u));
+			}
+		} else {
+			len = artnetDmx(p, first + u, numChannels);
+		}
+
+		vectors[u].iov_base = p;
+		vectors[u].iov_len = len;
+		messages[u].msg_hdr.msg_name = &dests[u];
+		messages[u].msg_hdr.msg_namelen = sizeof(dests[u]);
+		messages[u].msg_hdr.msg_iov = &vectors[u];
+		messages[u].msg_hdr.msg_iovlen = 1;
+	}
+
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	unsigned long long periodNs = 1000000000ULL / fps;
+	unsigned long numSent = 0;
+	unsigned long numFailed = 0;
+	uint8_t sequence = 0;
+
+	for (unsigned long frame = 0; !numFrames || frame < numFrames; frame++) {
+		// Art-Net sequence 0 means "not sequenced"
+		sequence = (!e131 && sequence == 255) ? 1 : sequence + 1;
+
+		for (unsigned long u = 0; u < count; u++) {
+			uint8_t * p = packets + u * packetSize;
+			uint8_t * data = p + (e131 ? TBDG_E131_HEADER : TBDG_ARTNET_HEADER);
+			p[e131 ? 111 : 12] = sequence;
+			for (unsigned long c = 0; c < numChannels; c++) {
+				data[c] = frame + u + c;
+			}
+		}
+		if (e131) {
+			packets[count * packetSize + 44] = sequence;
+		}
+
+		unsigned int numPackets = count + (sendSync ? 1 : 0);
+		for (unsigned int done = 0; done < numPackets;) {
+			int n = sendmmsg(fd, messages + done, numPackets - done, 0);
+			if (n <= 0) {
+				numFailed += numPackets - done;
+				break;
+			}
+			done += n;
+			numSent += n;
+		}
+
+		next.tv_nsec += periodNs;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+
+	printf("%lu packets sent, %lu failed\n", numSent, numFailed);
+	close(fd);
+	return numFailed ? 2 : 0;
+}
@@ -0,0 +1,536 @@
+/*
+
+ TinyBriteDMXReceiver.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the Art-Net and sACN (E1.31) receiver.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteDMXReceiver.h for details.
+ */
+
+#include "TinyBriteDMXReceiver.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "TinyBriteColorFrame.h"
+
+/*
+ * Art-Net: "Art-Net\0", then a little-endian opcode.  ArtDmx then has
+ * the protocol version, sequence, physical port, port-address (low
+ * byte, then net) and a big-endian length, then the data.
+ */
+#define TBDR_ARTNET_OP_DMX				0x5000
+#define TBDR_ARTNET_OP_SYNC				0x5200
+#define TBDR_ARTNET_DMX_HEADER			18
+#define TBDR_ARTNET_SYNC_SIZE			14
+
+/*
+ * E1.31: a root layer, a framing layer and, for data, a DMP layer, all
+ * big-endian.  Offsets are from the start of the packet.
+ */
+#define TBDR_E131_ROOT_VECTOR			18
+#define TBDR_E131_VECTOR_DATA			0x00000004UL
+#define TBDR_E131_VECTOR_EXTENDED		0x00000008UL
+#define TBDR_E131_FRAMING_VECTOR		40
+#define TBDR_E131_VECTOR_DATA_PACKET	0x00000002UL
+#define TBDR_E131_VECTOR_SYNC_PACKET	0x00000001UL
+#define TBDR_E131_SYNC_ADDRESS			109
+#define TBDR_E131_SEQUENCE				111
+#define TBDR_E131_OPTIONS				112
+#define TBDR_E131_UNIVERSE				113
+#define TBDR_E131_DMP_VECTOR			117
+#define TBDR_E131_DMP_FORMAT			118
+#define TBDR_E131_PROPERTY_COUNT		123
+#define TBDR_E131_START_CODE			125
+#define TBDR_E131_DATA_HEADER			126
+#define TBDR_E131_OPTION_PREVIEW		0x80
+#define TBDR_E131_OPTION_TERMINATED		0x40
+#define TBDR_E131_SYNC_UNIVERSE			45
+#define TBDR_E131_SYNC_SIZE				49
+
+/* sequence[] and sync_until_ms[] slot for a protocol */
+#define TBDR_SLOT(protocol)				((protocol) == TINYBRITE_DMX_E131)
+
+#define TBDR_BE16(p)	((uint16_t) (((p)[0] << 8) | (p)[1]))
+#define TBDR_BE32(p) \
+	(((uint32_t) (p)[0] << 24) | ((uint32_t) (p)[1] << 16) \
+			| ((uint32_t) (p)[2] << 8) | (p)[3])
+
+static const uint8_t tbdr_artnet_id[8] = { 'A', 'r', 't', '-', 'N', 'e', 't',
+		0 };
+static const uint8_t tbdr_e131_id[16] = { 0x00, 0x10, 0x00, 0x00, 'A', 'S',
+		'C', '-', 'E', '1', '.', '1', '7', 0x00, 0x00, 0x00 };
+
+static unsigned long long tbdrNowMs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static int tbdrOpen(uint16_t port) {
+	int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	// any address, so broadcasts and multicasts get here too
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+TinyBriteDMXReceiver::TinyBriteDMXReceiver(TinyBritePipeline & aPipeline) :
+		pipeline(aPipeline), num_mappings(0), artnet_fd(-1), e131_fd(-1), interface_addr(
+				htonl(INADDR_ANY)), e131_sync_universe(0), now_ms(0), packets_received(
+				0), packets_ignored(0), packets_out_of_order(0), syncs_received(
+				0), frames_published(0), latch_pending(false) {
+
+	sync_until_ms[0] = sync_until_ms[1] = 0;
+	memset(chains, 0, sizeof(chains));
+
+	for (uint8_t i = 0; i < TINYBRITE_DMX_BATCH; i++) {
+		vectors[i].iov_base = buffers[i];
+		vectors[i].iov_len = TINYBRITE_DMX_MAXPACKET;
+		memset(&messages[i], 0, sizeof(messages[i]));
+		messages[i].msg_hdr.msg_iov = &vectors[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+TinyBriteDMXReceiver::~TinyBriteDMXReceiver() {
+	end();
+
+	for (uint8_t c = 0; c < TINYBRITE_PIPELINE_MAXCHAINS; c++) {
+		free(chains[c].rgb);
+	}
+}
+
+bool TinyBriteDMXReceiver::addUniverse(uint16_t universe, uint8_t chain,
+		DriverNum firstDevice, DriverNum numDevices, uint16_t firstChannel,
+		uint8_t depth) {
+	TinyBriteFrameQueue * q = pipeline.queue(chain);
+	if (!q || num_mappings >= TINYBRITE_DMX_MAXMAPPINGS || !numDevices
+			|| !firstChannel
+			|| (depth != TINYBRITE_DMX_8BIT && depth != TINYBRITE_DMX_16BIT)) {
+		return false;
+	}
+
+	if (firstChannel - 1 + (unsigned long) numDevices * 3 * depth
+			> TINYBRITE_DMX_CHANNELS
+			|| (unsigned long) firstDevice + numDevices > q->numDevices()) {
+		return false;
+	}
+
+	DMXChain & dc = chains[chain];
+	if (!dc.rgb) {
+		dc.num_devices = q->numDevices();
+		dc.rgb = (uint16_t*) calloc(3 * (size_t) dc.num_devices,
+				sizeof(uint16_t));
+		if (!dc.rgb) {
+			return false;
+		}
+	}
+
+	DMXMapping & m = mappings[num_mappings];
+	memset(&m, 0, sizeof(m));
+	m.universe = universe;
+	m.first_channel = firstChannel - 1;
+	m.chain = chain;
+	m.depth = depth;
+	m.first_device = firstDevice;
+	m.num_devices = numDevices;
+
+	dc.mapped |= 1ULL << num_mappings;
+	num_mappings++;
+	return true;
+}
+
+/*
+ ** joinGroup
+ ** Join (or leave) the E1.31 multicast group of a universe,
+ ** 239.255.(universe high byte).(universe low byte).
+ */
+void TinyBriteDMXReceiver::joinGroup(uint16_t universe, bool join) {
+	struct ip_mreq mreq;
+	mreq.imr_multiaddr.s_addr = htonl(0xEFFF0000UL | universe);
+	mreq.imr_interface.s_addr = interface_addr;
+	setsockopt(e131_fd, IPPROTO_IP,
+			join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP, &mreq,
+			sizeof(mreq));
+}
+
+bool TinyBriteDMXReceiver::begin(uint8_t protocols,
+		const char * interfaceAddress) {
+	end();
+
+	if (interfaceAddress
+			&& inet_pton(AF_INET, interfaceAddress, &interface_addr) != 1) {
+		return false;
+	}
+
+	if (protocols & TINYBRITE_DMX_ARTNET) {
+		artnet_fd = tbdrOpen(TINYBRITE_DMX_ARTNET_PORT);
+		if (artnet_fd < 0) {
+			return false;
+		}
+	}
+
+	if (protocols & TINYBRITE_DMX_E131) {
+		e131_fd = tbdrOpen(TINYBRITE_DMX_E131_PORT);
+		if (e131_fd < 0) {
+			end();
+			return false;
+		}
+
+		for (uint8_t i = 0; i < num_mappings; i++) {
+			bool joined = false;
+			for (uint8_t j = 0; j < i; j++) {
+				joined = joined || (mappings[j].universe == mappings[i].universe);
+			}
+			if (!joined) {
+				// unicast still works if this fails (no multicast route...)
+				joinGroup(mappings[i].universe, true);
+			}
+		}
+	}
+
+	return artnet_fd >= 0 || e131_fd >= 0;
+}
+
+void TinyBriteDMXReceiver::end() {
+	if (artnet_fd >= 0) {
+		close(artnet_fd);
+		artnet_fd = -1;
+	}
+	if (e131_fd >= 0) {
+		close(e131_fd);
+		e131_fd = -1;
+	}
+	e131_sync_universe = 0;
+}
+
+bool TinyBriteDMXReceiver::syncMode(uint8_t protocol) {
+	return tbdrNowMs() < sync_until_ms[TBDR_SLOT(protocol)];
+}
+
+bool TinyBriteDMXReceiver::service(int timeoutMs) {
+	struct pollfd fds[2];
+	uint8_t protocols[2];
+	int numFds = 0;
+
+	if (artnet_fd >= 0) {
+		fds[numFds].fd = artnet_fd;
+		fds[numFds].events = POLLIN;
+		protocols[numFds++] = TINYBRITE_DMX_ARTNET;
+	}
+	if (e131_fd >= 0) {
+		fds[numFds].fd = e131_fd;
+		fds[numFds].events = POLLIN;
+		protocols[numFds++] = TINYBRITE_DMX_E131;
+	}
+	if (!numFds) {
+		return false;
+	}
+
+	// don't sleep past a frame that is due to be published
+	now_ms = tbdrNowMs();
+	for (uint8_t c = 0; c < TINYBRITE_PIPELINE_MAXCHAINS; c++) {
+		if (chains[c].received) {
+			long left = (long) (chains[c].first_received_ms
+					+ TINYBRITE_DMX_FRAME_TIMEOUT_MS - now_ms);
+			if (left < timeoutMs) {
+				timeoutMs = (left > 0) ? left : 0;
+			}
+		}
+	}
+
+	if (poll(fds, numFds, timeoutMs) < 0 && errno != EINTR) {
+		return false;
+	}
+
+	bool ok = true;
+	for (int i = 0; i < numFds; i++) {
+		if (fds[i].revents & POLLIN) {
+			ok = receiveAll(fds[i].fd, protocols[i]) && ok;
+		}
+	}
+
+	// publish frames still missing universes, once they've waited enough
+	now_ms = tbdrNowMs();
+	bool held = now_ms < sync_until_ms[0] || now_ms < sync_until_ms[1];
+	for (uint8_t c = 0; c < TINYBRITE_PIPELINE_MAXCHAINS; c++) {
+		DMXChain & dc = chains[c];
+		if (dc.received
+				&& now_ms - dc.first_received_ms
+						>= TINYBRITE_DMX_FRAME_TIMEOUT_MS
+				&& !(held && dc.published)) {
+			// (if published but no longer held, the sync stopped coming)
+			publish(c, held);
+			latch_pending = latch_pending || !held;
+		}
+	}
+
+	// one trigger for all the frames this batch completed
+	if (latch_pending) {
+		pipeline.trigger();
+		latch_pending = false;
+	}
+
+	return ok;
+}
+
+/*
+ ** receiveAll
+ ** Read everything waiting on a socket, a batch at a time.
+ */
+bool TinyBriteDMXReceiver::receiveAll(int fd, uint8_t protocol) {
+	for (;;) {
+		int num = recvmmsg(fd, messages, TINYBRITE_DMX_BATCH, MSG_DONTWAIT,
+				NULL);
+		if (num < 0) {
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+
+		now_ms = tbdrNowMs();
+		for (int i = 0; i < num; i++) {
+			packets_received++;
+			size_t len = messages[i].msg_len;
+			bool handled = !(messages[i].msg_hdr.msg_flags & MSG_TRUNC)
+					&& ((protocol == TINYBRITE_DMX_ARTNET) ?
+							handleArtNet(buffers[i], len) :
+							handleE131(buffers[i], len));
+			if (!handled) {
+				packets_ignored++;
+			}
+		}
+
+		if (num < TINYBRITE_DMX_BATCH) {
+			return true;
+		}
+	}
+}
+
+bool TinyBriteDMXReceiver::handleArtNet(const uint8_t * packet, size_t len) {
+	if (len < TBDR_ARTNET_SYNC_SIZE
+			|| memcmp(packet, tbdr_artnet_id, sizeof(tbdr_artnet_id))) {
+		return false;
+	}
+
+	uint16_t opcode = packet[8] | (packet[9] << 8);
+
+	if (opcode == TBDR_ARTNET_OP_SYNC) {
+		sync(TINYBRITE_DMX_ARTNET);
+		return true;
+	}
+
+	if (opcode != TBDR_ARTNET_OP_DMX || len < TBDR_ARTNET_DMX_HEADER) {
+		return false;
+	}
+
+	uint16_t universe = packet[14] | ((packet[15] & 0x7F) << 8);
+	uint16_t dataLen = TBDR_BE16(packet + 16);
+	if (dataLen > TINYBRITE_DMX_CHANNELS
+			|| (size_t) TBDR_ARTNET_DMX_HEADER + dataLen > len) {
+		return false;
+	}
+
+	return universeData(TINYBRITE_DMX_ARTNET, universe, packet[12],
+			packet + TBDR_ARTNET_DMX_HEADER, dataLen,
+			now_ms < sync_until_ms[TBDR_SLOT(TINYBRITE_DMX_ARTNET)]);
+}
+
+bool TinyBriteDMXReceiver::handleE131(const uint8_t * packet, size_t len) {
+	if (len < TBDR_E131_SYNC_SIZE
+			|| memcmp(packet, tbdr_e131_id, sizeof(tbdr_e131_id))) {
+		return false;
+	}
+
+	uint32_t rootVector = TBDR_BE32(packet + TBDR_E131_ROOT_VECTOR);
+	uint32_t framingVector = TBDR_BE32(packet + TBDR_E131_FRAMING_VECTOR);
+
+	if (rootVector == TBDR_E131_VECTOR_EXTENDED
+			&& framingVector == TBDR_E131_VECTOR_SYNC_PACKET) {
+		uint16_t syncUniverse = TBDR_BE16(packet + TBDR_E131_SYNC_UNIVERSE);
+		if (!syncUniverse || syncUniverse != e131_sync_universe) {
+			return false;
+		}
+		sync(TINYBRITE_DMX_E131);
+		return true;
+	}
+
+	if (rootVector != TBDR_E131_VECTOR_DATA
+			|| framingVector != TBDR_E131_VECTOR_DATA_PACKET
+			|| len < TBDR_E131_DATA_HEADER
+			|| packet[TBDR_E131_DMP_VECTOR] != 0x02
+			|| packet[TBDR_E131_DMP_FORMAT] != 0xA1) {
+		return false;
+	}
+
+	uint8_t options = packet[TBDR_E131_OPTIONS];
+	uint16_t count = TBDR_BE16(packet + TBDR_E131_PROPERTY_COUNT);
+	if ((options & (TBDR_E131_OPTION_PREVIEW | TBDR_E131_OPTION_TERMINATED))
+			|| !count || count > TINYBRITE_DMX_CHANNELS + 1
+			|| TBDR_E131_START_CODE + (size_t) count > len
+			|| packet[TBDR_E131_START_CODE] != 0) {
+		// not for display, or not dimmer data
+		return false;
+	}
+
+	uint16_t syncUniverse = TBDR_BE16(packet + TBDR_E131_SYNC_ADDRESS);
+	if (syncUniverse != e131_sync_universe) {
+		// sync packets go to the sync universe's multicast group
+		if (e131_sync_universe) {
+			joinGroup(e131_sync_universe, false);
+		}
+		if (syncUniverse) {
+			joinGroup(syncUniverse, true);
+		}
+		e131_sync_universe = syncUniverse;
+	}
+
+	return universeData(TINYBRITE_DMX_E131,
+			TBDR_BE16(packet + TBDR_E131_UNIVERSE), packet[TBDR_E131_SEQUENCE],
+			packet + TBDR_E131_DATA_HEADER, count - 1,
+			syncUniverse
+					&& now_ms < sync_until_ms[TBDR_SLOT(TINYBRITE_DMX_E131)]);
+}
+
+/*
+ ** universeData
+ ** Write a universe's data into every chain it's mapped to, and publish
+ ** those chains' frames if complete (to be latched once the batch is
+ ** done, unless held for a sync packet).  Returns false if the universe isn't mapped.
+ */
+bool TinyBriteDMXReceiver::universeData(uint8_t protocol, uint16_t universe,
+		uint8_t sequence, const uint8_t * data, uint16_t len, bool held) {
+	uint8_t slot = TBDR_SLOT(protocol);
+	bool first = true;
+
+	for (uint8_t i = 0; i < num_mappings; i++) {
+		DMXMapping & m = mappings[i];
+		if (m.universe != universe) {
+			continue;
+		}
+
+		if (first) {
+			// E1.31 6.7.2: drop packets up to 19 behind the last one
+			int8_t ahead = (int8_t) (sequence - m.sequence[slot]);
+			if (m.have_sequence[slot] && ahead <= 0 && ahead > -20
+					&& !(protocol == TINYBRITE_DMX_ARTNET && !sequence)) {
+				packets_out_of_order++;
+				return true;
+			}
+			first = false;
+		}
+		m.sequence[slot] = sequence;
+		m.have_sequence[slot] = true;
+
+		DMXChain & dc = chains[m.chain];
+		uint8_t step = 3 * m.depth;
+		const uint8_t * channel = data + m.first_channel;
+		const uint8_t * end = data + len;
+		// the first device in the chain is sent last
+		uint16_t * rgb = dc.rgb + 3 * (dc.num_devices - 1 - m.first_device);
+
+		for (DriverNum d = 0; d < m.num_devices && channel + step <= end; d++) {
+			for (uint8_t c = 0; c < 3; c++) {
+				if (m.depth == TINYBRITE_DMX_16BIT) {
+					rgb[c] = TBDR_BE16(channel + 2 * c) >> 6;
+				} else {
+					// 0xFF becomes 0x3FF
+					rgb[c] = (channel[c] << 2) | (channel[c] >> 6);
+				}
+			}
+			channel += step;
+			rgb -= 3;
+		}
+
+		if (!dc.received) {
+			dc.first_received_ms = now_ms;
+		}
+		dc.received |= 1ULL << i;
+
+		if ((dc.received & dc.mapped) == dc.mapped && !dc.published) {
+			// everything's in: start shifting it, at least
+			publish(m.chain, held);
+			latch_pending = latch_pending || !held;
+		}
+	}
+
+	return !first;
+}
+
+/*
+ ** sync
+ ** Publish whatever came in since the last sync, and latch it all.
+ */
+void TinyBriteDMXReceiver::sync(uint8_t protocol) {
+	syncs_received++;
+	sync_until_ms[TBDR_SLOT(protocol)] = now_ms + TINYBRITE_DMX_SYNC_TIMEOUT_MS;
+
+	for (uint8_t c = 0; c < TINYBRITE_PIPELINE_MAXCHAINS; c++) {
+		if (chains[c].received && !chains[c].published) {
+			publish(c, false);
+		}
+		// latched now, whether published before or just now
+		chains[c].published = false;
+	}
+
+	pipeline.trigger();
+	latch_pending = false;
+}
+
+/*
+ ** publish
+ ** Hand the chain's frame over to its output thread, held until the next
+ ** sync packet or not.  If the queue is full, the pipeline counts the
+ ** frame as dropped, and what it held is sent with the next one.
+ */
+void TinyBriteDMXReceiver::publish(uint8_t chain, bool held) {
+	DMXChain & dc = chains[chain];
+	TinyBriteFrameQueue * q = pipeline.queue(chain);
+
+	uint32_t * packets = q->acquire();
+	if (packets) {
+		encodeColorFrame(dc.rgb, packets, dc.num_devices);
+		q->publish();
+		frames_published++;
+	}
+
+	dc.received = 0;
+	dc.published = held;
+}
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
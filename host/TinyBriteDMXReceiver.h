@@ -0,0 +1,243 @@
+/*
+
+ TinyBriteDMXReceiver.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Art-Net and sACN (E1.31) receiver, feeding chains from a lighting desk.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ For Linux controllers (TINYBRITE_PLATFORM_LINUX) taking DMX over
+ Ethernet.  The receiver listens for Art-Net (ArtDmx and ArtSync, UDP
+ port 6454) and E1.31 (data and sync packets, UDP port 5568, unicast or
+ multicast) and writes each universe into the chains of a
+ TinyBritePipeline, whose output threads shift and latch them.
+
+ Universes are mapped with addUniverse(): a run of channels, from
+ first_channel (1 to 512), goes to num_devices consecutive devices of a
+ chain, from first_device (0 is closest to the uC), three channels per
+ device (red, green, blue) or six with 16-bit channels (coarse, then
+ fine).  A universe may be split over several chains, and a chain may
+ take several universes.  The same universe number is matched in both
+ protocols (an Art-Net port-address, or an E1.31 universe).
+
+ A chain's frame is published once every universe mapped to it has come
+ in, or TINYBRITE_DMX_FRAME_TIMEOUT_MS after the first one did, so a
+ frame isn't held back by a universe that the desk didn't resend.  When
+ to latch depends on the desk:
+
+	 no sync         frames latch as soon as they are published
+	 ArtSync, or     frames are shifted in as they arrive, and latched,
+	 E1.31 sync      all together, on the sync packet
+
+ As with Art-Net nodes, the receiver goes back to latching without sync
+ if no sync packet comes for TINYBRITE_DMX_SYNC_TIMEOUT_MS.  Latching
+ on sync needs a pipeline without a clock (frames_per_second of 0): with
+ a clock, frames just latch on the next tick.
+
+ Packets are read TINYBRITE_DMX_BATCH at a time (with recvmmsg()) into
+ buffers held by the receiver, and go straight into each chain's frame:
+ nothing is allocated once begin() has been called.  Sequence numbers are
+ checked as E1.31 says (a packet up to 20 behind the last one is
+ dropped), for both protocols.  Merging several sources, priorities and
+ answering ArtPoll are left to the desk's side: point it at the
+ controller's address (or use multicast, for E1.31).
+
+ host/TinyBriteDMXGenerator.cpp sends test packets, to try all this
+ out on localhost (see host/TinyBriteDMXBridge.cpp).
+
+ Usage:
+
+ TinyBrite chain(340);
+ TinyBriteLinuxTransport bus;
+ TinyBritePipeline pipeline(0); // no clock: latch on sync
+ TinyBriteDMXReceiver receiver(pipeline);
+
+ // set up the chain and its transport, as for TinyBritePipeline
+ pipeline.addChain(chain, bus);
+
+ receiver.addUniverse(1, 0, 0, 170);   // universe 1: devices 0 to 169
+ receiver.addUniverse(2, 0, 170, 170); // universe 2: devices 170 to 339
+ receiver.begin();
+ pipeline.start();
+
+ while (running)
+	 receiver.service(100);
+
+ Build with -DTINYBRITE_PLATFORM_LINUX and -pthread, compiling
+ TinyBriteDMXReceiver.cpp, TinyBritePipeline.cpp, TinyBriteColorFrame.cpp
+ and TinyBriteLinuxTransport.cpp along with the library's .cpp files.
+
+*/
+
+#ifndef TinyBriteDMXReceiver_h
+#define TinyBriteDMXReceiver_h
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "TinyBritePipeline.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+#define TINYBRITE_DMX_ARTNET_PORT			6454
+#define TINYBRITE_DMX_E131_PORT				5568
+
+/* Protocols to listen for, for begin() */
+#define TINYBRITE_DMX_ARTNET				0x01
+#define TINYBRITE_DMX_E131					0x02
+
+/* Bytes per colour, for addUniverse() */
+#define TINYBRITE_DMX_8BIT					1
+#define TINYBRITE_DMX_16BIT					2
+
+#define TINYBRITE_DMX_CHANNELS				512
+
+#define TINYBRITE_DMX_MAXMAPPINGS			64
+#define TINYBRITE_DMX_BATCH					32
+/* Largest packet we handle: a full E1.31 data packet */
+#define TINYBRITE_DMX_MAXPACKET				638
+
+#define TINYBRITE_DMX_FRAME_TIMEOUT_MS		25
+#define TINYBRITE_DMX_SYNC_TIMEOUT_MS		4000
+
+class TinyBriteDMXReceiver
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteDMXReceiver constructor.
+	 ** Call with the pipeline, once its chains have been added.
+	 */
+	TinyBriteDMXReceiver(TinyBritePipeline & pipeline);
+	~TinyBriteDMXReceiver();
+
+	/*
+	 ** addUniverse
+	 ** Map channels of a universe onto devices of one of the pipeline's
+	 ** chains, before begin().  Returns false if they don't fit (in the
+	 ** universe or the chain), or there are too many mappings.
+	 */
+	bool addUniverse(uint16_t universe, uint8_t chain, DriverNum first_device,
+			DriverNum num_devices, uint16_t first_channel = 1,
+			uint8_t depth = TINYBRITE_DMX_8BIT);
+
+	/*
+	 ** begin
+	 ** Open the sockets for the given protocols, joining the E1.31
+	 ** multicast groups on the interface with the given address (NULL for
+	 ** the default one).
+	 */
+	bool begin(uint8_t protocols = TINYBRITE_DMX_ARTNET | TINYBRITE_DMX_E131,
+			const char * interface_address = NULL);
+	void end();
+
+	/*
+	 ** service
+	 ** Wait up to timeout_ms for packets, and handle all there are.
+	 ** Returns false if the sockets failed.
+	 */
+	bool service(int timeout_ms);
+
+	/*
+	 ** syncMode
+	 ** Whether a sync packet came recently, for the given protocol.
+	 */
+	bool syncMode(uint8_t protocol);
+
+	/*
+	 ** Statistics.
+	 ** Ignored packets are those we don't handle (other Art-Net opcodes,
+	 ** E1.31 previews...) or whose universe isn't mapped.  Frames dropped
+	 ** because the pipeline had no room are counted by the pipeline.
+	 */
+	unsigned long packetsReceived() { return packets_received; }
+	unsigned long packetsIgnored() { return packets_ignored; }
+	unsigned long packetsOutOfOrder() { return packets_out_of_order; }
+	unsigned long syncsReceived() { return syncs_received; }
+	unsigned long framesPublished() { return frames_published; }
+
+private:
+
+	typedef struct DMXMapping {
+		uint16_t universe;
+		uint16_t first_channel;
+		uint8_t chain;
+		uint8_t depth;
+		DriverNum first_device;
+		DriverNum num_devices;
+		// last sequence number, per protocol (0 before any)
+		uint8_t sequence[2];
+		bool have_sequence[2];
+	} DMXMapping;
+
+	typedef struct DMXChain {
+		// red, green and blue for each device, in the order they are sent
+		uint16_t * rgb;
+		DriverNum num_devices;
+		// one bit per mapping: those feeding this chain, and those received
+		uint64_t mapped;
+		uint64_t received;
+		unsigned long long first_received_ms;
+		// a frame is waiting for the sync packet
+		bool published;
+	} DMXChain;
+
+	bool handleArtNet(const uint8_t * packet, size_t len);
+	bool handleE131(const uint8_t * packet, size_t len);
+	bool receiveAll(int fd, uint8_t protocol);
+	bool universeData(uint8_t protocol, uint16_t universe, uint8_t sequence,
+			const uint8_t * data, uint16_t len, bool held);
+	void sync(uint8_t protocol);
+	void publish(uint8_t chain, bool held);
+	void joinGroup(uint16_t universe, bool join);
+
+	TinyBritePipeline & pipeline;
+
+	DMXMapping mappings[TINYBRITE_DMX_MAXMAPPINGS];
+	uint8_t num_mappings;
+	DMXChain chains[TINYBRITE_PIPELINE_MAXCHAINS];
+
+	int artnet_fd;
+	int e131_fd;
+	uint32_t interface_addr;
+	uint16_t e131_sync_universe;
+	unsigned long long now_ms;
+	unsigned long long sync_until_ms[2];
+
+	struct mmsghdr messages[TINYBRITE_DMX_BATCH];
+	struct iovec vectors[TINYBRITE_DMX_BATCH];
+	uint8_t buffers[TINYBRITE_DMX_BATCH][TINYBRITE_DMX_MAXPACKET];
+
+	unsigned long packets_received;
+	unsigned long packets_ignored;
+	unsigned long packets_out_of_order;
+	unsigned long syncs_received;
+	unsigned long frames_published;
+
+	// frames were published without sync, and want a trigger
+	bool latch_pending;
+
+};
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
+
+#endif
@@ -0,0 +1,173 @@
+/*
+
+ TinyBriteFrameEncoder.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the host-side frame encoder.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBriteFrameEncoder.h for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "TinyBriteFrameEncoder.h"
+
+#define TBFE_PUTENTRY(out, value) \
+	*out++ = (uint8_t)((value) >> 24); \
+	*out++ = (uint8_t)((value) >> 16); \
+	*out++ = (uint8_t)((value) >> 8); \
+	*out++ = (uint8_t)(value);
+
+TinyBriteFrameEncoder::TinyBriteFrameEncoder(uint16_t numDevices,
+		uint16_t keyframeInterval) :
+		num_devices(numDevices), keyframe_interval(keyframeInterval), max_delta_entries(
+				TINYBRITE_ENCODER_DEFAULT_MAX_DELTA_ENTRIES), since_keyframe(0), have_previous(false), last_was_keyframe(false), previous(NULL) {
+
+	if (num_devices) {
+		previous = (uint32_t*) malloc(sizeof(uint32_t) * num_devices);
+	}
+}
+
+TinyBriteFrameEncoder::~TinyBriteFrameEncoder() {
+	free(previous);
+}
+
+uint32_t TinyBriteFrameEncoder::entry(uint16_t red, uint16_t green,
+		uint16_t blue) {
+	return (((uint32_t) red & TINYBRITE_FRAME_ENTRY_COLORMASK)
+			<< TINYBRITE_FRAME_ENTRY_RED_SHIFT)
+			| (((uint32_t) green & TINYBRITE_FRAME_ENTRY_COLORMASK)
+					<< TINYBRITE_FRAME_ENTRY_GREEN_SHIFT)
+			| (((uint32_t) blue & TINYBRITE_FRAME_ENTRY_COLORMASK)
+					<< TINYBRITE_FRAME_ENTRY_BLUE_SHIFT);
+}
+
+size_t TinyBriteFrameEncoder::fullFrameSize(uint16_t numDevices) {
+	return TINYBRITE_FRAME_HEADER_SIZE
+			+ (size_t) numDevices * TINYBRITE_FRAME_ENTRY_SIZE
+			+ TINYBRITE_FRAME_CHECKSUM_SIZE;
+}
+
+size_t TinyBriteFrameEncoder::deltaFrameSize(uint16_t numChanged) {
+	return TINYBRITE_FRAME_HEADER_SIZE
+			+ (size_t) numChanged * TINYBRITE_FRAME_DELTA_ENTRY_SIZE
+			+ TINYBRITE_FRAME_CHECKSUM_SIZE;
+}
+
+size_t TinyBriteFrameEncoder::maxEncodedSize(uint16_t numDevices) {
+	// we never send a delta that costs more than a full frame
+	return fullFrameSize(numDevices);
+}
+
+void TinyBriteFrameEncoder::forceKeyframe() {
+	have_previous = false;
+}
+
+size_t TinyBriteFrameEncoder::encode(const uint32_t * entries, uint8_t * out) {
+	if (!previous) {
+		return 0;
+	}
+
+	size_t len;
+
+	if (!have_previous || since_keyframe >= keyframe_interval) {
+		len = encodeFull(entries, out);
+	} else {
+		uint16_t numChanged = 0;
+		for (uint16_t i = 0; i < num_devices; i++) {
+			if (entries[i] != previous[i]) {
+				numChanged++;
+			}
+		}
+
+		if (!numChanged) {
+			// nothing to say, but count the frame toward the next keyframe
+			since_keyframe++;
+			return 0;
+		}
+
+		if (numChanged <= max_delta_entries
+				&& deltaFrameSize(numChanged) < fullFrameSize(num_devices)) {
+			len = encodeDelta(entries, numChanged, out);
+		} else {
+			len = encodeFull(entries, out);
+		}
+	}
+
+	memcpy(previous, entries, sizeof(uint32_t) * num_devices);
+	have_previous = true;
+
+	return len;
+}
+
+/*
+ ** Both encoders produce the header, the payload and the checksum
+ ** described in includes/TinyBriteFrameProtocol.h.
+ */
+static uint8_t * tbfe_header(uint8_t * out, uint8_t type, uint16_t len) {
+	*out++ = TINYBRITE_FRAME_SYNC0;
+	*out++ = TINYBRITE_FRAME_SYNC1;
+	*out++ = type;
+	*out++ = (uint8_t)(len >> 8);
+	*out++ = (uint8_t) len;
+	return out;
+}
+
+static size_t tbfe_checksum(uint8_t * frame, uint8_t * end) {
+	uint8_t sum1 = 0;
+	uint8_t sum2 = 0;
+	// sync bytes aren't part of the checksum
+	for (uint8_t * p = frame + 2; p < end; p++) {
+		sum1 += *p;
+		sum2 += sum1;
+	}
+	*end++ = sum1;
+	*end++ = sum2;
+	return end - frame;
+}
+
+size_t TinyBriteFrameEncoder::encodeFull(const uint32_t * entries,
+		uint8_t * out) {
+	uint8_t * p = tbfe_header(out, TINYBRITE_FRAME_TYPE_FULL, num_devices);
+
+	for (uint16_t i = 0; i < num_devices; i++) {
+		TBFE_PUTENTRY(p, entries[i]);
+	}
+
+	since_keyframe = 0;
+	last_was_keyframe = true;
+	return tbfe_checksum(out, p);
+}
+
+size_t TinyBriteFrameEncoder::encodeDelta(const uint32_t * entries,
+		uint16_t numChanged, uint8_t * out) {
+	uint8_t * p = tbfe_header(out, TINYBRITE_FRAME_TYPE_DELTA, numChanged);
+
+	for (uint16_t i = 0; i < num_devices; i++) {
+		if (entries[i] == previous[i]) {
+			continue;
+		}
+		*p++ = (uint8_t)(i >> 8);
+		*p++ = (uint8_t) i;
+		TBFE_PUTENTRY(p, entries[i]);
+	}
+
+	since_keyframe++;
+	last_was_keyframe = false;
+	return tbfe_checksum(out, p);
+}
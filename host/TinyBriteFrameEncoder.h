@@ -0,0 +1,146 @@
+/*
+
+ TinyBriteFrameEncoder.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Host-side (Linux/PC) encoder for frames sent to a TinyBriteSerialSink.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ This code runs on the show controller, not on the uC.  It turns each
+ frame for the chain into bytes for the protocol in
+ includes/TinyBriteFrameProtocol.h, choosing whichever of a full frame
+ or a delta frame (only the changed devices) is cheaper to send, and
+ forcing a full keyframe every keyframe_interval frames so the receiver
+ recovers from lost frames.  Deltas are also kept within what the
+ receiver can stage (see setMaxDeltaEntries()).
+
+ Frames are arrays of entries, one per device in shift order (the
+ first entry winds up furthest from the uC), built with entry(r, g, b).
+
+ Usage:
+
+ TinyBriteFrameEncoder encoder(num_devices);
+ uint8_t * buf = (uint8_t*)malloc(TinyBriteFrameEncoder::maxEncodedSize(num_devices));
+
+ // for each frame
+ size_t len = encoder.encode(frame_entries, buf);
+ if (len)
+	 write(serial_fd, buf, len);
+
+ To build, compile TinyBriteFrameEncoder.cpp along with your program,
+ with the library root on the include path, e.g.
+	g++ -O2 -I path/to/TinyBrite myshow.cpp path/to/TinyBrite/host/TinyBriteFrameEncoder.cpp
+
+*/
+
+#ifndef TinyBriteFrameEncoder_h
+#define TinyBriteFrameEncoder_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../includes/TinyBriteFrameProtocol.h"
+
+#define TINYBRITE_ENCODER_DEFAULT_KEYFRAME_INTERVAL		30
+
+/* TinyBriteSerialSink's default, see TINYBRITE_SINK_DEFAULT_DELTA_ENTRIES */
+#define TINYBRITE_ENCODER_DEFAULT_MAX_DELTA_ENTRIES		16
+
+class TinyBriteFrameEncoder
+
+{
+
+public:
+
+	/*
+	 ** TinyBriteFrameEncoder constructor.
+	 ** Call with the number of devices in the chain and the maximum number
+	 ** of frames between two keyframes.
+	 */
+	TinyBriteFrameEncoder(uint16_t num_devices, uint16_t keyframe_interval =
+			TINYBRITE_ENCODER_DEFAULT_KEYFRAME_INTERVAL);
+	~TinyBriteFrameEncoder();
+
+	/*
+	 ** entry
+	 ** Pack 10-bit red, green and blue values into a frame entry.
+	 */
+	static uint32_t entry(uint16_t red, uint16_t green, uint16_t blue);
+
+	/*
+	 ** maxEncodedSize
+	 ** Largest number of bytes encode() may produce for a chain of num_devices.
+	 */
+	static size_t maxEncodedSize(uint16_t num_devices);
+
+	/*
+	 ** fullFrameSize / deltaFrameSize
+	 ** Bytes on the wire for a full frame, or a delta of num_changed devices.
+	 */
+	static size_t fullFrameSize(uint16_t num_devices);
+	static size_t deltaFrameSize(uint16_t num_changed);
+
+	/*
+	 ** encode
+	 ** Encode the next frame into out (which must hold maxEncodedSize() bytes).
+	 ** Returns the number of bytes to send, which is 0 if nothing changed
+	 ** and no keyframe is due.
+	 */
+	size_t encode(const uint32_t * entries, uint8_t * out);
+
+	/*
+	 ** forceKeyframe
+	 ** Make the next encode() produce a full frame, e.g. when the receiver
+	 ** has just been reset.
+	 */
+	void forceKeyframe();
+
+	/*
+	 ** setMaxDeltaEntries
+	 ** Send a full frame, rather than a delta, when more than num_entries
+	 ** devices changed: set this to the receiving sink's max_delta_entries.
+	 */
+	void setMaxDeltaEntries(uint16_t num_entries) { max_delta_entries = num_entries; }
+
+	/*
+	 ** lastWasKeyframe
+	 ** Whether the last non-empty encode() produced a full frame.
+	 */
+	bool lastWasKeyframe() { return last_was_keyframe; }
+
+	bool valid() { return previous != NULL; }
+
+private:
+
+	size_t encodeFull(const uint32_t * entries, uint8_t * out);
+	size_t encodeDelta(const uint32_t * entries, uint16_t num_changed,
+			uint8_t * out);
+
+	uint16_t num_devices;
+	uint16_t keyframe_interval;
+	uint16_t max_delta_entries;
+	uint16_t since_keyframe;
+	bool have_previous;
+	bool last_was_keyframe;
+	uint32_t * previous;
+
+};
+
+#endif
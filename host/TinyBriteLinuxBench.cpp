@@ -0,0 +1,168 @@
+/*
+
+ TinyBriteLinuxBench.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Frame throughput benchmark for the Linux platform.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ Sends frames as fast as it can, through the whole library (colour
+ packets, update cycle and latch), and reports frames per second,
+ throughput and system calls per frame.  Build, from the library
+ directory, with:
+
+	g++ -O2 -DTINYBRITE_PLATFORM_LINUX -I. -o tinybrite-bench *.cpp \
+		host/TinyBriteLinuxTransport.cpp host/TinyBriteLinuxBench.cpp
+
+ and run it against the hardware:
+
+	./tinybrite-bench -s /dev/spidev0.0 -g /dev/gpiochip0 -l 25 -n 500
+
+ or, anywhere, against a file or pipe:
+
+	./tinybrite-bench -o /dev/null -n 500 -f 10000
+
+ Options:
+	-s DEVICE   spidev device to send to
+	-S HZ       SPI clock rate (default 2000000)
+	-g DEVICE   GPIO chip with the latch line
+	-l LINE     latch line offset (default 25)
+	-o PATH     file or pipe to send to, instead of SPI
+	-n DEVICES  length of the chain (default 100)
+	-f FRAMES   number of frames to send (default 1000)
+	-m BYTES    largest single SPI message (default 4096)
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "TinyBrite.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+static void usage(const char * name) {
+	fprintf(stderr,
+			"usage: %s (-s SPIDEV [-S HZ] [-g GPIOCHIP -l LINE] | -o PATH)\n"
+					"\t[-n DEVICES] [-f FRAMES] [-m BYTES]\n", name);
+}
+
+int main(int argc, char * argv[]) {
+	const char * spiDevice = NULL;
+	const char * gpioChip = NULL;
+	const char * outPath = NULL;
+	uint32_t speed = 2000000;
+	uint8_t latchLine = 25;
+	unsigned long numDevices = 100;
+	unsigned long numFrames = 1000;
+	size_t maxTransfer = TINYBRITE_LINUX_DEFAULT_MAX_TRANSFER;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "s:S:g:l:o:n:f:m:")) != -1) {
+		switch (opt) {
+		case 's':
+			spiDevice = optarg;
+			break;
+		case 'S':
+			speed = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			gpioChip = optarg;
+			break;
+		case 'l':
+			latchLine = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			outPath = optarg;
+			break;
+		case 'n':
+			numDevices = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			numFrames = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			maxTransfer = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if ((!spiDevice && !outPath) || !numDevices || !numFrames) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	TinyBriteLinuxTransport & transport = TinyBriteLinuxTransport::instance();
+	transport.setMaxTransfer(maxTransfer);
+
+	if (spiDevice && !transport.openSPI(spiDevice, speed)) {
+		perror(spiDevice);
+		return 1;
+	}
+	if (outPath && !transport.openFile(outPath)) {
+		perror(outPath);
+		return 1;
+	}
+	if (gpioChip && !transport.openGPIO(gpioChip)) {
+		perror(gpioChip);
+		return 1;
+	}
+
+	TinyBrite chain(numDevices);
+	chain.setup(0, 0, latchLine);
+	chain.setAutoUpdate(false);
+
+	unsigned long start = MCU::micros();
+
+	for (unsigned long frame = 0; frame < numFrames; frame++) {
+		chain.beginUpdate();
+		for (unsigned long i = 0; i < numDevices; i++) {
+			// a hue wheel, moving along the chain
+			uint16_t level = ((frame + i) * 16) & TINYBRITE_COLOR_MAXVALUE;
+			chain.sendColor(level, TINYBRITE_COLOR_MAXVALUE - level, 0);
+		}
+		chain.endUpdate();
+	}
+
+	unsigned long elapsed = MCU::micros() - start;
+	if (!elapsed) {
+		elapsed = 1;
+	}
+
+	double seconds = elapsed / 1000000.0;
+	printf("%lu frames of %lu devices in %.3f s\n", numFrames, numDevices,
+			seconds);
+	printf("%.1f frames/s, %.3f MB/s, %.2f transfers/frame, %lu errors\n",
+			numFrames / seconds, transport.bytesSent() / seconds / 1000000.0,
+			(double) transport.transfers() / numFrames, transport.errors());
+
+	if (spiDevice) {
+		// what the wire itself allows, for comparison
+		printf("(SPI clock limit: %.1f frames/s)\n",
+				speed / (32.0 * numDevices));
+	}
+
+	transport.close();
+
+	return transport.errors() ? 2 : 0;
+}
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
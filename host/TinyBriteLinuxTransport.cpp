@@ -0,0 +1,303 @@
+/*
+
+ TinyBriteLinuxTransport.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the Linux spidev/GPIO transport.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See includes/TB_Platform_Linux.h for details.
+ */
+
+#include "../includes/TinyBritePlatform.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include <linux/gpio.h>
+
+/* room for this many packets, to begin with */
+#define TBLT_INITIAL_QUEUE_PACKETS	256
+
+static thread_local TinyBriteLinuxTransport * tbltCurrent = NULL;
+
+TinyBriteLinuxTransport & TinyBriteLinuxTransport::instance() {
+	static TinyBriteLinuxTransport theTransport;
+	return tbltCurrent ? *tbltCurrent : theTransport;
+}
+
+void TinyBriteLinuxTransport::use(TinyBriteLinuxTransport * transport) {
+	tbltCurrent = transport;
+}
+
+TinyBriteLinuxTransport::TinyBriteLinuxTransport() :
+		spi_fd(-1), file_fd(-1), gpio_fd(-1), speed(0), queue(NULL), queue_len(
+				0), queue_size(0), max_transfer(
+				TINYBRITE_LINUX_DEFAULT_MAX_TRANSFER), bytes_sent(0), num_transfers(
+				0), num_errors(0) {
+
+	for (uint8_t i = 0; i < TINYBRITE_LINUX_MAX_GPIO_LINES; i++) {
+		line_fd[i] = -1;
+	}
+}
+
+TinyBriteLinuxTransport::~TinyBriteLinuxTransport() {
+	close();
+	free(queue);
+}
+
+bool TinyBriteLinuxTransport::openSPI(const char * device, uint32_t speed_hz) {
+	int fd = ::open(device, O_RDWR);
+	if (fd < 0) {
+		return false;
+	}
+
+	uint8_t mode = SPI_MODE_0;
+	uint8_t bits = 8;
+	uint8_t lsbFirst = 0;
+
+	if (ioctl(fd, SPI_IOC_WR_MODE, &mode) < 0
+			|| ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0
+			|| ioctl(fd, SPI_IOC_WR_LSB_FIRST, &lsbFirst) < 0
+			|| ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) < 0) {
+		::close(fd);
+		return false;
+	}
+
+	if (spi_fd >= 0) {
+		::close(spi_fd);
+	}
+	spi_fd = fd;
+	speed = speed_hz;
+
+	return true;
+}
+
+bool TinyBriteLinuxTransport::openGPIO(const char * chip_device) {
+	int fd = ::open(chip_device, O_RDWR);
+	if (fd < 0) {
+		return false;
+	}
+
+	if (gpio_fd >= 0) {
+		::close(gpio_fd);
+	}
+	gpio_fd = fd;
+
+	return true;
+}
+
+bool TinyBriteLinuxTransport::openFile(const char * path) {
+	int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+
+	if (file_fd >= 0) {
+		::close(file_fd);
+	}
+	file_fd = fd;
+
+	return true;
+}
+
+void TinyBriteLinuxTransport::close() {
+	flush();
+
+	for (uint8_t i = 0; i < TINYBRITE_LINUX_MAX_GPIO_LINES; i++) {
+		if (line_fd[i] >= 0) {
+			::close(line_fd[i]);
+			line_fd[i] = -1;
+		}
+	}
+
+	if (gpio_fd >= 0) {
+		::close(gpio_fd);
+		gpio_fd = -1;
+	}
+	if (spi_fd >= 0) {
+		::close(spi_fd);
+		spi_fd = -1;
+	}
+	if (file_fd >= 0) {
+		::close(file_fd);
+		file_fd = -1;
+	}
+}
+
+void TinyBriteLinuxTransport::setMaxTransfer(size_t num_bytes) {
+	// keep it to whole packets
+	num_bytes -= num_bytes % sizeof(uint32_t);
+	max_transfer = num_bytes ? num_bytes : sizeof(uint32_t);
+}
+
+void TinyBriteLinuxTransport::requestLine(uint8_t line, uint8_t mode) {
+	if (gpio_fd < 0 || line >= TINYBRITE_LINUX_MAX_GPIO_LINES) {
+		return;
+	}
+
+	if (line_fd[line] >= 0) {
+		::close(line_fd[line]);
+		line_fd[line] = -1;
+	}
+
+	struct gpiohandle_request request;
+	memset(&request, 0, sizeof(request));
+	request.lineoffsets[0] = line;
+	request.lines = 1;
+	request.flags =
+			(mode == OUTPUT) ? GPIOHANDLE_REQUEST_OUTPUT : GPIOHANDLE_REQUEST_INPUT;
+	strncpy(request.consumer_label, "TinyBrite",
+			sizeof(request.consumer_label) - 1);
+
+	if (ioctl(gpio_fd, GPIO_GET_LINEHANDLE_IOCTL, &request) < 0) {
+		num_errors++;
+		return;
+	}
+
+	line_fd[line] = request.fd;
+}
+
+void TinyBriteLinuxTransport::setLine(uint8_t line, bool value) {
+	if (line >= TINYBRITE_LINUX_MAX_GPIO_LINES || line_fd[line] < 0) {
+		return;
+	}
+
+	struct gpiohandle_data data;
+	memset(&data, 0, sizeof(data));
+	data.values[0] = value ? 1 : 0;
+
+	if (ioctl(line_fd[line], GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) < 0) {
+		num_errors++;
+	}
+}
+
+bool TinyBriteLinuxTransport::getLine(uint8_t line) {
+	if (line >= TINYBRITE_LINUX_MAX_GPIO_LINES || line_fd[line] < 0) {
+		return false;
+	}
+
+	struct gpiohandle_data data;
+	memset(&data, 0, sizeof(data));
+
+	if (ioctl(line_fd[line], GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0) {
+		num_errors++;
+		return false;
+	}
+
+	return data.values[0] != 0;
+}
+
+void TinyBriteLinuxTransport::queuePacket(uint32_t value) {
+	if (queue_len + sizeof(uint32_t) > queue_size) {
+		// frames bigger than a single transfer go out in pieces anyway
+		if (queue_len >= max_transfer) {
+			flush();
+		}
+
+		if (queue_len + sizeof(uint32_t) > queue_size) {
+			size_t newSize =
+					queue_size ?
+							queue_size * 2 :
+							TBLT_INITIAL_QUEUE_PACKETS * sizeof(uint32_t);
+			uint8_t * newQueue = (uint8_t*) realloc(queue, newSize);
+			if (!newQueue) {
+				flush();
+				if (queue_len + sizeof(uint32_t) > queue_size) {
+					num_errors++;
+					return;
+				}
+			} else {
+				queue = newQueue;
+				queue_size = newSize;
+			}
+		}
+	}
+
+	// the A6281 wants the MSB first
+	uint8_t * bytes = queue + queue_len;
+	bytes[0] = value >> 24;
+	bytes[1] = value >> 16;
+	bytes[2] = value >> 8;
+	bytes[3] = value;
+	queue_len += sizeof(uint32_t);
+}
+
+bool TinyBriteLinuxTransport::transfer(const uint8_t * bytes, size_t len) {
+	num_transfers++;
+
+	if (spi_fd >= 0) {
+		struct spi_ioc_transfer message;
+		memset(&message, 0, sizeof(message));
+		message.tx_buf = (unsigned long) bytes;
+		message.len = len;
+		message.speed_hz = speed;
+		message.bits_per_word = 8;
+
+		if (ioctl(spi_fd, SPI_IOC_MESSAGE(1), &message) < 0) {
+			num_errors++;
+			return false;
+		}
+	} else if (file_fd >= 0) {
+		while (len) {
+			ssize_t written = write(file_fd, bytes, len);
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				num_errors++;
+				return false;
+			}
+			bytes += written;
+			len -= written;
+			bytes_sent += written;
+		}
+		return true;
+	} else {
+		// nowhere to send it
+		num_errors++;
+		return false;
+	}
+
+	bytes_sent += len;
+	return true;
+}
+
+bool TinyBriteLinuxTransport::flush() {
+	bool ok = true;
+
+	if (spi_fd >= 0) {
+		// spidev takes at most max_transfer bytes per message
+		for (size_t offset = 0; offset < queue_len; offset += max_transfer) {
+			size_t len = queue_len - offset;
+			if (len > max_transfer) {
+				len = max_transfer;
+			}
+			ok = transfer(queue + offset, len) && ok;
+		}
+	} else if (queue_len) {
+		ok = transfer(queue, queue_len);
+	}
+
+	queue_len = 0;
+	return ok;
+}
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
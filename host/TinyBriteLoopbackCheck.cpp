@@ -0,0 +1,245 @@
+/*
+
+ TinyBriteLoopbackCheck.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Checks chain length detection and verification, on a simulated chain.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ Runs detectChainLength() and verifyChain() against the shift registers
+ of TB_Platform_Simulator.h, with its DO wired back, for chains of 1, 7,
+ 100, 300 and 1000 devices (or the lengths given).  For each, it checks
+ that:
+
+	- a TinyBrite told the chain is longer than it is fails verifyChain(),
+	  detects the real length and resizes to it, then passes;
+	- one told the chain is shorter fails verifyChain();
+	- detection gives up (0, no resize) on a chain longer than max_drivers;
+	- a broken link, halfway down, fails both;
+	- nothing is latched meanwhile, and the shift registers get the
+	  tracked state back afterwards: the colours shown are kept.
+
+ Build, from the library directory, with:
+
+	g++ -O2 -DTINYBRITE_PLATFORM_SIMULATOR -DTA6281_LOOPBACK_ENABLE -I. \
+		-o tinybrite-loopcheck *.cpp host/TinyBriteChainSimulator.cpp \
+		host/TinyBriteLoopbackCheck.cpp
+
+ and run:
+
+	./tinybrite-loopcheck
+	./tinybrite-loopcheck -n 2 -n 4096
+
+ It exits with 0 if everything matched, and 2 otherwise.
+
+ Options:
+	-n DEVICES  check a chain of this length (repeatable; default 1, 7,
+	            100, 300 and 1000)
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "TinyBrite.h"
+
+#if defined(TINYBRITE_PLATFORM_SIMULATOR) && defined(TA6281_LOOPBACK_ENABLE)
+
+#define TBLC_MAXLENGTHS		16
+
+/* pins, as far as the simulator is concerned */
+#define TBLC_DATAPIN		0
+#define TBLC_CLOCKPIN		2
+#define TBLC_LATCHPIN		3
+#define TBLC_LOOPBACKPIN	4
+
+/* how much longer than the real chain the first TinyBrite is told it is */
+#define TBLC_OVERSTATED		3
+
+static unsigned long tblcFailures = 0;
+
+static void fail(uint16_t numDevices, const char * what) {
+	tblcFailures++;
+	fprintf(stderr, "%u devices: %s\n", numDevices, what);
+}
+
+/*
+ ** showFrame
+ ** Send a different colour to each device, and latch it.
+ */
+static void showFrame(TinyBrite & chain) {
+	chain.beginUpdate();
+	for (DriverNum i = 0; i < chain.numDrivers(); i++) {
+		chain.sendColor(i & TINYBRITE_COLOR_MAXVALUE, (i * 3) & 0xFF, 1);
+	}
+	chain.endUpdate();
+}
+
+/*
+ ** expectKept
+ ** Nothing new latched, and the shift registers hold what's shown again.
+ */
+static void expectKept(uint16_t numDevices, const char * step,
+		unsigned long latchesBefore) {
+	TinyBriteChainSimulator & sim = TinyBriteChainSimulator::instance();
+	char what[80];
+
+	if (sim.latches() != latchesBefore) {
+		snprintf(what, sizeof(what), "%s latched", step);
+		fail(numDevices, what);
+	}
+
+	for (uint16_t d = 0; d < numDevices; d++) {
+		if (sim.shiftRegister(d) != sim.latchedPWM(d)) {
+			snprintf(what, sizeof(what),
+					"%s: device %u holds 0x%08x, shows 0x%08x", step, d,
+					sim.shiftRegister(d), sim.latchedPWM(d));
+			fail(numDevices, what);
+			return;
+		}
+	}
+}
+
+static bool checkLength(uint16_t numDevices) {
+	unsigned long failuresBefore = tblcFailures;
+	TinyBriteChainSimulator & sim = TinyBriteChainSimulator::instance();
+
+	if (!sim.setLength(numDevices)) {
+		fail(numDevices, "out of memory");
+		return false;
+	}
+	sim.attach(TBLC_DATAPIN, TBLC_CLOCKPIN, TBLC_LATCHPIN, TBLC_LOOPBACKPIN);
+
+	// told there are more devices than there are
+	TinyBrite chain(numDevices + TBLC_OVERSTATED);
+	chain.setup(TBLC_DATAPIN, TBLC_CLOCKPIN, TBLC_LATCHPIN);
+	chain.setLoopbackPin(TBLC_LOOPBACKPIN);
+	chain.setAutoUpdate(false);
+	if (!chain.setStateTracking(true)) {
+		fail(numDevices, "can't track state");
+	}
+	showFrame(chain);
+	unsigned long latches = sim.latches();
+
+	if (chain.verifyChain()) {
+		fail(numDevices, "verifyChain() passed, with too many devices");
+	}
+	expectKept(numDevices, "verifyChain() (too many)", latches);
+
+	DriverNum found = chain.detectChainLength(numDevices + 10);
+	if (found != numDevices || chain.numDrivers() != numDevices) {
+		char what[80];
+		snprintf(what, sizeof(what), "detected %u devices, resized to %u",
+				found, chain.numDrivers());
+		fail(numDevices, what);
+	}
+	expectKept(numDevices, "detectChainLength()", latches);
+
+	if (!chain.verifyChain()) {
+		fail(numDevices, "verifyChain() failed, once resized");
+	}
+	expectKept(numDevices, "verifyChain()", latches);
+
+	// longer than max_drivers: not found, and left alone
+	if (numDevices > 1) {
+		if (chain.detectChainLength(numDevices - 1)) {
+			fail(numDevices, "detected past max_drivers");
+		}
+		if (chain.numDrivers() != numDevices) {
+			fail(numDevices, "resized, past max_drivers");
+		}
+		expectKept(numDevices, "detectChainLength() (past max_drivers)",
+				latches);
+
+		// told there are fewer devices than there are
+		TinyBrite shortChain(numDevices - 1);
+		shortChain.setup(TBLC_DATAPIN, TBLC_CLOCKPIN, TBLC_LATCHPIN);
+		shortChain.setLoopbackPin(TBLC_LOOPBACKPIN);
+		if (shortChain.verifyChain()) {
+			fail(numDevices, "verifyChain() passed, with too few devices");
+		}
+	}
+
+	// a link broken halfway down
+	sim.setStuck(numDevices / 2);
+	if (chain.detectChainLength(numDevices + 10, false)) {
+		fail(numDevices, "detected a broken chain");
+	}
+	if (chain.verifyChain()) {
+		fail(numDevices, "verifyChain() passed a broken chain");
+	}
+	sim.setStuck(TINYBRITE_SIMULATOR_NONE);
+
+	bool ok = (tblcFailures == failuresBefore);
+	printf("%5u devices: %s\n", numDevices, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+static void usage(const char * name) {
+	fprintf(stderr, "usage: %s [-n DEVICES]...\n", name);
+}
+
+int main(int argc, char * argv[]) {
+	unsigned long lengths[TBLC_MAXLENGTHS];
+	uint8_t numLengths = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			if (numLengths == TBLC_MAXLENGTHS) {
+				usage(argv[0]);
+				return 1;
+			}
+			lengths[numLengths++] = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!numLengths) {
+		lengths[numLengths++] = 1;
+		lengths[numLengths++] = 7;
+		lengths[numLengths++] = 100;
+		lengths[numLengths++] = 300;
+		lengths[numLengths++] = 1000;
+	}
+
+	for (uint8_t i = 0; i < numLengths; i++) {
+		// room for the devices the first TinyBrite is told about
+		if (!lengths[i]
+				|| lengths[i] + TBLC_OVERSTATED + 10 > (DriverNum) ~0) {
+			fprintf(stderr, "%lu devices: out of range\n", lengths[i]);
+			return 1;
+		}
+	}
+
+	for (uint8_t i = 0; i < numLengths; i++) {
+		checkLength(lengths[i]);
+	}
+
+	if (tblcFailures) {
+		printf("%lu failures\n", tblcFailures);
+		return 2;
+	}
+	return 0;
+}
+
+#endif /* TINYBRITE_PLATFORM_SIMULATOR && TA6281_LOOPBACK_ENABLE */
@@ -0,0 +1,413 @@
+/*
+
+ TinyBritePipeline.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Implementation of the render/output pipeline.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ See TinyBritePipeline.h for details.
+ */
+
+#include "TinyBritePipeline.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+#include <errno.h>
+#include <time.h>
+
+static unsigned long long tbpNow() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void tbpSleepUntil(unsigned long long ns) {
+	struct timespec ts;
+	ts.tv_sec = ns / 1000000000ULL;
+	ts.tv_nsec = ns % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+	}
+}
+
+/*
+ * TinyBriteFrameQueue
+ *
+ * head is only written by the producer, tail only by the consumer.  A
+ * frame's contents are made visible to the other side by the release
+ * store of the counter that hands it over, and the acquire load that
+ * sees it.
+ */
+
+TinyBriteFrameQueue::TinyBriteFrameQueue(DriverNum numDevices,
+		uint16_t capacity) :
+		num_devices(numDevices), num_slots(capacity ? capacity : 1), frames(
+				NULL), head(0), tail(0), max_depth(0), published(0), dropped(0) {
+
+	if (num_devices) {
+		frames = (uint32_t*) malloc(
+				sizeof(uint32_t) * num_devices * (size_t) num_slots);
+	}
+}
+
+TinyBriteFrameQueue::~TinyBriteFrameQueue() {
+	free(frames);
+}
+
+uint32_t * TinyBriteFrameQueue::acquire() {
+	unsigned long h = head.load(std::memory_order_relaxed);
+
+	if (h - tail.load(std::memory_order_acquire) >= num_slots) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return NULL;
+	}
+
+	return slot(h);
+}
+
+void TinyBriteFrameQueue::publish() {
+	unsigned long h = head.load(std::memory_order_relaxed) + 1;
+	head.store(h, std::memory_order_release);
+	published.fetch_add(1, std::memory_order_relaxed);
+
+	uint16_t waiting = h - tail.load(std::memory_order_relaxed);
+	if (waiting > max_depth.load(std::memory_order_relaxed)) {
+		max_depth.store(waiting, std::memory_order_relaxed);
+	}
+}
+
+const uint32_t * TinyBriteFrameQueue::front() {
+	unsigned long t = tail.load(std::memory_order_relaxed);
+
+	if (head.load(std::memory_order_acquire) == t) {
+		return NULL;
+	}
+
+	return slot(t);
+}
+
+void TinyBriteFrameQueue::release() {
+	tail.store(tail.load(std::memory_order_relaxed) + 1,
+			std::memory_order_release);
+}
+
+uint16_t TinyBriteFrameQueue::depth() {
+	unsigned long t = tail.load(std::memory_order_acquire);
+	return head.load(std::memory_order_acquire) - t;
+}
+
+/*
+ * TinyBritePipeline
+ */
+
+TinyBritePipeline::TinyBritePipeline(uint16_t frames_per_second,
+		uint16_t queueDepth) :
+		period_ns(frames_per_second ? 1000000000ULL / frames_per_second : 0), start_ns(
+				0), queue_depth(queueDepth), num_chains(0), is_running(false), num_triggers(
+				0) {
+
+	for (uint8_t i = 0; i < TINYBRITE_PIPELINE_MAXCHAINS; i++) {
+		chains[i].chain = NULL;
+		chains[i].transport = NULL;
+		chains[i].queue = NULL;
+		chains[i].shown = 0;
+		chains[i].missed = 0;
+		chains[i].late = 0;
+		chains[i].transmit_avg = 0;
+		chains[i].transmit_max = 0;
+	}
+}
+
+TinyBritePipeline::~TinyBritePipeline() {
+	stop();
+
+	for (uint8_t i = 0; i < num_chains; i++) {
+		delete chains[i].queue;
+	}
+}
+
+int8_t TinyBritePipeline::addChain(TinyA6281 & chain,
+		TinyBriteLinuxTransport & transport) {
+	if (is_running.load() || num_chains >= TINYBRITE_PIPELINE_MAXCHAINS) {
+		return -1;
+	}
+
+	TinyBriteFrameQueue * q = new TinyBriteFrameQueue(chain.numDrivers(),
+			queue_depth);
+	if (!q->valid()) {
+		delete q;
+		return -1;
+	}
+
+	PipelineChain & pc = chains[num_chains];
+	pc.chain = &chain;
+	pc.transport = &transport;
+	pc.queue = q;
+
+	return num_chains++;
+}
+
+TinyBriteFrameQueue * TinyBritePipeline::queue(uint8_t chain) {
+	return (chain < num_chains) ? chains[chain].queue : NULL;
+}
+
+bool TinyBritePipeline::start() {
+	if (is_running.load() || !num_chains) {
+		return false;
+	}
+
+	start_ns = tbpNow();
+	is_running.store(true);
+
+	for (uint8_t i = 0; i < num_chains; i++) {
+		chains[i].thread = std::thread(&TinyBritePipeline::output, this,
+				&chains[i]);
+	}
+
+	return true;
+}
+
+void TinyBritePipeline::stop() {
+	{
+		// under the lock, so no one waiting for a trigger misses this
+		std::lock_guard<std::mutex> guard(trigger_lock);
+		is_running.store(false);
+	}
+	trigger_done.notify_all();
+
+	for (uint8_t i = 0; i < num_chains; i++) {
+		if (chains[i].thread.joinable()) {
+			chains[i].thread.join();
+		}
+	}
+}
+
+unsigned long TinyBritePipeline::tick() {
+	if (triggered()) {
+		return num_triggers.load();
+	}
+
+	unsigned long long now = tbpNow();
+	if (!start_ns || now < start_ns) {
+		return 0;
+	}
+	return (now - start_ns) / period_ns;
+}
+
+void TinyBritePipeline::waitForTick(unsigned long t) {
+	if (!triggered()) {
+		tbpSleepUntil(tickTime(t));
+		return;
+	}
+
+	std::unique_lock<std::mutex> guard(trigger_lock);
+	trigger_done.wait(guard, [this, t] {
+		return num_triggers.load() >= t || !is_running.load();
+	});
+}
+
+void TinyBritePipeline::trigger() {
+	if (!triggered()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(trigger_lock);
+		num_triggers.fetch_add(1);
+	}
+	trigger_done.notify_all();
+}
+
+/*
+ ** waitForTrigger
+ ** Wait for a trigger past the given one, or, if idle, for a little
+ ** while at most (frames may be published without a trigger).
+ */
+void TinyBritePipeline::waitForTrigger(unsigned long after, bool idle) {
+	std::unique_lock<std::mutex> guard(trigger_lock);
+	auto due = [this, after] {
+		return num_triggers.load() > after || !is_running.load();
+	};
+
+	if (idle) {
+		trigger_done.wait_for(guard,
+				std::chrono::microseconds(TINYBRITE_PIPELINE_IDLE_POLL_US), due);
+	} else {
+		trigger_done.wait(guard, due);
+	}
+}
+
+/*
+ ** shiftFrame
+ ** Shift the next frame from the chain's queue in, without latching it.
+ ** Returns false if there was no frame.
+ */
+bool TinyBritePipeline::shiftFrame(PipelineChain * pc) {
+	TinyA6281 & chain = *(pc->chain);
+	TinyBriteFrameQueue * q = pc->queue;
+	DriverNum numDevices = q->numDevices();
+
+	const uint32_t * frame = q->front();
+	if (!frame) {
+		return false;
+	}
+
+	unsigned long long begin = tbpNow();
+
+	chain.beginUpdate();
+	for (DriverNum i = 0; i < numDevices; i++) {
+		A6281Packet packet = {value:frame[i]};
+		chain.sendPacket(packet);
+	}
+	// on the wire now, so the latch is all that's left for the tick
+	pc->transport->flush();
+	q->release();
+
+	unsigned long us = (tbpNow() - begin) / 1000;
+	unsigned long avg = pc->transmit_avg.load(std::memory_order_relaxed);
+	pc->transmit_avg.store(
+			avg ? (long) avg + ((long) us - (long) avg) / 8 : us,
+			std::memory_order_relaxed);
+	if (us > pc->transmit_max.load(std::memory_order_relaxed)) {
+		pc->transmit_max.store(us, std::memory_order_relaxed);
+	}
+
+	return true;
+}
+
+/*
+ ** output
+ ** The output thread for one chain.
+ */
+void TinyBritePipeline::output(PipelineChain * pc) {
+	TinyBriteLinuxTransport::use(pc->transport);
+
+	TinyA6281 & chain = *(pc->chain);
+
+	chain.setAutoUpdate(false);
+
+	if (triggered()) {
+		outputOnTrigger(pc);
+		TinyBriteLinuxTransport::use(NULL);
+		return;
+	}
+
+	unsigned long next = 1;
+	while (is_running.load()) {
+		bool pending = shiftFrame(pc);
+		if (!pending) {
+			pc->missed.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// ticks that went by in the meantime
+		unsigned long now = tick();
+		if (now >= next) {
+			unsigned long passed = now - next + 1;
+			if (pending) {
+				pc->late.fetch_add(passed, std::memory_order_relaxed);
+			} else {
+				pc->missed.fetch_add(passed, std::memory_order_relaxed);
+			}
+			next = now + 1;
+		}
+
+		tbpSleepUntil(tickTime(next));
+
+		if (pending) {
+			chain.endUpdate();
+			pc->shown.fetch_add(1, std::memory_order_relaxed);
+		}
+		next++;
+	}
+
+	TinyBriteLinuxTransport::use(NULL);
+}
+
+/*
+ ** outputOnTrigger
+ ** The output thread for one chain, without a clock.  used is the last
+ ** trigger this chain has had, whether it latched a frame then or had
+ ** none: the next frame goes with the one after.
+ */
+void TinyBritePipeline::outputOnTrigger(PipelineChain * pc) {
+	TinyA6281 & chain = *(pc->chain);
+
+	unsigned long used = tick();
+	while (is_running.load()) {
+		// frames are published before their trigger, so read it first
+		unsigned long now = tick();
+		if (!shiftFrame(pc)) {
+			if (now > used) {
+				pc->missed.fetch_add(now - used, std::memory_order_relaxed);
+				used = now;
+			}
+			waitForTrigger(used, true);
+			continue;
+		}
+
+		if (tick() > used) {
+			// triggered while the frame was on its way
+			pc->late.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			waitForTrigger(used, false);
+			if (!is_running.load()) {
+				break;
+			}
+		}
+
+		chain.endUpdate();
+		pc->shown.fetch_add(1, std::memory_order_relaxed);
+		// this frame's trigger only: another may already be for the next
+		used++;
+	}
+}
+
+#define TBP_CHAINSTAT(chain, member) \
+	((chain) < num_chains ? chains[chain].member.load(std::memory_order_relaxed) : 0)
+
+uint16_t TinyBritePipeline::queueDepth(uint8_t chain) {
+	return (chain < num_chains) ? chains[chain].queue->depth() : 0;
+}
+
+uint16_t TinyBritePipeline::maxQueueDepth(uint8_t chain) {
+	return (chain < num_chains) ? chains[chain].queue->maxDepth() : 0;
+}
+
+unsigned long TinyBritePipeline::framesDropped(uint8_t chain) {
+	return (chain < num_chains) ? chains[chain].queue->framesDropped() : 0;
+}
+
+unsigned long TinyBritePipeline::framesShown(uint8_t chain) {
+	return TBP_CHAINSTAT(chain, shown);
+}
+
+unsigned long TinyBritePipeline::ticksMissed(uint8_t chain) {
+	return TBP_CHAINSTAT(chain, missed);
+}
+
+unsigned long TinyBritePipeline::ticksLate(uint8_t chain) {
+	return TBP_CHAINSTAT(chain, late);
+}
+
+unsigned long TinyBritePipeline::transmitTimeAvg(uint8_t chain) {
+	return TBP_CHAINSTAT(chain, transmit_avg);
+}
+
+unsigned long TinyBritePipeline::transmitTimeMax(uint8_t chain) {
+	return TBP_CHAINSTAT(chain, transmit_max);
+}
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
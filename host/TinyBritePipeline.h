@@ -0,0 +1,292 @@
+/*
+
+ TinyBritePipeline.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Multi-threaded render/output pipeline for Linux controllers.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ For Linux controllers (TINYBRITE_PLATFORM_LINUX) driving several
+ chains, each on its own SPI bus.  Rather than computing a frame, then
+ sending it, then computing the next, the work is spread over threads:
+
+	 renderers   your threads, computing frames and publishing them,
+	             one queue per chain
+	 outputs     one thread per chain, started by the pipeline, which
+	             takes the next frame from its queue, shifts it into the
+	             chain through the TinyA6281 send path, then waits for
+	             the frame tick to latch it
+
+ Every chain latches on the same tick (frames_per_second of them per
+ second, from the same clock), so they stay in step, while rendering and
+ transmitting happen at the same time on different cores.
+
+ Each queue is a ring of frames with a single producer (one renderer)
+ and a single consumer (the chain's output thread): neither side ever
+ takes a lock or waits for the other.  A renderer that gets ahead finds
+ the queue full, and that frame is dropped; an output thread that finds
+ its queue empty at a tick leaves the chain showing the last frame.
+
+ Without a clock (frames_per_second of 0), ticks only come from
+ trigger(), e.g. when a lighting desk sends a sync packet (see
+ TinyBriteDMXReceiver.h).  Each chain still shifts its next frame in as
+ soon as it is published, then latches it at the next trigger, or right
+ away if a trigger came while it was being sent.  Either way, a chain
+ latches at most one frame per trigger.
+
+ A frame is one packet value per device, in the order they are sent
+ (i.e. last device first), such as encodeColorFrame() produces.
+
+ Chains must be set up, with their transport in use (see
+ TB_Platform_Linux.h), before being added.  Once the pipeline has
+ started, only its output threads may touch them.
+
+ Usage:
+
+ TinyBrite left(500), right(500);
+ TinyBriteLinuxTransport leftBus, rightBus;
+ TinyBritePipeline pipeline(40);
+
+ // for each chain
+ leftBus.openSPI("/dev/spidev0.0", 2000000);
+ leftBus.openGPIO("/dev/gpiochip0");
+ TinyBriteLinuxTransport::use(&leftBus);
+ left.setup(0, 0, 25);
+ pipeline.addChain(left, leftBus);
+ ...
+ TinyBriteLinuxTransport::use(NULL);
+
+ pipeline.start();
+
+ // in the renderer thread for chain 0
+ TinyBriteFrameQueue * queue = pipeline.queue(0);
+ for (unsigned long frame = 0; ; frame++) {
+	 uint32_t * packets = queue->acquire();
+	 if (packets) {
+		 // fill in the packets
+		 queue->publish();
+	 }
+	 pipeline.waitForTick(frame + 1);
+ }
+
+ Build with -DTINYBRITE_PLATFORM_LINUX and -pthread, compiling
+ TinyBritePipeline.cpp and TinyBriteLinuxTransport.cpp along with the
+ library's .cpp files.
+
+*/
+
+#ifndef TinyBritePipeline_h
+#define TinyBritePipeline_h
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "../TinyBrite.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+#define TINYBRITE_PIPELINE_MAXCHAINS		8
+#define TINYBRITE_PIPELINE_DEFAULT_DEPTH	3
+
+/* How often idle output threads look for a frame, without a clock */
+#define TINYBRITE_PIPELINE_IDLE_POLL_US		500
+
+/*
+ ** TinyBriteFrameQueue
+ ** Lock-free single-producer, single-consumer ring of frames.
+ */
+class TinyBriteFrameQueue
+
+{
+
+public:
+
+	TinyBriteFrameQueue(DriverNum num_devices, uint16_t capacity);
+	~TinyBriteFrameQueue();
+
+	bool valid() { return frames != NULL; }
+
+	/*
+	 ** Producer side.
+	 ** acquire() returns the frame to fill in, or NULL if the queue is full
+	 ** (and the frame is counted as dropped).  publish() hands it over.
+	 */
+	uint32_t * acquire();
+	void publish();
+
+	/*
+	 ** Consumer side.
+	 ** front() returns the oldest frame, or NULL if there is none, and
+	 ** release() gives it back once it has been used.
+	 */
+	const uint32_t * front();
+	void release();
+
+	/*
+	 ** Statistics, which may be read from any thread.
+	 */
+	uint16_t depth();
+	uint16_t maxDepth() { return max_depth.load(std::memory_order_relaxed); }
+	unsigned long framesPublished() {
+		return published.load(std::memory_order_relaxed);
+	}
+	unsigned long framesDropped() {
+		return dropped.load(std::memory_order_relaxed);
+	}
+
+	uint16_t capacity() { return num_slots; }
+	DriverNum numDevices() { return num_devices; }
+
+private:
+
+	uint32_t * slot(unsigned long position) {
+		return frames + (position % num_slots) * num_devices;
+	}
+
+	DriverNum num_devices;
+	uint16_t num_slots;
+	uint32_t * frames;
+
+	// frames published and released, so far: head - tail are waiting
+	std::atomic<unsigned long> head;
+	std::atomic<unsigned long> tail;
+
+	std::atomic<uint16_t> max_depth;
+	std::atomic<unsigned long> published;
+	std::atomic<unsigned long> dropped;
+
+};
+
+class TinyBritePipeline
+
+{
+
+public:
+
+	/*
+	 ** TinyBritePipeline constructor.
+	 ** Call with the frame rate (0 for ticks from trigger() only) and the
+	 ** number of frames each queue holds.
+	 */
+	TinyBritePipeline(uint16_t frames_per_second, uint16_t queue_depth =
+			TINYBRITE_PIPELINE_DEFAULT_DEPTH);
+	~TinyBritePipeline();
+
+	/*
+	 ** addChain
+	 ** Add a chain (already set up) and its transport, before start().
+	 ** Returns the chain's index, or -1 on failure.
+	 */
+	int8_t addChain(TinyA6281 & chain, TinyBriteLinuxTransport & transport);
+
+	uint8_t numChains() { return num_chains; }
+
+	/*
+	 ** queue
+	 ** Where the renderer for the given chain publishes frames.
+	 */
+	TinyBriteFrameQueue * queue(uint8_t chain);
+
+	/*
+	 ** start / stop
+	 ** Start the output threads (the first tick comes one period after
+	 ** start()), or stop and wait for them.
+	 */
+	bool start();
+	void stop();
+	bool running() { return is_running.load(); }
+
+	/*
+	 ** tick / waitForTick
+	 ** The number of the last tick, and a way for renderers to keep pace.
+	 */
+	unsigned long tick();
+	void waitForTick(unsigned long tick);
+
+	/*
+	 ** trigger
+	 ** Without a clock, make the next tick happen now.  Does nothing
+	 ** otherwise.
+	 */
+	void trigger();
+	bool triggered() { return !period_ns; }
+
+	unsigned long framePeriodUs() { return period_ns / 1000; }
+
+	/*
+	 ** Statistics, per chain.
+	 ** Ticks missed are those at which no new frame was ready, ticks late
+	 ** those that went by while the frame was still being sent (it is then
+	 ** latched on the following tick, or right away without a clock).
+	 ** Transmit time is how long shifting a frame out takes, in
+	 ** microseconds.
+	 */
+	uint16_t queueDepth(uint8_t chain);
+	uint16_t maxQueueDepth(uint8_t chain);
+	unsigned long framesDropped(uint8_t chain);
+	unsigned long framesShown(uint8_t chain);
+	unsigned long ticksMissed(uint8_t chain);
+	unsigned long ticksLate(uint8_t chain);
+	unsigned long transmitTimeAvg(uint8_t chain);
+	unsigned long transmitTimeMax(uint8_t chain);
+
+private:
+
+	typedef struct PipelineChain {
+		TinyA6281 * chain;
+		TinyBriteLinuxTransport * transport;
+		TinyBriteFrameQueue * queue;
+		std::thread thread;
+
+		std::atomic<unsigned long> shown;
+		std::atomic<unsigned long> missed;
+		std::atomic<unsigned long> late;
+		std::atomic<unsigned long> transmit_avg;
+		std::atomic<unsigned long> transmit_max;
+	} PipelineChain;
+
+	void output(PipelineChain * pc);
+	void outputOnTrigger(PipelineChain * pc);
+	bool shiftFrame(PipelineChain * pc);
+	void waitForTrigger(unsigned long after, bool idle);
+	unsigned long long tickTime(unsigned long tick) {
+		return start_ns + (unsigned long long) tick * period_ns;
+	}
+
+	unsigned long long period_ns;
+	unsigned long long start_ns;
+	uint16_t queue_depth;
+
+	PipelineChain chains[TINYBRITE_PIPELINE_MAXCHAINS];
+	uint8_t num_chains;
+
+	std::atomic<bool> is_running;
+
+	std::atomic<unsigned long> num_triggers;
+	std::mutex trigger_lock;
+	std::condition_variable trigger_done;
+
+};
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
+
+#endif
@@ -0,0 +1,180 @@
+/*
+
+ TinyBritePipelineBench.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Exercises the render/output pipeline and reports its statistics.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ Runs a number of chains, each sent to a file or pipe (so it runs on any
+ Linux box) by its own output thread and fed by its own renderer thread,
+ which encodes a moving gradient with encodeColorFrame().  Build, from
+ the library directory, with:
+
+	g++ -O2 -pthread -DTINYBRITE_PLATFORM_LINUX -I. -o tinybrite-pipeline \
+		*.cpp host/TinyBriteLinuxTransport.cpp host/TinyBriteColorFrame.cpp \
+		host/TinyBritePipeline.cpp host/TinyBritePipelineBench.cpp
+
+ and run it with:
+
+	./tinybrite-pipeline [-c CHAINS] [-n DEVICES] [-r FPS] [-t SECONDS] \
+		[-q DEPTH] [-o PATH]
+
+ Each chain's output goes to PATH (default /dev/null).
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "TinyBrite.h"
+#include "host/TinyBriteColorFrame.h"
+#include "host/TinyBritePipeline.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+typedef struct Renderer {
+	TinyBritePipeline * pipeline;
+	TinyBriteFrameQueue * queue;
+	uint16_t * rgb;
+} Renderer;
+
+static void render(Renderer * r) {
+	DriverNum numDevices = r->queue->numDevices();
+
+	for (unsigned long frame = 0; r->pipeline->running(); frame++) {
+		uint32_t * packets = r->queue->acquire();
+		if (packets) {
+			for (DriverNum i = 0; i < numDevices; i++) {
+				uint16_t level = ((frame + i) * 8) & TINYBRITE_COLOR_MAXVALUE;
+				r->rgb[3 * i] = level;
+				r->rgb[3 * i + 1] = TINYBRITE_COLOR_MAXVALUE - level;
+				r->rgb[3 * i + 2] = 0;
+			}
+			encodeColorFrame(r->rgb, packets, numDevices);
+			r->queue->publish();
+		}
+
+		// keep a frame ahead of the output
+		r->pipeline->waitForTick(r->pipeline->tick() + 1);
+	}
+}
+
+int main(int argc, char * argv[]) {
+	unsigned long numChains = 2;
+	unsigned long numDevices = 1000;
+	unsigned long fps = 60;
+	unsigned long seconds = 3;
+	unsigned long depth = TINYBRITE_PIPELINE_DEFAULT_DEPTH;
+	const char * outPath = "/dev/null";
+
+	int opt;
+	while ((opt = getopt(argc, argv, "c:n:r:t:q:o:")) != -1) {
+		switch (opt) {
+		case 'c':
+			numChains = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			numDevices = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			fps = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			depth = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			outPath = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-c CHAINS] [-n DEVICES] [-r FPS] "
+					"[-t SECONDS] [-q DEPTH] [-o PATH]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!numChains || numChains > TINYBRITE_PIPELINE_MAXCHAINS || !numDevices
+			|| !fps) {
+		fprintf(stderr, "bad arguments\n");
+		return 1;
+	}
+
+	TinyBritePipeline pipeline(fps, depth);
+	TinyBriteLinuxTransport transports[TINYBRITE_PIPELINE_MAXCHAINS];
+	TinyBrite * chains[TINYBRITE_PIPELINE_MAXCHAINS];
+	Renderer renderers[TINYBRITE_PIPELINE_MAXCHAINS];
+	std::thread threads[TINYBRITE_PIPELINE_MAXCHAINS];
+
+	for (unsigned long c = 0; c < numChains; c++) {
+		if (!transports[c].openFile(outPath)) {
+			perror(outPath);
+			return 1;
+		}
+
+		TinyBriteLinuxTransport::use(&transports[c]);
+		chains[c] = new TinyBrite(numDevices);
+		chains[c]->setup(0, 0, 0);
+		if (pipeline.addChain(*chains[c], transports[c]) < 0) {
+			fprintf(stderr, "could not add chain %lu\n", c);
+			return 1;
+		}
+
+		renderers[c].pipeline = &pipeline;
+		renderers[c].queue = pipeline.queue(c);
+		renderers[c].rgb = (uint16_t*) malloc(
+				3 * numDevices * sizeof(uint16_t));
+	}
+	TinyBriteLinuxTransport::use(NULL);
+
+	pipeline.start();
+	for (unsigned long c = 0; c < numChains; c++) {
+		threads[c] = std::thread(render, &renderers[c]);
+	}
+
+	sleep(seconds);
+
+	pipeline.stop();
+	for (unsigned long c = 0; c < numChains; c++) {
+		threads[c].join();
+	}
+
+	printf("%lu chains of %lu devices, %lu fps (%lu us), %lu ticks\n",
+			numChains, numDevices, fps, pipeline.framePeriodUs(),
+			pipeline.tick());
+	printf("chain    shown  dropped  missed  late  depth(max)  "
+			"transmit avg/max (us)\n");
+	for (unsigned long c = 0; c < numChains; c++) {
+		printf("%5lu %8lu %8lu %7lu %5lu %6u (%u) %10lu / %lu\n", c,
+				pipeline.framesShown(c), pipeline.framesDropped(c),
+				pipeline.ticksMissed(c), pipeline.ticksLate(c),
+				pipeline.queueDepth(c), pipeline.maxQueueDepth(c),
+				pipeline.transmitTimeAvg(c), pipeline.transmitTimeMax(c));
+	}
+
+	for (unsigned long c = 0; c < numChains; c++) {
+		delete chains[c];
+		free(renderers[c].rgb);
+	}
+
+	return 0;
+}
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
@@ -0,0 +1,960 @@
+/*
+
+ TinyBriteShowTool.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Turns image sequences and colour timelines into show data for flash.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ Reads a show, one frame per image or from a CSV timeline, and encodes
+ it with TinyBriteFrameEncoder into the byte stream described in
+ includes/TinyBriteFrameProtocol.h: the first frame is a keyframe, and
+ every later frame is whichever of a full or a delta frame is smaller
+ (or nothing at all, if no device changed), deltas being kept within
+ what the sink can stage (-d).  On the uC, the stream is
+ fed to a TinyBriteSerialSink, straight from flash.
+
+ Inputs are either:
+
+   - PPM images (P6 or P3, any maxval), one frame each, all the same
+     size.  A file may hold several images back to back, as written by
+     e.g. ffmpeg -i clip.mp4 -vf scale=8:4 -f image2pipe -c:v ppm - so
+     video can be piped in, with "-" as the file name.  Pixels are placed
+     in the chain as a TinyBriteMatrix of that size would (-l, -R).
+
+   - PNG images, in the same way, if built with TINYBRITE_SHOW_PNG
+     defined (and -lpng).
+
+   - a CSV timeline (.csv), one colour change per line:
+
+		frame,device,red,green,blue
+		frame,x,y,red,green,blue       (with -x and -y)
+
+     where device is the position in the chain (0 is closest to the uC)
+     and colours go from 0 to the -m value.  A device keeps its colour
+     until changed; lines starting with # (and a header line) are
+     skipped.
+
+ Colours are quantised to the 10 bits of the A6281 through an optional
+ gamma curve.  Build, from the library directory, with:
+
+	g++ -O2 -DTINYBRITE_PLATFORM_LINUX -I. -o tinybrite-show *.cpp \
+		host/TinyBriteLinuxTransport.cpp host/TinyBriteFrameEncoder.cpp \
+		host/TinyBriteShowTool.cpp -lm
+
+ adding -DTINYBRITE_SHOW_PNG ... -lpng for PNG input, and run it as:
+
+	./tinybrite-show -l serpentine -g 2.2 -r 25 -o show.h frame*.ppm
+	./tinybrite-show -n 30 -N alarm -o alarm.h alarm.csv
+
+ Options:
+	-l LAYOUT   rowmajor, serpentine (default), columnmajor or
+	            columnserpentine, as for TinyBriteMatrix
+	-R DEGREES  panel rotation: 0 (default), 90, 180 or 270
+	-x WIDTH    matrix width, for CSV x,y lines
+	-y HEIGHT   matrix height, for CSV x,y lines
+	-n DEVICES  length of the chain (default: the number of pixels)
+	-m MAX      largest CSV colour value (default 255)
+	-g GAMMA    gamma applied when quantising (default 1.0, linear)
+	-k FRAMES   also force a keyframe every FRAMES frames (default 0:
+	            only the first frame is one)
+	-K          keyframes only, for sketches without state tracking
+	-d ENTRIES  most changes in a delta frame (default 16, the sink's
+	            default max_delta_entries)
+	-r FPS      playback rate (default 30)
+	-M MHZ      uC clock, for the CPU estimate (default 16)
+	-o PATH     output: a C header if PATH ends in .h, a binary otherwise
+	-N NAME     prefix for the names in the C header (default show)
+
+ Without -o, only the statistics are printed: bytes per frame and an
+ estimate of the uC time each frame takes to play back.  That estimate
+ is TBST_CYCLES_PER_BYTE cycles per byte read and parsed, plus, for
+ every packet shifted out, 32 bits of TBST_CYCLES_PER_BIT cycles and two
+ TA6281_CLOCK_DELAY_US delays.  Delta frames are applied to the tracked
+ state and the whole chain is then refreshed, so they save flash and
+ parsing, not shifting.  The cycle counts are rough figures for an AVR
+ with digitalWrite(): measure on the real thing if it's close.
+
+ The C header holds:
+
+	NAME_NUM_FRAMES, NAME_NUM_DEVICES, NAME_FRAME_RATE
+	NAME_STATE_TRACKING   1 if there are delta frames (the sketch then
+	                      needs TA6281_STATE_TRACKING_ENABLE and
+	                      setStateTracking(true))
+	NAME_MAX_DELTA_ENTRIES  the -d value, for the sink
+	name_data[]           the encoded stream
+	name_frames[]         where each frame starts in name_data, plus the
+	                      end (a frame where nothing changed is empty)
+
+ and is played with:
+
+	#include <TinyBriteSerialSink.h>
+	#include "show.h"
+
+	TinyBrite brite_chain(SHOW_NUM_DEVICES);
+	TinyBriteSerialSink sink(brite_chain, SHOW_MAX_DELTA_ENTRIES);
+	uint16_t frame = 0;
+
+	void loop() {
+		uint32_t at, end;
+		MCU::flashRead(&at, &show_frames[frame], sizeof(at));
+		MCU::flashRead(&end, &show_frames[frame + 1], sizeof(end));
+		while (at < end) {
+			uint8_t buf[32];
+			uint16_t len = (end - at < sizeof(buf)) ? end - at : sizeof(buf);
+			MCU::flashRead(buf, show_data + at, len);
+			sink.ingest(buf, len);
+			at += len;
+		}
+		// frame 0 is a keyframe, so the show can loop
+		frame = (frame + 1) % SHOW_NUM_FRAMES;
+		delay(1000 / SHOW_FRAME_RATE);
+	}
+
+ The binary holds the same, all big-endian: "TBSH", the number of
+ frames, devices and frames per second (16 bits each), the
+ NUM_FRAMES + 1 frame offsets (32 bits each), then the stream.
+
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef TINYBRITE_SHOW_PNG
+#include <png.h>
+#endif
+
+#include "TinyBrite.h"
+#include "TinyBriteMatrix.h"
+#include "host/TinyBriteFrameEncoder.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+/* Rough cost of playback on the uC, in cycles (see above) */
+#define TBST_CYCLES_PER_BYTE		60
+#define TBST_CYCLES_PER_BIT			200
+
+/* Flash arrays larger than this don't work on an AVR */
+#define TBST_AVR_MAX_ARRAY			32767UL
+
+#define TBST_CSV_MAXLINE			256
+
+typedef struct ShowImage {
+	unsigned int width;
+	unsigned int height;
+	unsigned int maxval;
+	uint16_t * rgb;
+} ShowImage;
+
+typedef struct ShowEvent {
+	unsigned long frame;
+	unsigned long line;
+	DriverNum device;
+	unsigned int red, green, blue;
+} ShowEvent;
+
+/*
+ ** ShowFrames
+ ** The whole show, in entries (shift order, as for the encoder), one
+ ** frame after the other.
+ */
+typedef struct ShowFrames {
+	uint16_t num_devices;
+	unsigned long num_frames;
+	unsigned long capacity;
+	uint32_t * entries;
+} ShowFrames;
+
+static void usage(const char * name) {
+	fprintf(stderr,
+			"usage: %s [-l LAYOUT] [-R DEGREES] [-x WIDTH -y HEIGHT] [-n DEVICES]\n"
+					"\t[-m MAX] [-g GAMMA] [-k FRAMES] [-K] [-d ENTRIES] [-r FPS]\n"
+					"\t[-M MHZ] [-o PATH] [-N NAME] INPUT...\n", name);
+}
+
+static uint32_t * addFrame(ShowFrames & show) {
+	if (show.num_frames == show.capacity) {
+		unsigned long capacity = show.capacity ? show.capacity * 2 : 64;
+		uint32_t * entries = (uint32_t*) realloc(show.entries,
+				sizeof(uint32_t) * show.num_devices * capacity);
+		if (!entries) {
+			return NULL;
+		}
+		show.entries = entries;
+		show.capacity = capacity;
+	}
+	return show.entries + show.num_devices * show.num_frames++;
+}
+
+static const uint32_t * frameEntries(const ShowFrames & show,
+		unsigned long frame) {
+	return show.entries + show.num_devices * frame;
+}
+
+/*
+ ** Quantisation
+ ** From 0..maxval to 10 bits, through the gamma curve, as a table.
+ */
+static uint16_t * quantTable(unsigned int maxval, double gamma) {
+	uint16_t * table = (uint16_t*) malloc(sizeof(uint16_t) * (maxval + 1));
+	if (!table) {
+		return NULL;
+	}
+	for (unsigned int v = 0; v <= maxval; v++) {
+		table[v] = (uint16_t) (pow((double) v / maxval, gamma)
+				* TINYBRITE_COLOR_MAXVALUE + 0.5);
+	}
+	return table;
+}
+
+static bool endsWith(const char * str, const char * suffix) {
+	size_t len = strlen(str);
+	size_t suffixLen = strlen(suffix);
+	return len >= suffixLen && !strcasecmp(str + len - suffixLen, suffix);
+}
+
+/*
+ ** PPM
+ ** Header tokens are separated by whitespace, and may have comments in
+ ** between.  Returns 0 at the end of the file, -1 on an error.
+ */
+static int ppmToken(FILE * in, unsigned int & value) {
+	int c;
+	do {
+		c = getc(in);
+		if (c == '#') {
+			while (c != '\n' && c != EOF) {
+				c = getc(in);
+			}
+		}
+	} while (c != EOF && isspace(c));
+
+	if (c == EOF) {
+		return 0;
+	}
+	if (!isdigit(c)) {
+		return -1;
+	}
+
+	value = 0;
+	while (c != EOF && isdigit(c)) {
+		value = value * 10 + (c - '0');
+		c = getc(in);
+	}
+	return 1;
+}
+
+static int readPPM(FILE * in, ShowImage & image) {
+	int c;
+	do {
+		c = getc(in);
+	} while (c != EOF && isspace(c));
+	if (c == EOF) {
+		return 0;
+	}
+
+	int format = getc(in);
+	if (c != 'P' || (format != '3' && format != '6')) {
+		return -1;
+	}
+
+	if (ppmToken(in, image.width) <= 0 || ppmToken(in, image.height) <= 0
+			|| ppmToken(in, image.maxval) <= 0 || !image.width
+			|| !image.height || !image.maxval || image.maxval > 65535) {
+		return -1;
+	}
+
+	size_t numValues = (size_t) image.width * image.height * 3;
+	image.rgb = (uint16_t*) malloc(sizeof(uint16_t) * numValues);
+	if (!image.rgb) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < numValues; i++) {
+		unsigned int value;
+		if (format == '3') {
+			if (ppmToken(in, value) <= 0) {
+				return -1;
+			}
+		} else if (image.maxval < 256) {
+			if ((c = getc(in)) == EOF) {
+				return -1;
+			}
+			value = c;
+		} else {
+			int hi = getc(in);
+			int lo = getc(in);
+			if (hi == EOF || lo == EOF) {
+				return -1;
+			}
+			value = (hi << 8) | lo;
+		}
+		if (value > image.maxval) {
+			return -1;
+		}
+		image.rgb[i] = value;
+	}
+
+	return 1;
+}
+
+#ifdef TINYBRITE_SHOW_PNG
+static int readPNG(const char * path, ShowImage & image) {
+	png_image png;
+	memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_file(&png, path)) {
+		return -1;
+	}
+
+	png.format = PNG_FORMAT_RGB;
+	size_t numValues = PNG_IMAGE_SIZE(png);
+	uint8_t * pixels = (uint8_t*) malloc(numValues);
+	image.rgb = (uint16_t*) malloc(sizeof(uint16_t) * numValues);
+	if (!(pixels && image.rgb)
+			|| !png_image_finish_read(&png, NULL, pixels, 0, NULL)) {
+		png_image_free(&png);
+		free(pixels);
+		return -1;
+	}
+
+	image.width = png.width;
+	image.height = png.height;
+	image.maxval = 255;
+	for (size_t i = 0; i < numValues; i++) {
+		image.rgb[i] = pixels[i];
+	}
+	free(pixels);
+	return 1;
+}
+#endif
+
+/*
+ ** ShowMapping
+ ** Where each pixel of the images goes, as an entry position.
+ */
+typedef struct ShowMapping {
+	unsigned int width;
+	unsigned int height;
+	uint16_t * position;
+} ShowMapping;
+
+static bool mapMatrix(ShowMapping & mapping, uint16_t numDevices,
+		uint8_t layout, uint8_t rotation) {
+	bool turned = (rotation == TINYBRITE_MATRIX_ROTATE_90
+			|| rotation == TINYBRITE_MATRIX_ROTATE_270);
+	unsigned int numPixels = mapping.width * mapping.height;
+	if (mapping.width > 255 || mapping.height > 255 || numPixels > numDevices) {
+		return false;
+	}
+
+	// only used to work out the chain positions: never set up
+	TinyBrite chain(numDevices);
+	TinyBriteMatrix matrix(chain, turned ? mapping.height : mapping.width,
+			turned ? mapping.width : mapping.height, layout, rotation);
+
+	mapping.position = (uint16_t*) malloc(sizeof(uint16_t) * numPixels);
+	if (!mapping.position) {
+		return false;
+	}
+
+	for (unsigned int y = 0; y < mapping.height; y++) {
+		for (unsigned int x = 0; x < mapping.width; x++) {
+			// the first entry winds up furthest from the uC
+			mapping.position[y * mapping.width + x] = numDevices - 1
+					- matrix.chainIndex(x, y);
+		}
+	}
+	return true;
+}
+
+static bool addImage(ShowFrames & show, const ShowMapping & mapping,
+		const ShowImage & image, const uint16_t * quant) {
+	uint32_t * entries = addFrame(show);
+	if (!entries) {
+		return false;
+	}
+
+	// devices beyond the matrix stay dark
+	memset(entries, 0, sizeof(uint32_t) * show.num_devices);
+	for (unsigned int i = 0; i < mapping.width * mapping.height; i++) {
+		const uint16_t * rgb = image.rgb + i * 3;
+		entries[mapping.position[i]] = TinyBriteFrameEncoder::entry(
+				quant[rgb[0]], quant[rgb[1]], quant[rgb[2]]);
+	}
+	return true;
+}
+
+/*
+ ** readImages
+ ** One frame per image, in the order given.
+ */
+static bool readImages(ShowFrames & show, char * const * paths,
+		int numPaths, unsigned long numDevices, uint8_t layout,
+		uint8_t rotation, double gamma) {
+	ShowMapping mapping = { 0, 0, NULL };
+	uint16_t * quant = NULL;
+	unsigned int quantMax = 0;
+	bool ok = true;
+
+	for (int p = 0; ok && p < numPaths; p++) {
+		const char * path = paths[p];
+		FILE * in = NULL;
+		bool png = endsWith(path, ".png");
+
+		if (!png) {
+			in = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+			if (!in) {
+				perror(path);
+				ok = false;
+				break;
+			}
+		}
+
+		for (;;) {
+			ShowImage image = { 0, 0, 0, NULL };
+			int status;
+			if (png) {
+#ifdef TINYBRITE_SHOW_PNG
+				status = readPNG(path, image);
+#else
+				fprintf(stderr, "%s: built without PNG support "
+						"(see TINYBRITE_SHOW_PNG)\n", path);
+				status = -1;
+#endif
+			} else {
+				status = readPPM(in, image);
+			}
+
+			if (status < 0) {
+				fprintf(stderr, "%s: can't read frame %lu\n", path,
+						show.num_frames);
+				ok = false;
+			} else if (status > 0) {
+				if (!mapping.position) {
+					// the first image sets the size of the matrix
+					mapping.width = image.width;
+					mapping.height = image.height;
+					if (!numDevices) {
+						numDevices = (unsigned long) image.width * image.height;
+					}
+					if (numDevices > 0xFFFF
+							|| !mapMatrix(mapping, numDevices, layout,
+									rotation)) {
+						fprintf(stderr, "%s: a %ux%u matrix doesn't fit "
+								"a chain of %lu\n", path, image.width,
+								image.height, numDevices);
+						ok = false;
+					}
+					show.num_devices = numDevices;
+				} else if (image.width != mapping.width
+						|| image.height != mapping.height) {
+					fprintf(stderr, "%s: %ux%u, not %ux%u like the first "
+							"frame\n", path, image.width, image.height,
+							mapping.width, mapping.height);
+					ok = false;
+				}
+
+				if (ok && image.maxval != quantMax) {
+					free(quant);
+					quantMax = image.maxval;
+					quant = quantTable(quantMax, gamma);
+				}
+
+				if (ok && !(quant && addImage(show, mapping, image, quant))) {
+					fprintf(stderr, "out of memory\n");
+					ok = false;
+				}
+			}
+			free(image.rgb);
+
+			if (status <= 0 || png || !ok) {
+				break;
+			}
+		}
+
+		if (in && in != stdin) {
+			fclose(in);
+		}
+	}
+
+	free(quant);
+	free(mapping.position);
+	return ok && show.num_frames;
+}
+
+/*
+ ** CSV timeline
+ */
+static int compareEvents(const void * a, const void * b) {
+	const ShowEvent * ea = (const ShowEvent *) a;
+	const ShowEvent * eb = (const ShowEvent *) b;
+	if (ea->frame != eb->frame) {
+		return (ea->frame < eb->frame) ? -1 : 1;
+	}
+	// keep the file's order within a frame
+	return (ea->line < eb->line) ? -1 : (ea->line > eb->line);
+}
+
+static bool readTimeline(ShowFrames & show, const char * path,
+		unsigned long numDevices, unsigned int width, unsigned int height,
+		uint8_t layout, uint8_t rotation, unsigned int maxval, double gamma) {
+	FILE * in = strcmp(path, "-") ? fopen(path, "r") : stdin;
+	if (!in) {
+		perror(path);
+		return false;
+	}
+
+	ShowMapping mapping = { width, height, NULL };
+	if (!numDevices) {
+		numDevices = (unsigned long) width * height;
+	}
+	if (!numDevices || numDevices > 0xFFFF
+			|| (width && height
+					&& !mapMatrix(mapping, numDevices, layout, rotation))) {
+		fprintf(stderr, "%s: need a chain (-n) or a matrix that fits it "
+				"(-x and -y)\n", path);
+		if (in != stdin) {
+			fclose(in);
+		}
+		return false;
+	}
+	show.num_devices = numDevices;
+
+	ShowEvent * events = NULL;
+	unsigned long numEvents = 0;
+	unsigned long capacity = 0;
+	unsigned long lineNum = 0;
+	bool ok = true;
+	char line[TBST_CSV_MAXLINE];
+
+	while (ok && fgets(line, sizeof(line), in)) {
+		lineNum++;
+		unsigned long fields[6];
+		int numFields = 0;
+		char * p = line;
+
+		while (isspace((unsigned char) *p)) {
+			p++;
+		}
+		if (!*p || *p == '#') {
+			continue;
+		}
+
+		for (;;) {
+			char * end;
+			fields[numFields] = strtoul(p, &end, 10);
+			if (end == p) {
+				break;
+			}
+			numFields++;
+			p = end;
+			while (*p == ' ' || *p == '\t') {
+				p++;
+			}
+			if (*p != ',' || numFields == 6) {
+				break;
+			}
+			p++;
+		}
+		while (isspace((unsigned char) *p)) {
+			p++;
+		}
+
+		if (!numFields && lineNum == 1) {
+			// a header
+			continue;
+		}
+
+		ShowEvent event;
+		event.line = lineNum;
+		event.frame = fields[0];
+		unsigned long device = numDevices;
+		if (*p || numFields < 5) {
+			numFields = 0;
+		} else if (numFields == 5) {
+			device = fields[1];
+		} else if (mapping.position && fields[1] < width
+				&& fields[2] < height) {
+			// back from the entry position, to the chain
+			device = numDevices - 1
+					- mapping.position[fields[2] * width + fields[1]];
+		}
+
+		if (!numFields || device >= numDevices) {
+			fprintf(stderr, "%s:%lu: bad line\n", path, lineNum);
+			ok = false;
+			break;
+		}
+
+		event.device = device;
+		event.red = fields[numFields - 3];
+		event.green = fields[numFields - 2];
+		event.blue = fields[numFields - 1];
+		if (event.red > maxval || event.green > maxval || event.blue > maxval) {
+			fprintf(stderr, "%s:%lu: colour above %u (see -m)\n", path,
+					lineNum, maxval);
+			ok = false;
+			break;
+		}
+
+		if (numEvents == capacity) {
+			capacity = capacity ? capacity * 2 : 256;
+			ShowEvent * grown = (ShowEvent*) realloc(events,
+					sizeof(ShowEvent) * capacity);
+			if (!grown) {
+				fprintf(stderr, "out of memory\n");
+				ok = false;
+				break;
+			}
+			events = grown;
+		}
+		events[numEvents++] = event;
+	}
+
+	if (in != stdin) {
+		fclose(in);
+	}
+	free(mapping.position);
+
+	uint16_t * quant = quantTable(maxval, gamma);
+	uint32_t * current = (uint32_t*) calloc(numDevices, sizeof(uint32_t));
+	if (ok && !(quant && current)) {
+		fprintf(stderr, "out of memory\n");
+		ok = false;
+	}
+
+	if (ok && numEvents) {
+		qsort(events, numEvents, sizeof(ShowEvent), compareEvents);
+
+		unsigned long e = 0;
+		for (unsigned long frame = 0; ok && frame <= events[numEvents - 1].frame;
+				frame++) {
+			for (; e < numEvents && events[e].frame == frame; e++) {
+				const ShowEvent & event = events[e];
+				current[numDevices - 1 - event.device] =
+						TinyBriteFrameEncoder::entry(quant[event.red],
+								quant[event.green], quant[event.blue]);
+			}
+
+			uint32_t * entries = addFrame(show);
+			if (!entries) {
+				fprintf(stderr, "out of memory\n");
+				ok = false;
+				break;
+			}
+			memcpy(entries, current, sizeof(uint32_t) * numDevices);
+		}
+	}
+
+	free(current);
+	free(quant);
+	free(events);
+	return ok && show.num_frames;
+}
+
+/*
+ ** Output
+ */
+static void putBigEndian(FILE * out, uint32_t value, uint8_t numBytes) {
+	while (numBytes--) {
+		putc((value >> (numBytes * 8)) & 0xFF, out);
+	}
+}
+
+static bool writeBinary(FILE * out, const ShowFrames & show,
+		const uint8_t * data, const uint32_t * offsets, unsigned int fps) {
+	fputs("TBSH", out);
+	putBigEndian(out, show.num_frames, 2);
+	putBigEndian(out, show.num_devices, 2);
+	putBigEndian(out, fps, 2);
+	for (unsigned long f = 0; f <= show.num_frames; f++) {
+		putBigEndian(out, offsets[f], 4);
+	}
+	fwrite(data, 1, offsets[show.num_frames], out);
+	return !ferror(out);
+}
+
+static bool writeHeader(FILE * out, const char * name, const ShowFrames & show,
+		const uint8_t * data, const uint32_t * offsets, unsigned int fps,
+		bool stateTracking, unsigned int maxDelta) {
+	char upper[64];
+	size_t i;
+	for (i = 0; name[i] && i < sizeof(upper) - 1; i++) {
+		upper[i] = toupper((unsigned char) name[i]);
+	}
+	upper[i] = 0;
+
+	fprintf(out, "/*\n\n Show data generated by tinybrite-show: don't edit.\n\n");
+	fprintf(out, " %lu frames of %u devices, at %u frames/s, in %lu bytes.\n"
+			" See host/TinyBriteShowTool.cpp for how to play them.\n\n*/\n\n",
+			show.num_frames, show.num_devices, fps,
+			(unsigned long) offsets[show.num_frames]);
+	fprintf(out, "#ifndef %s_h\n#define %s_h\n\n", name, name);
+	fprintf(out, "#include <TinyBrite.h>\n\n");
+	fprintf(out, "#define %s_NUM_FRAMES\t\t%lu\n", upper, show.num_frames);
+	fprintf(out, "#define %s_NUM_DEVICES\t\t%u\n", upper, show.num_devices);
+	fprintf(out, "#define %s_FRAME_RATE\t\t%u\n", upper, fps);
+	fprintf(out, "#define %s_STATE_TRACKING\t%d\n", upper,
+			stateTracking ? 1 : 0);
+	fprintf(out, "#define %s_MAX_DELTA_ENTRIES\t%u\n\n", upper, maxDelta);
+
+	fprintf(out, "const uint8_t %s_data[] TINYBRITE_FLASH = {", name);
+	for (uint32_t b = 0; b < offsets[show.num_frames]; b++) {
+		fprintf(out, "%s0x%02X%s", (b % 12) ? " " : "\n\t", data[b],
+				(b + 1 < offsets[show.num_frames]) ? "," : "");
+	}
+	fprintf(out, "\n};\n\n");
+
+	fprintf(out, "const uint32_t %s_frames[%s_NUM_FRAMES + 1] TINYBRITE_FLASH = {",
+			name, upper);
+	for (unsigned long f = 0; f <= show.num_frames; f++) {
+		fprintf(out, "%s%lu%s", (f % 8) ? " " : "\n\t",
+				(unsigned long) offsets[f], (f < show.num_frames) ? "," : "");
+	}
+	fprintf(out, "\n};\n\n#endif\n");
+	return !ferror(out);
+}
+
+static bool validName(const char * name) {
+	if (!*name || isdigit((unsigned char) *name)) {
+		return false;
+	}
+	for (; *name; name++) {
+		if (!isalnum((unsigned char) *name) && *name != '_') {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int layoutNamed(const char * name) {
+	static const char * const names[] = { "rowmajor", "serpentine",
+			"columnmajor", "columnserpentine" };
+	for (int i = 0; i < 4; i++) {
+		if (!strcasecmp(name, names[i])) {
+			// in the order of the TINYBRITE_MATRIX_* layouts
+			return i;
+		}
+	}
+	return -1;
+}
+
+int main(int argc, char * argv[]) {
+	int layout = TINYBRITE_MATRIX_SERPENTINE;
+	int rotation = TINYBRITE_MATRIX_ROTATE_0;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned long numDevices = 0;
+	unsigned int maxval = 255;
+	double gamma = 1.0;
+	unsigned long keyframeInterval = 0;
+	bool keyframesOnly = false;
+	unsigned long maxDelta = TINYBRITE_ENCODER_DEFAULT_MAX_DELTA_ENTRIES;
+	unsigned int fps = 30;
+	double mhz = 16;
+	const char * outPath = NULL;
+	const char * name = "show";
+
+	int opt;
+	while ((opt = getopt(argc, argv, "l:R:x:y:n:m:g:k:Kd:r:M:o:N:")) != -1) {
+		switch (opt) {
+		case 'l':
+			layout = layoutNamed(optarg);
+			break;
+		case 'R':
+			rotation = strtoul(optarg, NULL, 0);
+			rotation = (rotation % 90) ? -1 : rotation / 90;
+			break;
+		case 'x':
+			width = strtoul(optarg, NULL, 0);
+			break;
+		case 'y':
+			height = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			numDevices = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			maxval = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			gamma = strtod(optarg, NULL);
+			break;
+		case 'k':
+			keyframeInterval = strtoul(optarg, NULL, 0);
+			break;
+		case 'K':
+			keyframesOnly = true;
+			break;
+		case 'd':
+			maxDelta = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			fps = strtoul(optarg, NULL, 0);
+			break;
+		case 'M':
+			mhz = strtod(optarg, NULL);
+			break;
+		case 'o':
+			outPath = optarg;
+			break;
+		case 'N':
+			name = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind >= argc || layout < 0 || rotation < 0 || rotation > 3
+			|| !maxval || maxval > 65535 || !(gamma > 0) || !fps
+			|| fps > 0xFFFF || !(mhz > 0) || !validName(name)
+			|| !width != !height || maxDelta > 0xFFFF) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	ShowFrames show = { 0, 0, 0, NULL };
+	bool ok;
+	if (endsWith(argv[optind], ".csv")) {
+		ok = (optind == argc - 1)
+				&& readTimeline(show, argv[optind], numDevices, width, height,
+						layout, rotation, maxval, gamma);
+	} else {
+		ok = readImages(show, argv + optind, argc - optind, numDevices, layout,
+				rotation, gamma);
+	}
+	if (!ok) {
+		fprintf(stderr, "no show to encode\n");
+		return 1;
+	}
+
+	/*
+	 * Frames in flash don't get lost, so past the first one keyframes
+	 * only cost space, unless asked for (e.g. to start playback midway).
+	 */
+	TinyBriteFrameEncoder encoder(show.num_devices,
+			keyframeInterval ? keyframeInterval : 0xFFFF);
+	encoder.setMaxDeltaEntries(maxDelta);
+	size_t maxFrame = TinyBriteFrameEncoder::maxEncodedSize(show.num_devices);
+	uint8_t * data = (uint8_t*) malloc(maxFrame * show.num_frames);
+	uint32_t * offsets = (uint32_t*) malloc(
+			sizeof(uint32_t) * (show.num_frames + 1));
+	if (!(encoder.valid() && data && offsets)) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	unsigned long numFull = 0;
+	unsigned long numDelta = 0;
+	size_t largest = 0;
+	double slowestUs = 0;
+	double totalUs = 0;
+	double bitUs = TBST_CYCLES_PER_BIT / mhz + 2 * TA6281_CLOCK_DELAY_US;
+	double byteUs = TBST_CYCLES_PER_BYTE / mhz;
+	size_t len = 0;
+
+	for (unsigned long f = 0; f < show.num_frames; f++) {
+		const uint32_t * entries = frameEntries(show, f);
+		offsets[f] = len;
+
+		if (keyframesOnly) {
+			if (f && !memcmp(entries, frameEntries(show, f - 1),
+					sizeof(uint32_t) * show.num_devices)) {
+				continue;
+			}
+			encoder.forceKeyframe();
+		}
+
+		size_t frameLen = encoder.encode(entries, data + len);
+		if (!frameLen) {
+			continue;
+		}
+		len += frameLen;
+
+		if (encoder.lastWasKeyframe()) {
+			numFull++;
+		} else {
+			numDelta++;
+		}
+
+		// either way, the whole chain is shifted out and latched
+		double us = frameLen * byteUs + show.num_devices * 32 * bitUs
+				+ TA6281_LATCH_DELAY_US;
+		totalUs += us;
+		if (us > slowestUs) {
+			slowestUs = us;
+		}
+		if (frameLen > largest) {
+			largest = frameLen;
+		}
+	}
+	offsets[show.num_frames] = len;
+
+	double periodUs = 1000000.0 / fps;
+	printf("%lu frames of %u devices: %lu full, %lu delta, %lu unchanged\n",
+			show.num_frames, show.num_devices, numFull, numDelta,
+			show.num_frames - numFull - numDelta);
+	printf("%lu bytes (+ %lu of offsets): %.1f bytes/frame on average, "
+			"%lu at most\n", (unsigned long) len,
+			(unsigned long) (sizeof(uint32_t) * (show.num_frames + 1)),
+			(double) len / show.num_frames, (unsigned long) largest);
+	printf("playback at %u frames/s on a %.0f MHz uC: about %.0f us/frame on "
+			"average (%.1f%% CPU), %.0f us at most (%.1f%%)\n", fps, mhz,
+			totalUs / show.num_frames, 100 * totalUs / show.num_frames / periodUs,
+			slowestUs, 100 * slowestUs / periodUs);
+	if (slowestUs > periodUs) {
+		printf("warning: some frames take longer than the %.0f us between "
+				"frames\n", periodUs);
+	}
+	if (len > TBST_AVR_MAX_ARRAY) {
+		printf("warning: over %lu bytes, too large for a flash array on "
+				"an AVR\n", TBST_AVR_MAX_ARRAY);
+	}
+	if (numDelta) {
+		printf("delta frames: the sketch needs state tracking on\n");
+	}
+
+	if (outPath) {
+		FILE * out = fopen(outPath, "wb");
+		if (!out) {
+			perror(outPath);
+			return 1;
+		}
+		ok = endsWith(outPath, ".h") ?
+				writeHeader(out, name, show, data, offsets, fps, numDelta,
+						maxDelta) :
+				writeBinary(out, show, data, offsets, fps);
+		if (fclose(out) || !ok) {
+			perror(outPath);
+			return 1;
+		}
+	}
+
+	free(data);
+	free(offsets);
+	free(show.entries);
+	return 0;
+}
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
@@ -0,0 +1,451 @@
+/*
+
+ TinyBriteSinkCheck.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Checks TinyBriteSerialSink end to end, through a pseudo-terminal.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ Encodes a run of random frames with TinyBriteFrameEncoder (keyframes,
+ deltas and, every so often, a corrupted frame or line noise between
+ frames) and writes them to the master side of a pseudo-terminal, as a
+ show controller would to a serial port.  The other side is read, as a
+ uC's UART would be, and fed to a TinyBriteSerialSink driving a chain
+ that sends to a file.
+
+ Every packet that went out is played through a model of the chain's
+ shift registers and, after each frame, the chain must have latched it
+ (or, for a corrupted frame, or a delta while a keyframe is needed, not
+ have latched anything) and hold exactly what the encoder was given.
+ The time from the frame's last byte being written to its latch is
+ reported.  Build, from the library directory, with:
+
+	g++ -O2 -DTINYBRITE_PLATFORM_LINUX -I. -o tinybrite-sinkcheck *.cpp \
+		host/TinyBriteLinuxTransport.cpp host/TinyBriteFrameEncoder.cpp \
+		host/TinyBriteSinkCheck.cpp
+
+ and run:
+
+	./tinybrite-sinkcheck
+	./tinybrite-sinkcheck -n 300 -f 2000
+
+ It exits with 0 if everything matched, and 2 otherwise.
+
+ Options:
+	-n DEVICES  length of the chain (default 40)
+	-f FRAMES   frames to send (default 500)
+	-k FRAMES   keyframe interval of the encoder (default 8)
+	-s SEED     random seed (default 1)
+	-o PATH     scratch file for the packets (default: a temporary file)
+
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "TinyBriteSerialSink.h"
+#include "host/TinyBriteFrameEncoder.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+/* bytes written to the pty at a time, between reads of the other side */
+#define TBSC_WRITE_CHUNK		256
+
+/* how long to wait for bytes that should be on their way */
+#define TBSC_TIMEOUT_MS			1000
+
+/* one frame in TBSC_CORRUPT_EVERY is corrupted, one in TBSC_NOISE_EVERY
+ * is preceded by line noise, one in TBSC_BIGCHANGE_EVERY changes a lot */
+#define TBSC_CORRUPT_EVERY		13
+#define TBSC_NOISE_EVERY		7
+#define TBSC_BIGCHANGE_EVERY	11
+
+/* failures reported, before just counting them */
+#define TBSC_MAXREPORTS			8
+
+/*
+ ** SinkCheck
+ ** Both ends of the pty, the chain's output and a model of its registers.
+ */
+typedef struct SinkCheck {
+	TinyBrite * chain;
+	TinyBriteSerialSink * sink;
+	DriverNum num_devices;
+	int master_fd;
+	int slave_fd;
+	int read_fd;
+	uint32_t * registers;
+
+	unsigned long failures;
+	unsigned long latency_sum_us;
+	unsigned long latency_max_us;
+	unsigned long num_latched;
+} SinkCheck;
+
+static void fail(SinkCheck & check, unsigned long frame, const char * what) {
+	if (check.failures++ < TBSC_MAXREPORTS) {
+		fprintf(stderr, "frame %lu: %s\n", frame, what);
+	}
+}
+
+/*
+ ** shiftOut
+ ** Play whatever the chain sent since the last call through the model of
+ ** its shift registers (0 is closest to the uC).
+ */
+static void shiftOut(SinkCheck & check) {
+	uint8_t bytes[4];
+
+	while (read(check.read_fd, bytes, sizeof(bytes)) == sizeof(bytes)) {
+		memmove(check.registers + 1, check.registers,
+				sizeof(uint32_t) * (check.num_devices - 1));
+		check.registers[0] = ((uint32_t) bytes[0] << 24)
+				| ((uint32_t) bytes[1] << 16) | ((uint32_t) bytes[2] << 8)
+				| bytes[3];
+	}
+}
+
+/*
+ ** receive
+ ** Feed the sink whatever the slave side has, waiting up to timeout_ms for
+ ** it.  Returns the number of bytes read, and counts latched frames.
+ */
+static size_t receive(SinkCheck & check, int timeout_ms, uint16_t & numLatched) {
+	struct pollfd pfd = { check.slave_fd, POLLIN, 0 };
+	if (poll(&pfd, 1, timeout_ms) <= 0) {
+		return 0;
+	}
+
+	uint8_t buf[TBSC_WRITE_CHUNK];
+	ssize_t len = read(check.slave_fd, buf, sizeof(buf));
+	if (len <= 0) {
+		return 0;
+	}
+
+	numLatched += check.sink->ingest(buf, len);
+	return len;
+}
+
+/*
+ ** sendBytes
+ ** Write bytes to the master side, reading the slave side as we go (the
+ ** pty only buffers so much).  Returns the number of frames latched, and
+ ** the time from the last byte written to the last latch.
+ */
+static uint16_t sendBytes(SinkCheck & check, const uint8_t * bytes, size_t len,
+		unsigned long & latency_us) {
+	uint16_t numLatched = 0;
+	size_t written = 0;
+	size_t received = 0;
+	unsigned long lastWrite = MCU::micros();
+
+	latency_us = 0;
+
+	while (received < len) {
+		if (written < len) {
+			size_t chunk = len - written;
+			if (chunk > TBSC_WRITE_CHUNK) {
+				chunk = TBSC_WRITE_CHUNK;
+			}
+			ssize_t out = write(check.master_fd, bytes + written, chunk);
+			if (out > 0) {
+				written += out;
+				lastWrite = MCU::micros();
+			}
+		}
+
+		uint16_t before = numLatched;
+		size_t in = receive(check, (written < len) ? 0 : TBSC_TIMEOUT_MS,
+				numLatched);
+		if (numLatched != before) {
+			latency_us = MCU::micros() - lastWrite;
+		}
+		if (!in && written >= len) {
+			// nothing more is coming
+			break;
+		}
+		received += in;
+	}
+
+	return numLatched;
+}
+
+/*
+ ** expectShown
+ ** The chain's registers must hold the frame, as last latched.
+ */
+static void expectShown(SinkCheck & check, unsigned long frame,
+		const uint32_t * entries) {
+	for (DriverNum d = 0; d < check.num_devices; d++) {
+		// the first entry of a frame winds up furthest from the uC
+		uint32_t entry = entries[check.num_devices - 1 - d];
+		BritePacket expected = TinyBrite::colorPacket(
+				(entry >> TINYBRITE_FRAME_ENTRY_RED_SHIFT)
+						& TINYBRITE_FRAME_ENTRY_COLORMASK,
+				(entry >> TINYBRITE_FRAME_ENTRY_GREEN_SHIFT)
+						& TINYBRITE_FRAME_ENTRY_COLORMASK,
+				(entry >> TINYBRITE_FRAME_ENTRY_BLUE_SHIFT)
+						& TINYBRITE_FRAME_ENTRY_COLORMASK);
+		if (check.registers[d] != expected.value) {
+			char what[80];
+			snprintf(what, sizeof(what), "device %u is 0x%08x, not 0x%08x", d,
+					check.registers[d], expected.value);
+			fail(check, frame, what);
+			return;
+		}
+	}
+}
+
+static uint32_t randomEntry() {
+	return TinyBriteFrameEncoder::entry(rand() & TINYBRITE_FRAME_ENTRY_COLORMASK,
+			rand() & TINYBRITE_FRAME_ENTRY_COLORMASK,
+			rand() & TINYBRITE_FRAME_ENTRY_COLORMASK);
+}
+
+static bool openPty(SinkCheck & check) {
+	check.master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (check.master_fd < 0 || grantpt(check.master_fd)
+			|| unlockpt(check.master_fd)) {
+		return false;
+	}
+
+	check.slave_fd = open(ptsname(check.master_fd), O_RDWR | O_NOCTTY);
+	if (check.slave_fd < 0) {
+		return false;
+	}
+
+	// a UART: bytes as they are, no line editing or translation
+	struct termios tio;
+	if (tcgetattr(check.slave_fd, &tio)) {
+		return false;
+	}
+	cfmakeraw(&tio);
+	return !tcsetattr(check.slave_fd, TCSANOW, &tio);
+}
+
+static void usage(const char * name) {
+	fprintf(stderr, "usage: %s [-n DEVICES] [-f FRAMES] [-k FRAMES] [-s SEED]"
+			" [-o PATH]\n", name);
+}
+
+int main(int argc, char * argv[]) {
+	unsigned long numDevices = 40;
+	unsigned long numFrames = 500;
+	unsigned long keyframeInterval = 8;
+	unsigned int seed = 1;
+	const char * path = NULL;
+	char tempPath[] = "/tmp/tinybrite-sinkcheck-XXXXXX";
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:f:k:s:o:")) != -1) {
+		switch (opt) {
+		case 'n':
+			numDevices = strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			numFrames = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			keyframeInterval = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (numDevices < 2 || numDevices > 0xFFFF || !keyframeInterval
+			|| keyframeInterval > 0xFFFF) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!path) {
+		int fd = mkstemp(tempPath);
+		if (fd < 0) {
+			perror(tempPath);
+			return 1;
+		}
+		close(fd);
+		path = tempPath;
+	}
+
+	SinkCheck check;
+	memset(&check, 0, sizeof(check));
+	check.num_devices = numDevices;
+
+	if (!openPty(check)) {
+		perror("pty");
+		return 1;
+	}
+
+	TinyBriteLinuxTransport & transport = TinyBriteLinuxTransport::instance();
+	if (!transport.openFile(path)) {
+		perror(path);
+		return 1;
+	}
+	check.read_fd = open(path, O_RDONLY);
+
+	TinyBriteFrameEncoder encoder(numDevices, keyframeInterval);
+	uint8_t * buf = (uint8_t*) malloc(
+			TinyBriteFrameEncoder::maxEncodedSize(numDevices));
+	uint32_t * entries = (uint32_t*) malloc(sizeof(uint32_t) * numDevices);
+	uint32_t * shown = (uint32_t*) malloc(sizeof(uint32_t) * numDevices);
+	check.registers = (uint32_t*) calloc(numDevices, sizeof(uint32_t));
+	if (check.read_fd < 0 || !(encoder.valid() && buf && entries && shown
+			&& check.registers)) {
+		perror("setup");
+		return 1;
+	}
+
+	TinyBrite chain(numDevices);
+	chain.setup(0, 0, 25);
+	if (!chain.setStateTracking(true)) {
+		fprintf(stderr, "can't track state\n");
+		return 1;
+	}
+	TinyBriteSerialSink sink(chain);
+	check.chain = &chain;
+	check.sink = &sink;
+
+	srand(seed);
+	for (DriverNum i = 0; i < numDevices; i++) {
+		entries[i] = randomEntry();
+	}
+
+	unsigned long numCorrupt = 0;
+	unsigned long numRefused = 0;
+	bool haveShown = false;
+
+	for (unsigned long f = 0; f < numFrames; f++) {
+		if (f) {
+			unsigned long numChanges = (f % TBSC_BIGCHANGE_EVERY) ?
+					1 + rand() % 4 : numDevices / 2;
+			for (unsigned long c = 0; c < numChanges; c++) {
+				entries[rand() % numDevices] = randomEntry();
+			}
+		}
+
+		size_t len = encoder.encode(entries, buf);
+		if (!len) {
+			continue;
+		}
+
+		bool keyframe = encoder.lastWasKeyframe();
+		bool corrupt = f && !(f % TBSC_CORRUPT_EVERY);
+		if (corrupt) {
+			// a payload bit flipped on the line
+			buf[TINYBRITE_FRAME_HEADER_SIZE
+					+ rand() % (len - TINYBRITE_FRAME_HEADER_SIZE
+							- TINYBRITE_FRAME_CHECKSUM_SIZE)] ^= 1 << (rand() % 8);
+			numCorrupt++;
+		}
+
+		unsigned long latency;
+		if (f && !(f % TBSC_NOISE_EVERY)) {
+			// junk between frames (never a sync byte): must be skipped
+			uint8_t noise[5];
+			for (uint8_t n = 0; n < sizeof(noise); n++) {
+				noise[n] = (TINYBRITE_FRAME_SYNC0 + 1 + rand() % 200) & 0xFF;
+			}
+			if (sendBytes(check, noise, sizeof(noise), latency)) {
+				fail(check, f, "line noise latched a frame");
+			}
+		}
+
+		// a delta is refused while a keyframe is needed
+		bool refused = !keyframe && sink.needKeyframe();
+		uint16_t numLatched = sendBytes(check, buf, len, latency);
+		shiftOut(check);
+
+		if (corrupt || refused) {
+			if (numLatched) {
+				fail(check, f, corrupt ? "a corrupted frame was latched" :
+						"a delta was latched while a keyframe was needed");
+			}
+			if (!sink.needKeyframe()) {
+				fail(check, f, "no keyframe needed after a bad frame");
+			}
+			numRefused += refused ? 1 : 0;
+		} else {
+			if (numLatched != 1) {
+				fail(check, f, "a good frame wasn't latched");
+			} else {
+				check.num_latched++;
+				check.latency_sum_us += latency;
+				if (latency > check.latency_max_us) {
+					check.latency_max_us = latency;
+				}
+			}
+			if (keyframe && sink.needKeyframe()) {
+				fail(check, f, "still needs a keyframe after one");
+			}
+			memcpy(shown, entries, sizeof(uint32_t) * numDevices);
+			haveShown = true;
+		}
+
+		if (haveShown) {
+			// what's latched is the last good frame, whatever came since
+			expectShown(check, f, shown);
+		}
+	}
+
+	if (sink.framesLatched() != check.num_latched) {
+		fail(check, numFrames, "the sink counted other latches");
+	}
+	if (transport.errors()) {
+		fail(check, numFrames, "transport errors");
+	}
+
+	printf("%lu devices, %lu frames: %lu latched, %lu corrupted, %lu deltas"
+			" refused\n", numDevices, numFrames, check.num_latched, numCorrupt,
+			numRefused);
+	if (check.num_latched) {
+		printf("latency from last byte to latch: %lu us avg, %lu us max\n",
+				check.latency_sum_us / check.num_latched, check.latency_max_us);
+	}
+
+	transport.close();
+	close(check.read_fd);
+	close(check.slave_fd);
+	close(check.master_fd);
+	if (path == tempPath) {
+		unlink(tempPath);
+	}
+	free(buf);
+	free(entries);
+	free(shown);
+	free(check.registers);
+
+	if (check.failures) {
+		printf("%lu failures\n", check.failures);
+		return 2;
+	}
+	return 0;
+}
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
@@ -0,0 +1,223 @@
+/*
+
+ TinyBriteWaveBench.cpp -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Checks the waveform and easing tables against math.h, and times them.
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ For each shape, compares every table entry with the same curve computed
+ with math.h (sin(), pow()) and reports the largest difference, in PWM
+ units.  Then times an oscillator stepping through the shape against
+ computing each value with math.h, as an effect would without the tables,
+ in nanoseconds per value.
+
+ On a host, the gap is narrowed by a hardware FPU; on an AVR, where
+ sin() and pow() are done in software, it is far wider.  So the same two
+ loops are also costed in AVR cycles, from a model: avr-libc's benchmark
+ figures for its floating point routines (rounded, see TBWB_AVR_*), added
+ up for each curve, against the instructions of an oscillator step (an
+ add, the table address and a pgm_read_word(), i.e. two lpm).  The model
+ leaves out loads, stores and calls, which both loops have.  Build, from
+ the library directory, with:
+
+	g++ -O2 -DTINYBRITE_PLATFORM_LINUX -I. -o tinybrite-wavebench *.cpp \
+		host/TinyBriteLinuxTransport.cpp host/TinyBriteWaveBench.cpp -lm
+
+ and run it with the number of values to time, optionally:
+
+	./tinybrite-wavebench [COUNT]
+
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "TinyBriteOscillator.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+/*
+ * AVR cost model, in cycles: avr-libc's floating point routines, as its
+ * manual's benchmarks give them (ATmega8, rounded).
+ */
+#define TBWB_AVR_ADD		110		/* __addsf3, also for -, < */
+#define TBWB_AVR_MUL		370		/* __mulsf3 */
+#define TBWB_AVR_DIV		470		/* __divsf3 */
+#define TBWB_AVR_CONVERT	70		/* integer to float, or back */
+#define TBWB_AVR_SIN		1650
+#define TBWB_AVR_EXP		2800
+#define TBWB_AVR_LOG		2830
+/* pow(x, y) is exp(y * log(x)) */
+#define TBWB_AVR_POW		(TBWB_AVR_LOG + TBWB_AVR_MUL + TBWB_AVR_EXP)
+
+/*
+ * Around every curve, in the math.h loop: the step to t (a conversion and
+ * a divide), and t's value to PWM (a multiply, rounding and a conversion).
+ */
+#define TBWB_AVR_AROUND		(2 * TBWB_AVR_CONVERT + TBWB_AVR_DIV \
+		+ TBWB_AVR_MUL + TBWB_AVR_ADD)
+
+/*
+ * An oscillator step: add the offset (2), make the table address from the
+ * phase's high byte (5), pgm_read_word() (two lpm, 6) and step (2).
+ */
+#define TBWB_AVR_TABLE		(2 + 5 + 6 + 2)
+
+typedef double (*WaveFunction)(double t);
+
+typedef struct WaveVersion {
+	const char * name;
+	TinyBriteWaveShape shape;
+	WaveFunction reference;
+	// the table holds a whole period (sine, triangle) or 0 to 1 (easing)
+	bool periodic;
+	// the reference's own cost, in the AVR model (the costlier branch)
+	unsigned long avr_cycles;
+} WaveVersion;
+
+static double sineRef(double t) {
+	return 0.5 + 0.5 * sin(2 * M_PI * t);
+}
+
+static double triangleRef(double t) {
+	return (t < 0.5) ? 2 * t : 2 - 2 * t;
+}
+
+static double cubicInRef(double t) {
+	return t * t * t;
+}
+
+static double cubicOutRef(double t) {
+	return 1 - pow(1 - t, 3);
+}
+
+static double cubicInOutRef(double t) {
+	return (t < 0.5) ? 4 * t * t * t : 1 - pow(-2 * t + 2, 3) / 2;
+}
+
+static double expoInRef(double t) {
+	return (t == 0) ? 0 : pow(2, 10 * t - 10);
+}
+
+static double expoOutRef(double t) {
+	return (t == 1) ? 1 : 1 - pow(2, -10 * t);
+}
+
+static const WaveVersion versions[] = {
+	{ "sine", TINYBRITE_WAVE_SINE, sineRef, true,
+		2 * TBWB_AVR_MUL + TBWB_AVR_SIN + TBWB_AVR_ADD },
+	{ "triangle", TINYBRITE_WAVE_TRIANGLE, triangleRef, true,
+		2 * TBWB_AVR_ADD + TBWB_AVR_MUL },
+	{ "cubic in", TINYBRITE_EASE_CUBIC_IN, cubicInRef, false,
+		2 * TBWB_AVR_MUL },
+	{ "cubic out", TINYBRITE_EASE_CUBIC_OUT, cubicOutRef, false,
+		2 * TBWB_AVR_ADD + TBWB_AVR_POW },
+	{ "cubic i/o", TINYBRITE_EASE_CUBIC_INOUT, cubicInOutRef, false,
+		4 * TBWB_AVR_ADD + 2 * TBWB_AVR_MUL + TBWB_AVR_POW },
+	{ "expo in", TINYBRITE_EASE_EXPO_IN, expoInRef, false,
+		2 * TBWB_AVR_ADD + TBWB_AVR_MUL + TBWB_AVR_POW },
+	{ "expo out", TINYBRITE_EASE_EXPO_OUT, expoOutRef, false,
+		2 * TBWB_AVR_ADD + TBWB_AVR_MUL + TBWB_AVR_POW }
+};
+
+#define TBWB_NUMVERSIONS	(sizeof(versions) / sizeof(versions[0]))
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double entryPosition(const WaveVersion & version, unsigned int i) {
+	return (double) i
+			/ (version.periodic ?
+					TINYBRITE_WAVE_STEPS : TINYBRITE_WAVE_STEPS - 1);
+}
+
+int main(int argc, char * argv[]) {
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 50000000UL;
+	if (!count) {
+		fprintf(stderr, "usage: %s [COUNT]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%lu values per shape\n", count);
+	printf("                       host ns/value          AVR cycles/value (model)\n");
+	printf("shape      max error   table    math.h        table    math.h   ratio\n");
+
+	int failed = 0;
+	for (unsigned int v = 0; v < TBWB_NUMVERSIONS; v++) {
+		const WaveVersion & version = versions[v];
+
+		double maxError = 0;
+		for (unsigned int i = 0; i < TINYBRITE_WAVE_STEPS; i++) {
+			double expected = version.reference(entryPosition(version, i))
+					* TINYBRITE_COLOR_MAXVALUE;
+			double error = fabs(TinyBriteOscillator::ease(version.shape, i) - expected);
+			if (error > maxError) {
+				maxError = error;
+			}
+		}
+		if (maxError > 0.5) {
+			failed = 1;
+		}
+
+		// a sum of the values, so neither loop can be optimized away
+		volatile unsigned long sink = 0;
+		unsigned long sum = 0;
+
+		TinyBriteOscillator osc(version.shape, 0x0101);
+		double begin = now();
+		for (unsigned long n = 0; n < count; n++) {
+			sum += osc.next();
+		}
+		double tableTime = now() - begin;
+		sink = sum;
+
+		sum = 0;
+		uint16_t phase = 0;
+		begin = now();
+		for (unsigned long n = 0; n < count; n++) {
+			// the same t as the table entry the oscillator reads
+			double t = entryPosition(version,
+					phase >> TINYBRITE_WAVE_PHASESHIFT);
+			sum += (TinyBriteColorValue) (version.reference(t)
+					* TINYBRITE_COLOR_MAXVALUE + 0.5);
+			phase += 0x0101;
+		}
+		double mathTime = now() - begin;
+		sink = sum;
+		(void) sink;
+
+		unsigned long avrMath = TBWB_AVR_AROUND + version.avr_cycles;
+		printf("%-10s %9.2f   %5.2f   %7.2f       %6u   %7lu   %5lu\n",
+				version.name, maxError, tableTime * 1e9 / count,
+				mathTime * 1e9 / count, TBWB_AVR_TABLE, avrMath,
+				avrMath / TBWB_AVR_TABLE);
+	}
+
+	if (failed) {
+		fprintf(stderr, "table entries off by more than rounding\n");
+	}
+
+	return failed;
+}
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
@@ -38,6 +38,9 @@
 #ifdef TINYBRITE_PLATFORM_AVR
 
 #include <util/delay.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
@@ -63,6 +66,8 @@
 #define OUTPUT 0x1
 #endif
 
+#define TINYBRITE_FLASH		PROGMEM
+
 // include the AVR header, to use functions like pinMode and digitalWrite
 
 /* class MCU -- abstract away platform
@@ -97,6 +102,78 @@ public:
 			TB_PORT &= (0xff & ~(1 << pinId));
 		}
 	}
+	static bool digitalIn(uint8_t pinId)
+	{
+		return (TB_PIN & (1 << pinId)) != 0;
+	}
+	static void flashRead(void * dest, const void * flashSrc, size_t len) {
+		memcpy_P(dest, flashSrc, len);
+	}
+	static uint16_t flashReadWord(const uint16_t * flashSrc) {
+		return pgm_read_word(flashSrc);
+	}
+	static bool eepromRead(void * dest, unsigned int eepromAddr, size_t len) {
+		eeprom_read_block(dest, (const void *) eepromAddr, len);
+		return true;
+	}
+	static bool eepromWrite(unsigned int eepromAddr, const void * src, size_t len) {
+		eeprom_update_block(src, (void *) eepromAddr, len);
+		return true;
+	}
+
+	// every pin is on TB_PORT
+	static uint8_t pinPort(uint8_t pinId) { return 1; }
+	static uint8_t pinMask(uint8_t pinId) { return (1 << pinId); }
+	static void portOut(uint8_t port, uint8_t mask, bool value) {
+		if (value)
+		{
+			TB_PORT |= mask;
+		} else {
+			TB_PORT &= (0xff & ~mask);
+		}
+	}
+	static bool portEmit(uint8_t port, uint8_t dataMask, uint8_t clockMask,
+			const uint8_t * states, size_t len) {
+		while (len) {
+			size_t chunk = (len > 32) ? 32 : len;
+			len -= chunk;
+
+			uint8_t oldSREG = SREG;
+			cli();
+			uint8_t base = TB_PORT & ~(dataMask | clockMask);
+			while (chunk--) {
+				uint8_t low = base | *states++;
+				TB_PORT = low;
+				TB_PORT = low | clockMask;
+			}
+			TB_PORT = base;
+			SREG = oldSREG;
+		}
+
+		return true;
+	}
+	static bool portEmitPacked(uint8_t port, uint8_t dataMask, uint8_t clockMask,
+			const uint8_t * bytes, size_t len, bool inFlash) {
+		while (len) {
+			// a packet at a time, as for portEmit()
+			size_t chunk = (len > 4) ? 4 : len;
+			len -= chunk;
+
+			uint8_t oldSREG = SREG;
+			cli();
+			uint8_t low = TB_PORT & ~(dataMask | clockMask);
+			uint8_t high = low | dataMask;
+			while (chunk--) {
+				uint8_t byte = inFlash ? pgm_read_byte(bytes) : *bytes;
+				bytes++;
+				TINYBRITE_EMITBYTE(TB_PORT, byte, low, high, clockMask);
+			}
+			TB_PORT = low;
+			SREG = oldSREG;
+		}
+
+		return true;
+	}
 
 };
 
@@ -42,6 +42,15 @@
 
 // include the Arduino header, to use functions like pinMode and digitalWrite
 #include "Arduino.h"
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#define TINYBRITE_FLASH		PROGMEM
+#else
+#define TINYBRITE_FLASH
+#endif
+
 /* class MCU -- abstract away platform
  * This class simply acts as a centralised place to keep all our uC-specific functions.
  */
@@ -53,6 +62,167 @@ public:
 	static void delayUs(unsigned int us) { delayMicroseconds(us); }
 	static void setPinMode(uint8_t pinId, uint8_t mode) { pinMode(pinId, mode); }
 	static void digitalOut(uint8_t pinId, bool value) { digitalWrite(pinId, value); }
+	static bool digitalIn(uint8_t pinId) { return digitalRead(pinId) == HIGH; }
+	static unsigned long millis() { return ::millis(); }
+	static unsigned long micros() { return ::micros(); }
+
+#ifdef __AVR__
+	static void flashRead(void * dest, const void * flashSrc, size_t len) {
+		memcpy_P(dest, flashSrc, len);
+	}
+	static uint16_t flashReadWord(const uint16_t * flashSrc) {
+		return pgm_read_word(flashSrc);
+	}
+	static bool eepromRead(void * dest, unsigned int eepromAddr, size_t len) {
+		eeprom_read_block(dest, (const void *) eepromAddr, len);
+		return true;
+	}
+	static bool eepromWrite(unsigned int eepromAddr, const void * src, size_t len) {
+		// update only writes the bytes that differ, sparing EEPROM cells
+		eeprom_update_block(src, (void *) eepromAddr, len);
+		return true;
+	}
+
+	static uint8_t pinPort(uint8_t pinId) {
+		// NOT_A_PORT is 0
+		return digitalPinToPort(pinId);
+	}
+	static uint8_t pinMask(uint8_t pinId) { return digitalPinToBitMask(pinId); }
+	static void portOut(uint8_t port, uint8_t mask, bool value) {
+		volatile uint8_t * out = portOutputRegister(port);
+		uint8_t oldSREG = SREG;
+		cli();
+		if (value) {
+			*out |= mask;
+		} else {
+			*out &= ~mask;
+		}
+		SREG = oldSREG;
+	}
+	static bool portEmit(uint8_t port, uint8_t dataMask, uint8_t clockMask,
+			const uint8_t * states, size_t len) {
+		volatile uint8_t * out = portOutputRegister(port);
+
+		while (len) {
+			// a packet's worth at a time, so interrupts aren't held off long
+			size_t chunk = (len > 32) ? 32 : len;
+			len -= chunk;
+
+			uint8_t oldSREG = SREG;
+			cli();
+			// other pins on the port are left as they are
+			uint8_t base = *out & ~(dataMask | clockMask);
+			while (chunk--) {
+				uint8_t low = base | *states++;
+				*out = low;
+				*out = low | clockMask;
+			}
+			*out = base;
+			SREG = oldSREG;
+		}
+
+		return true;
+	}
+	static bool portEmitPacked(uint8_t port, uint8_t dataMask, uint8_t clockMask,
+			const uint8_t * bytes, size_t len, bool inFlash) {
+		volatile uint8_t * out = portOutputRegister(port);
+
+		while (len) {
+			// a packet at a time, as for portEmit()
+			size_t chunk = (len > 4) ? 4 : len;
+			len -= chunk;
+
+			uint8_t oldSREG = SREG;
+			cli();
+			uint8_t low = *out & ~(dataMask | clockMask);
+			uint8_t high = low | dataMask;
+			while (chunk--) {
+				uint8_t byte = inFlash ? pgm_read_byte(bytes) : *bytes;
+				bytes++;
+				TINYBRITE_EMITBYTE(*out, byte, low, high, clockMask);
+			}
+			*out = low;
+			SREG = oldSREG;
+		}
+
+		return true;
+	}
+
+	/*
+	 * The clock comes from a timer toggling its output compare pin, so
+	 * only works on pins 9 and 10 (Timer1) or 3 and 11 (Timer2) on an Uno,
+	 * 11 and 12 or 9 and 10 on a Mega... and takes the timer over: no
+	 * analogWrite() on its pins, nor Servo (Timer1) or tone() (Timer2).
+	 * The frequency is F_CPU / (2 * prescaler * n), as close to the one
+	 * asked for as that allows.
+	 */
+	static bool startClock(uint8_t pinId, unsigned long frequency_hz) {
+		if (!frequency_hz) {
+			return false;
+		}
+
+		uint8_t timer = digitalPinToTimer(pinId);
+
+#if defined(TCCR1A) && defined(TIMER1A) && defined(TIMER1B)
+		if (timer == TIMER1A || timer == TIMER1B) {
+			static const uint16_t prescalers[] = { 1, 8, 64, 256, 1024 };
+			for (uint8_t cs = 0; cs < 5; cs++) {
+				unsigned long top = F_CPU / (2UL * prescalers[cs] * frequency_hz);
+				if (top && top <= 0x10000UL) {
+					// CTC, up to OCR1A, toggling the pin on each match
+					TCCR1B = 0;
+					TCCR1A = (timer == TIMER1A) ? _BV(COM1A0) : _BV(COM1B0);
+					OCR1A = top - 1;
+					OCR1B = 0;
+					TCNT1 = 0;
+					TCCR1B = _BV(WGM12) | (cs + 1);
+					return true;
+				}
+			}
+			return false;
+		}
+#endif
+
+#if defined(TCCR2A) && defined(TIMER2A) && defined(TIMER2B)
+		if (timer == TIMER2A || timer == TIMER2B) {
+			static const uint16_t prescalers[] = { 1, 8, 32, 64, 128, 256, 1024 };
+			for (uint8_t cs = 0; cs < 7; cs++) {
+				unsigned long top = F_CPU / (2UL * prescalers[cs] * frequency_hz);
+				if (top && top <= 0x100UL) {
+					TCCR2B = 0;
+					TCCR2A = _BV(WGM21)
+							| ((timer == TIMER2A) ? _BV(COM2A0) : _BV(COM2B0));
+					OCR2A = top - 1;
+					OCR2B = 0;
+					TCNT2 = 0;
+					TCCR2B = cs + 1;
+					return true;
+				}
+			}
+			return false;
+		}
+#endif
+
+		return false;
+	}
+	static void stopClock(uint8_t pinId) {
+		uint8_t timer = digitalPinToTimer(pinId);
+
+#if defined(TCCR1A) && defined(TIMER1A) && defined(TIMER1B)
+		if (timer == TIMER1A || timer == TIMER1B) {
+			TCCR1B = 0;
+		}
+#endif
+#if defined(TCCR2A) && defined(TIMER2A) && defined(TIMER2B)
+		if (timer == TIMER2A || timer == TIMER2B) {
+			TCCR2B = 0;
+		}
+#endif
+
+		// also disconnects the timer from the pin
+		digitalWrite(pinId, LOW);
+	}
+#endif
 
 };
 
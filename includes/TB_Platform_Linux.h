@@ -0,0 +1,247 @@
+/*
+
+ TinyBrite Linux Platform -- platform implementation for Linux boards.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ *****************************  OVERVIEW  *****************************
+
+ This file defines the MCU class for Linux single-board computers
+ (Raspberry Pi, BeagleBone and friends), selected with
+ TINYBRITE_PLATFORM_LINUX.
+
+ Rather than bit-banging, packets are queued and clocked out by the SPI
+ controller: on each latch, the queue goes out through /dev/spidevX.Y in
+ a single SPI_IOC_MESSAGE ioctl (more only if the frame is larger than
+ what spidev accepts at once, see setMaxTransfer()).  Wire MOSI to DI
+ and SCLK to CI; the data and clock pins passed to setup() are ignored.
+
+ The latch and ~enable pins are lines of a GPIO character device
+ (/dev/gpiochipN), numbered by their offset on that chip.
+
+ For testing without the hardware, openFile() sends the data to any
+ file or pipe instead (one write() per SPI message it stands in for) and
+ GPIO is then ignored, so frame throughput can be measured on any Linux
+ box: see host/TinyBriteLinuxBench.cpp.
+
+ Everything goes through the transport returned by TinyBriteLinuxTransport::
+ instance(), which must be opened before calling setup().  That is a
+ single, default, transport unless another is put in use(), for the
+ calling thread: that's how several chains, each on its own SPI bus and
+ driven from its own thread, are handled (see host/TinyBritePipeline.h).
+
+ Build with -DTINYBRITE_PLATFORM_LINUX, compiling
+ host/TinyBriteLinuxTransport.cpp along with the library's .cpp files,
+ e.g.
+
+	cd path/to/TinyBrite
+	g++ -O2 -DTINYBRITE_PLATFORM_LINUX -I. -o myshow myshow.cpp *.cpp \
+		host/TinyBriteLinuxTransport.cpp
+
+ Usage:
+
+ TinyBrite brite_chain(500);
+
+ int main() {
+	 TinyBriteLinuxTransport & transport = TinyBriteLinuxTransport::instance();
+	 if (! (transport.openSPI("/dev/spidev0.0", 2000000)
+			 && transport.openGPIO("/dev/gpiochip0")))
+		 return 1;
+
+	 brite_chain.setup(0, 0, 25); // latch on GPIO line 25
+	 ...
+ }
+
+*/
+
+#ifndef TB_Platform_Linux_h
+#define TB_Platform_Linux_h
+
+#include "TinyBriteConfig.h"
+
+#ifdef TINYBRITE_PLATFORM_LINUX
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+
+#ifndef LOW
+#define LOW 0x0
+#endif
+
+#ifndef HIGH
+#define HIGH 0x1
+#endif
+
+#ifndef INPUT
+#define INPUT 0x0
+#endif
+
+#ifndef OUTPUT
+#define OUTPUT 0x1
+#endif
+
+#define TINYBRITE_FLASH
+
+/* sendPacket() hands whole packets to MCU::shiftPacket() */
+#define TINYBRITE_PLATFORM_PACKET_TRANSPORT
+
+/* GPIO lines that may be used, by offset on the chip */
+#define TINYBRITE_LINUX_MAX_GPIO_LINES		64
+
+/* spidev's default limit on the size of a single message */
+#define TINYBRITE_LINUX_DEFAULT_MAX_TRANSFER	4096
+
+/*
+ ** TinyBriteLinuxTransport
+ ** Where the SPI and GPIO file descriptors, and the packet queue, live.
+ */
+class TinyBriteLinuxTransport {
+
+public:
+
+	TinyBriteLinuxTransport();
+	~TinyBriteLinuxTransport();
+
+	/*
+	 ** instance
+	 ** The transport MCU functions go through, for the calling thread.
+	 */
+	static TinyBriteLinuxTransport & instance();
+
+	/*
+	 ** use
+	 ** Make MCU functions go through this transport for the calling thread
+	 ** (NULL to go back to the default one).  Only one thread should use a
+	 ** given transport at a time.
+	 */
+	static void use(TinyBriteLinuxTransport * transport);
+
+	/*
+	 ** openSPI
+	 ** Open a spidev device (mode 0, MSB first) at the given clock rate.
+	 ** The A6281 is good for up to 5MHz, less on long cables.
+	 */
+	bool openSPI(const char * device, uint32_t speed_hz);
+
+	/*
+	 ** openGPIO
+	 ** Open the GPIO character device holding the latch/~enable lines.
+	 */
+	bool openGPIO(const char * chip_device);
+
+	/*
+	 ** openFile
+	 ** Stand-in for SPI: write the data to a file or pipe (created if
+	 ** need be), one write() per SPI message.  GPIO is ignored.
+	 */
+	bool openFile(const char * path);
+
+	void close();
+
+	/*
+	 ** setMaxTransfer
+	 ** Largest number of bytes spidev takes in one message (its bufsiz
+	 ** module parameter, 4096 unless changed).
+	 */
+	void setMaxTransfer(size_t num_bytes);
+
+	void requestLine(uint8_t line, uint8_t mode);
+	void setLine(uint8_t line, bool value);
+	bool getLine(uint8_t line);
+
+	void queuePacket(uint32_t value);
+	bool flush();
+
+	/*
+	 ** Statistics: what went out, in how many system calls, and how many
+	 ** of those failed.
+	 */
+	unsigned long bytesSent() { return bytes_sent; }
+	unsigned long transfers() { return num_transfers; }
+	unsigned long errors() { return num_errors; }
+
+private:
+
+	bool transfer(const uint8_t * bytes, size_t len);
+
+	int spi_fd;
+	int file_fd;
+	int gpio_fd;
+	int line_fd[TINYBRITE_LINUX_MAX_GPIO_LINES];
+	uint32_t speed;
+
+	uint8_t * queue;
+	size_t queue_len;
+	size_t queue_size;
+	size_t max_transfer;
+
+	unsigned long bytes_sent;
+	unsigned long num_transfers;
+	unsigned long num_errors;
+
+};
+
+/* class MCU -- abstract away platform
+ * This class simply acts as a centralised place to keep all our uC-specific functions.
+ */
+class MCU : public BaseMCU {
+
+public:
+
+	static void delayMs(unsigned int ms) {
+		delayUs(ms * 1000UL);
+	}
+	static void delayUs(unsigned long us) {
+		struct timespec ts;
+		ts.tv_sec = us / 1000000UL;
+		ts.tv_nsec = (us % 1000000UL) * 1000UL;
+		nanosleep(&ts, NULL);
+	}
+	static void setPinMode(uint8_t pinId, uint8_t mode) {
+		TinyBriteLinuxTransport::instance().requestLine(pinId, mode);
+	}
+	static void digitalOut(uint8_t pinId, bool value) {
+		TinyBriteLinuxTransport::instance().setLine(pinId, value);
+	}
+	static bool digitalIn(uint8_t pinId) {
+		return TinyBriteLinuxTransport::instance().getLine(pinId);
+	}
+	static unsigned long millis() {
+		return micros() / 1000UL;
+	}
+	static unsigned long micros() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (unsigned long) ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+	}
+
+	static void shiftPacket(uint32_t value) {
+		TinyBriteLinuxTransport::instance().queuePacket(value);
+	}
+	static void flushPackets() {
+		TinyBriteLinuxTransport::instance().flush();
+	}
+
+};
+
+#endif /* TINYBRITE_PLATFORM_LINUX */
+
+#endif /* TB_Platform_Linux_h */
@@ -0,0 +1,190 @@
+/*
+
+ TinyBrite Simulator Platform -- a chain of A6281s, in software.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+ *****************************  OVERVIEW  *****************************
+
+ This file defines the MCU class for TINYBRITE_PLATFORM_SIMULATOR, which
+ runs the library on a host, against a model of the chain rather than
+ hardware, to check the bit-level code (e.g. loopback, which can't run
+ on TINYBRITE_PLATFORM_LINUX).
+
+ The TinyBriteChainSimulator models num_devices 32-bit shift registers
+ in series, driven through digitalOut(): DI is shifted in on each rising
+ edge of CI, and a rising edge of LI latches every register into its
+ device's PWM or command register (by the packet's mode bit).  The last
+ device's DO reads back through digitalIn() on the loopback pin.  The
+ simulated chain's length is set on its own, independently of what the
+ TinyBrite object is told, and a device can be made to receive nothing
+ but zeros, as if the link into it was broken.
+
+ Build with -DTINYBRITE_PLATFORM_SIMULATOR, compiling
+ host/TinyBriteChainSimulator.cpp along with the library's .cpp files:
+ see host/TinyBriteLoopbackCheck.cpp.
+
+ Usage:
+
+ TinyBriteChainSimulator & sim = TinyBriteChainSimulator::instance();
+ sim.setLength(30);
+ sim.attach(datapin, clockpin, latchpin, loopbackpin);
+
+ TinyBrite brite_chain(30);
+ brite_chain.setup(datapin, clockpin, latchpin);
+ ...
+ uint32_t shown = sim.latchedPWM(0); // device closest to the uC
+
+*/
+
+#ifndef TB_Platform_Simulator_h
+#define TB_Platform_Simulator_h
+
+#include "TinyBriteConfig.h"
+
+#ifdef TINYBRITE_PLATFORM_SIMULATOR
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#ifndef LOW
+#define LOW 0x0
+#endif
+
+#ifndef HIGH
+#define HIGH 0x1
+#endif
+
+#ifndef INPUT
+#define INPUT 0x0
+#endif
+
+#ifndef OUTPUT
+#define OUTPUT 0x1
+#endif
+
+#define TINYBRITE_FLASH
+
+/* digitalOut()/digitalIn() pins, 0 to TINYBRITE_SIMULATOR_MAX_PINS - 1 */
+#define TINYBRITE_SIMULATOR_MAX_PINS		64
+
+/* stands for "no device" in setStuck() */
+#define TINYBRITE_SIMULATOR_NONE			0xFFFF
+
+/*
+ ** TinyBriteChainSimulator
+ ** The simulated chain: what's in its shift registers, and what's latched.
+ */
+class TinyBriteChainSimulator {
+
+public:
+
+	TinyBriteChainSimulator();
+	~TinyBriteChainSimulator();
+
+	/*
+	 ** instance
+	 ** The simulator the MCU functions go through.
+	 */
+	static TinyBriteChainSimulator & instance();
+
+	/*
+	 ** setLength
+	 ** Build a chain of num_devices, with every register cleared.
+	 ** Returns false if out of memory.
+	 */
+	bool setLength(uint16_t num_devices);
+	uint16_t length() { return num_devices; }
+
+	/*
+	 ** attach
+	 ** The pins wired to the chain's DI, CI, LI and to the last DO.
+	 */
+	void attach(uint8_t datapin, uint8_t clockpin, uint8_t latchpin,
+			uint8_t loopbackpin);
+
+	/*
+	 ** setStuck
+	 ** Break the link into a device (0 is closest to the uC): it only gets
+	 ** zeros from then on.  TINYBRITE_SIMULATOR_NONE mends it.
+	 */
+	void setStuck(uint16_t device) { stuck_device = device; }
+
+	/*
+	 ** shiftRegister / latchedPWM / latchedCommand
+	 ** Contents of a device's registers (0 is closest to the uC).
+	 */
+	uint32_t shiftRegister(uint16_t device);
+	uint32_t latchedPWM(uint16_t device);
+	uint32_t latchedCommand(uint16_t device);
+
+	/*
+	 ** Clock and latch edges seen so far.
+	 */
+	unsigned long clocks() { return num_clocks; }
+	unsigned long latches() { return num_latches; }
+
+	void setLine(uint8_t pin, bool value);
+	bool getLine(uint8_t pin);
+
+private:
+
+	void clock();
+	void latch();
+	uint8_t & bit(unsigned long position);
+
+	uint16_t num_devices;
+	uint8_t * bits;
+	unsigned long num_bits;
+	unsigned long head;
+	uint32_t * pwm;
+	uint32_t * command;
+	uint16_t stuck_device;
+
+	uint8_t pin_data;
+	uint8_t pin_clock;
+	uint8_t pin_latch;
+	uint8_t pin_loopback;
+	bool levels[TINYBRITE_SIMULATOR_MAX_PINS];
+
+	unsigned long num_clocks;
+	unsigned long num_latches;
+
+};
+
+/* class MCU -- abstract away platform
+ * This class simply acts as a centralised place to keep all our uC-specific functions.
+ */
+class MCU : public BaseMCU {
+
+public:
+
+	static void digitalOut(uint8_t pinId, bool value) {
+		TinyBriteChainSimulator::instance().setLine(pinId, value);
+	}
+	static bool digitalIn(uint8_t pinId) {
+		return TinyBriteChainSimulator::instance().getLine(pinId);
+	}
+
+};
+
+#endif /* TINYBRITE_PLATFORM_SIMULATOR */
+
+#endif /* TB_Platform_Simulator_h */
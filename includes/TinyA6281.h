@@ -51,16 +51,23 @@
 
 #define TA6281_CORRECTION_MAXVALUE	127
 
-#define TA6281_COMMAND_CLOCK_800kHz		B00
-#define TA6281_COMMAND_CLOCK_400kHz		B10
-#define TA6281_COMMAND_CLOCK_200kHz		B11
-#define TA6281_COMMAND_CLOCK_EXT		B01
+#define TA6281_COMMAND_CLOCK_800kHz		0x0
+#define TA6281_COMMAND_CLOCK_400kHz		0x2
+#define TA6281_COMMAND_CLOCK_200kHz		0x3
+#define TA6281_COMMAND_CLOCK_EXT		0x1
 
 #define TA6281_AUTOUPDATE_ENABLE	true
 #define TA6281_AUTOUPDATE_DISABLE	false
 
 
-#ifdef TA6281_STATE_TRACKING_BIGNUM
+/*
+ ** DriverNum
+ ** The type used for every device count and index (chain length, packet
+ ** counts, loop counters).  It stays 8-bit on AVRs, where it matters, unless
+ ** TA6281_STATE_TRACKING_BIGNUM is set in TinyBriteConfig.h, and is 16-bit
+ ** everywhere else.
+ */
+#if defined(TA6281_STATE_TRACKING_BIGNUM) || !defined(__AVR__)
 typedef uint16_t	DriverNum;
 #else
 typedef uint8_t		DriverNum;
@@ -75,7 +82,7 @@ typedef uint8_t		DriverNum;
  ** clock settings and device testing).
  */
 typedef union A6281Packet {
-	unsigned long value;
+	uint32_t value;
 
 	struct {
 		unsigned pwm_0 :10;
@@ -104,6 +111,51 @@ typedef union A6281Packet {
 typedef A6281Packet		StatePacket;
 #endif
 
+/*
+ **  A6281CompiledFrame
+ **
+ ** A frame turned into what goes on the data line, ready to be replayed
+ ** (see compileFrame()), in one of these formats:
+ **
+ **  TA6281_COMPILE_STATES  one byte per bit, 32 per packet, holding the data
+ **                         pin's port mask if the bit is set, 0 otherwise:
+ **                         nothing left to do but write them.
+ **  TA6281_COMPILE_PACKED  the bits as they go out, 4 bytes per packet, in
+ **                         RAM: each bit takes a test, but no shifting.
+ **  TA6281_COMPILE_FLASH   packed, in flash (see compileFlashFrame()).
+ **
+ ** Treat as opaque.
+ */
+#define TA6281_COMPILE_STATES	0
+#define TA6281_COMPILE_PACKED	1
+#define TA6281_COMPILE_FLASH	2
+
+#define TA6281_COMPILEDFRAME_SIZE(num_packets)	((size_t) (num_packets) * 32)
+#define TA6281_PACKEDFRAME_SIZE(num_packets)	((size_t) (num_packets) * 4)
+
+/*
+ ** TA6281_PACKED_PACKET
+ ** A packet's value as the 4 bytes of a packed frame, to build flash
+ ** frames from, e.g.
+ **  const uint8_t idle[] TINYBRITE_FLASH = {
+ **      TA6281_PACKED_PACKET(0x00000000), TA6281_PACKED_PACKET(0x3FFFFFFF)
+ **  };
+ */
+#define TA6281_PACKED_PACKET(value) \
+	(uint8_t) ((uint32_t) (value) >> 24), (uint8_t) ((uint32_t) (value) >> 16), \
+	(uint8_t) ((uint32_t) (value) >> 8), (uint8_t) (value)
+
+typedef struct A6281CompiledFrame {
+	DriverNum num_packets;
+	uint8_t format;
+	uint8_t pin_data;
+	uint8_t pin_clock;
+	uint8_t port;
+	uint8_t data_mask;
+	uint8_t clock_mask;
+	const uint8_t * states;
+} A6281CompiledFrame;
+
 
 
 /*
@@ -146,6 +198,56 @@ public:
 	 */
 	void setAutoUpdate(bool setTo);
 
+	/*
+	 ** Latch coalescing.
+	 ** Sending a whole chain in auto-update mode means one latch per
+	 ** packet, which is slow and shows every intermediate step.  With
+	 ** coalescing on, packets sent in auto-update mode are shifted right
+	 ** away but only latched once nothing more has been sent for a quiet
+	 ** interval, so a burst of sendColor() calls gets a single latch.
+	 **
+	 ** The latch happens:
+	 ** * in poll(), once the quiet interval is over;
+	 ** * on the next send, if the quiet interval is over by then;
+	 ** * in flush(), right away.
+	 ** As there's no timer behind this, sketches that wait around (e.g.
+	 ** with delay()) must call flush() before waiting, or poll() while
+	 ** they do.
+	 */
+
+	/* setLatchCoalescing
+	 ** Set the quiet interval, in microseconds (0, the default, latches
+	 ** every packet as usual).
+	 */
+	void setLatchCoalescing(unsigned long quiet_us);
+	unsigned long latchCoalescing() { return latch_quiet_us; }
+
+	/* flush
+	 ** Latch anything that was sent but is waiting for the quiet interval.
+	 */
+	void flush();
+
+	/* poll
+	 ** Latch if something is waiting and the quiet interval is over.
+	 ** Returns true if it latched.
+	 */
+	bool poll();
+
+	/* numDrivers
+	 ** Returns the number of devices in the chain.
+	 */
+	DriverNum numDrivers() { return num_drivers; }
+
+	/* setNumDrivers
+	 ** Change the number of devices in the chain.  Tracked state is resized,
+	 ** keeping that of the devices that remain (counting from the uC), and
+	 ** any correction map is dropped, as it no longer fits.  Helpers keep
+	 ** the length they had at their begin() (and only send that much), so
+	 ** resize before setting them up.  Returns false if the state vector
+	 ** couldn't be re-allocated.
+	 */
+	bool setNumDrivers(DriverNum num);
+
 	/* setup:
 	 ** Two versions available: with and without an ~enable pin.
 	 **
@@ -215,11 +317,45 @@ public:
 	 */
 	DriverNum endUpdate();
 
+	/*
+	 ** abortUpdate
+	 ** End an update cycle without latching: whatever was shifted in stays
+	 ** in the shift registers, unseen, until pushed out by the next update.
+	 */
+	void abortUpdate();
+
+	/*
+	 ** updatePending
+	 ** True from beginUpdate(), or from the first packet sent, until the
+	 ** data is latched: i.e. while the shift registers hold something the
+	 ** application hasn't made visible yet.
+	 */
+	bool updatePending() { return update_pending; }
+
+	/*
+	 ** holdLatch / releaseLatch
+	 ** While held, endUpdate() (and auto-updates) shift data in as usual but
+	 ** leave the latch pending, and releaseLatch() latches it, along with
+	 ** any automatic dot-correction refresh that came due in the meantime.
+	 ** Used to latch several chains at once (see TinyBriteGroup); only send
+	 ** PWM data while the latch is held.
+	 */
+	void holdLatch() { latch_held = true; }
+	void releaseLatch();
+	bool latchHeld() { return latch_held; }
+
+	/*
+	 ** latchCount
+	 ** Number of latches so far (wraps around), to tell if anything was
+	 ** displayed since last checked.
+	 */
+	uint16_t latchCount() { return latch_count; }
+
 	/*
 	 ** sendPacket
 	 ** Send a packet of data to our chain of A6281 devices.
 	 */
-	void sendPacket(A6281Packet packet, uint8_t num_times=1);
+	void sendPacket(A6281Packet packet, DriverNum num_times=1);
 
 	/*
 	 ** sendPackets
@@ -227,6 +363,38 @@ public:
 	 */
 	void sendPackets(A6281Packet * packets, DriverNum numPackets);
 
+	/*
+	 ** compileFrame / compileFlashFrame / sendPackets(compiled frame)
+	 ** Scenes that are replayed over and over (idle loops, alarms...) can
+	 ** be compiled once, for this chain's pins, and sent with no per-bit
+	 ** work: where data and clock share a port, the bits are written
+	 ** straight to it.
+	 **
+	 ** What that costs, until freeFrame():
+	 **  - TA6281_COMPILE_STATES, the fastest, takes 32 bytes of RAM per
+	 **    packet: 960 bytes for 30 devices, half an ATmega328's RAM, and
+	 **    19.2KB for 600, which only fits on a bigger part.
+	 **  - TA6281_COMPILE_PACKED takes 4 bytes per packet (2.4KB for 600),
+	 **    for a bit test per bit on replay.
+	 **  - compileFlashFrame() takes no RAM at all: it points at packed
+	 **    bytes in flash, built with TA6281_PACKED_PACKET(), and replays
+	 **    as fast as PACKED but for a flash read per byte.
+	 **
+	 ** With state tracking on, the packets are also recorded (rebuilt from
+	 ** the frame, which costs part of the gain), then the frame goes out
+	 ** as compiled.  While blacked out, with latch coalescing, or on
+	 ** platforms that send whole packets (e.g. Linux), the frame is rebuilt
+	 ** and sent packet by packet, through sendPacket(), instead: it still
+	 ** works, just without the speed up.
+	 */
+	bool compileFrame(const A6281Packet * packets, DriverNum numPackets,
+			A6281CompiledFrame & frame,
+			uint8_t format = TA6281_COMPILE_STATES);
+	void compileFlashFrame(const uint8_t * flash_bytes, DriverNum numPackets,
+			A6281CompiledFrame & frame);
+	void sendPackets(const A6281CompiledFrame & frame);
+	static void freeFrame(A6281CompiledFrame & frame);
+
 	/*
 	 ** sendPacketToAll
 	 ** Send a single packet to every driver in our chain of A6281 devices.
@@ -246,8 +414,114 @@ public:
 	void sendCommand(unsigned int dotCorrect0, unsigned int dotCorrect1,
 			unsigned int dotCorrect2, unsigned char clockMode);
 
+	/*
+	 ** Dot-correction scaling.
+	 ** The A6281 has a 7-bit dot-correction register per channel which
+	 ** scales its output current in hardware.  The dot-correction and clock
+	 ** mode of the last sendCommand() are taken as the setting for the whole
+	 ** chain (all at maximum, 800kHz internal clock, until then) unless a
+	 ** per-device correction map is set, and may be scaled down by a single
+	 ** factor, to dim everything without touching PWM values.
+	 **
+	 ** Command packets never change the tracked (PWM) state.
+	 */
+
+	/*
+	 ** setCorrectionScale
+	 ** Scale the dot-correction of every device, from 0 to
+	 ** TA6281_CORRECTION_MAXVALUE (no scaling), and send it.
+	 */
+	void setCorrectionScale(uint8_t scale);
+	uint8_t correctionScale() { return correction_scale; }
+
+	/*
+	 ** sendCorrection
+	 ** Send the (scaled) dot-correction and clock mode to every device in a
+	 ** single pass and latch it.  Must not be called within an update cycle.
+	 */
+	void sendCorrection();
+
+	/*
+	 ** setExternalClock
+	 ** Drive the PWM clock of every device from the clock pin: the chain is
+	 ** switched to TA6281_COMMAND_CLOCK_EXT, and a continuous clock of
+	 ** frequency_hz is generated by a hardware timer whenever data isn't
+	 ** being shifted.  All devices then run their PWM cycles in step, at a
+	 ** rate of frequency_hz / 1024 cycles per second.  0 goes back to the
+	 ** clock mode of the last sendCommand().  Returns false if the platform
+	 ** can't generate a clock on that pin (see TB_Platform_XXX.h).
+	 **
+	 ** The clock also shifts the registers (zeros, as DI is held low), so
+	 ** whatever was left in them is gone by the next latch.  With state
+	 ** tracking, the whole tracked state is shifted back in before a
+	 ** partial update (or auto-update) is latched.  Without it, only full
+	 ** frames (numDrivers() packets) may be sent while the clock runs:
+	 ** endUpdate() aborts shorter ones, returning 0.
+	 */
+	bool setExternalClock(unsigned long frequency_hz);
+	unsigned long externalClock() { return external_clock_hz; }
+
+	/*
+	 ** setCorrectionMap
+	 ** Use a command packet per device (index 0 is closest to the uC) rather
+	 ** than the chain-wide setting, for the first num_entries devices (the
+	 ** rest get the chain-wide one).  The array isn't copied, so must stay
+	 ** around; pass NULL to go back to the last sendCommand().  Nothing is
+	 ** sent until sendCorrection().
+	 */
+	void setCorrectionMap(const A6281Packet * per_device, DriverNum num_entries);
+	const A6281Packet * correctionMap() { return command_map; }
+
+	/*
+	 ** correctionPacket
+	 ** The (scaled) command packet sendCorrection() sends to a device.
+	 */
+	A6281Packet correctionPacket(DriverNum driver_index);
+
+	/*
+	 ** setCorrectionRefresh
+	 ** The A6281 may lose its command registers on a brown-out (and come back
+	 ** at its power-on defaults).  Set this to have sendCorrection() called
+	 ** automatically after every num_latches latches, or to 0 (the default)
+	 ** to only send corrections when asked.
+	 */
+	void setCorrectionRefresh(uint16_t num_latches);
+
+
 
 
+#ifdef TA6281_LOOPBACK_ENABLE
+	/*
+	 ** Loopback.
+	 ** With the DO of the last device wired back to an input pin, data
+	 ** can be followed all the way through the chain.  Nothing is latched
+	 ** while checking, so the devices keep displaying what they were, and
+	 ** the tracked state (if any) is shifted back in when done.
+	 ** Neither check may be called within an update cycle.
+	 */
+
+	/*
+	 ** setLoopbackPin
+	 ** Register and configure the input pin wired to the last DO.
+	 */
+	void setLoopbackPin(uint8_t loopbackpin);
+
+	/*
+	 ** detectChainLength
+	 ** Shift a marker through and count the clocks until it comes out, to
+	 ** find the number of devices (up to max_drivers).  Returns 0 if it
+	 ** never does.  Unless told otherwise, the chain is then resized to
+	 ** match (see setNumDrivers()).
+	 */
+	DriverNum detectChainLength(DriverNum max_drivers, bool resize = true);
+
+	/*
+	 ** verifyChain
+	 ** Check that a test word comes out intact, after exactly
+	 ** numDrivers() packets.
+	 */
+	bool verifyChain();
+#endif
 
 #ifdef TA6281_STATE_TRACKING_ENABLE
 	bool stateTracking() {return tracking_state; }
@@ -256,17 +530,138 @@ public:
 	StatePacket * getState(DriverNum driver_index);
 	DriverNum saveState(StatePacket * a_state_vector);
 	void restoreState(StatePacket * a_state_vector);
+
+	/*
+	 ** setState
+	 ** Change the tracked state of a device (index 0 is closest to the uC)
+	 ** without sending anything.  Use refresh() to make it take effect.
+	 */
+	bool setState(DriverNum driver_index, StatePacket packet);
+
+	/*
+	 ** refresh
+	 ** Re-send the tracked state of every device in a single pass, and latch it.
+	 ** With with_correction, the dot-correction is sent (and latched) first,
+	 ** in the same pass as sendCorrection() puts the state back.
+	 ** Returns the number of packets sent (0 if we aren't tracking state).
+	 */
+	DriverNum refresh(bool with_correction = false);
+
+	/*
+	 ** Blackout detection.
+	 ** A count of the tracked devices that aren't black is kept as packets
+	 ** are sent.  With blackout detection on, an update that leaves them
+	 ** all black blanks the chain through ~enable and, from then on, colours
+	 ** are only tracked, not shifted (nor latched), which saves time and
+	 ** power.  The first update that lights something up sends the whole
+	 ** tracked state and re-enables the chain (unless setEnabled(false)
+	 ** was called in the meantime).  Command packets are still shifted,
+	 ** and latched at the end of their update cycle, while blacked out.
+	 **
+	 ** Needs state tracking and the ~enable pin (see setup()).
+	 */
+
+	/*
+	 ** setBlackoutDetection
+	 ** Turn blackout detection on or off.  Returns the resulting setting.
+	 */
+	bool setBlackoutDetection(bool setTo);
+	bool blackoutDetection() { return blackout_detection; }
+
+	/*
+	 ** blackedOut
+	 ** True while the chain is blanked because everything is black: a
+	 ** good time for the MCU to sleep.
+	 */
+	bool blackedOut() { return blacked_out; }
+
+	/*
+	 ** numLit
+	 ** Number of tracked devices that aren't black.
+	 */
+	DriverNum numLit() { return lit_count; }
+
+	/*
+	 ** Power limiting.
+	 ** A chain at full white may draw more than its supply can give.  With
+	 ** a power limit set, the current each update would draw is estimated
+	 ** from the tracked PWM values and the dot-correction, and the chain's
+	 ** dot-correction is turned down (on top of setCorrectionScale()) just
+	 ** enough to stay within the limit, before the update is latched.  It
+	 ** comes back up once the frames are light enough again.
+	 **
+	 ** The per-channel sums behind the estimate are kept up to date as
+	 ** packets are tracked, so checking an update costs the same whatever
+	 ** the chain's length; a correction pass is only sent when the scale
+	 ** has to change.  With a correction map, each channel is counted at
+	 ** the highest dot-correction last sent to any device.  Within a group
+	 ** (see TinyBriteGroup), the correction is sent right after the group
+	 ** latches.
+	 **
+	 ** The A6281 still drives about a third of its current at the lowest
+	 ** dot-correction, so a limit well below what a frame needs can't be
+	 ** met: powerEstimate() then stays above powerLimit().
+	 **
+	 ** Needs state tracking, and the whole chain sent at least once (until
+	 ** then, untracked devices count as black).
+	 */
+
+	/*
+	 ** setPowerLimit
+	 ** Limit the chain to budget_ma milliamps, where channel_ma is the
+	 ** current of a single LED channel at full PWM and dot-correction
+	 ** (as set by the module's Rset: e.g. 120 on a MegaBrite, 60 on a
+	 ** ShiftBrite).  A budget of 0 removes the limit.  Returns false if
+	 ** state isn't being tracked.
+	 */
+	bool setPowerLimit(unsigned long budget_ma, unsigned int channel_ma);
+	unsigned long powerLimit() { return power_budget_ma; }
+
+	/*
+	 ** powerEstimate
+	 ** Current drawn by the LEDs, in milliamps, for the tracked state at
+	 ** the dot-correction in use.
+	 */
+	unsigned long powerEstimate();
+
+	/*
+	 ** powerLimited
+	 ** True while the dot-correction is being held down by the limit.
+	 */
+	bool powerLimited() { return power_scale < correction_scale; }
 #endif
 
 
 private:
 
+	friend class TinyBriteGroup;
+
 	void latch();
+	void pulseLatch();
+	void latchReleased();
+	void resumeClock();
+	bool restoreClocked();
+	DriverNum correctionPass(bool latch_state);
+	void emitFrame(const A6281CompiledFrame & frame);
+	void compileFor(A6281CompiledFrame & frame);
+	static A6281Packet compiledPacket(const A6281CompiledFrame & frame,
+			DriverNum index);
+#ifdef TA6281_STATE_TRACKING_ENABLE
+	void trackPacket(A6281Packet packet, DriverNum num_times);
+#endif
 
 	void setPins(uint8_t datapin, uint8_t clockpin, uint8_t latchpin,
 			uint8_t nEnablepin);
 
 	bool using_nEnable;
+	bool user_enabled;
+#ifdef TA6281_LOOPBACK_ENABLE
+	bool using_loopback;
+	uint8_t pin_loopback;
+
+	bool loopbackClock(bool bit);
+	void loopbackDone();
+#endif
 
 	uint8_t pin_data;
 	uint8_t pin_clock;
@@ -276,10 +671,53 @@ private:
 	DriverNum num_sent;
 	DriverNum num_drivers;
 	bool auto_update_cycle;
+	bool update_pending;
+	uint16_t latch_count;
+
+	bool latch_held;
+	bool latch_owed;
+	bool correction_due;
+
+	unsigned long external_clock_hz;
+	bool clock_running;
+	bool registers_clocked;
+
+	bool latch_pending;
+	unsigned long latch_quiet_us;
+	unsigned long last_send_us;
+
+	A6281Packet command_base;
+	const A6281Packet * command_map;
+	DriverNum command_map_len;
+	uint8_t correction_scale;
+	uint16_t correction_refresh;
+	uint16_t latches_since_correction;
+	A6281Packet scaledCommand(A6281Packet command);
+	uint8_t appliedScale();
+
 #ifdef TA6281_STATE_TRACKING_ENABLE
 	bool tracking_state;
 	StatePacket * state_vector;
 	DriverNum state_vector_head_idx;
+
+	DriverNum lit_count;
+	bool blackout_detection;
+	bool blacked_out;
+	bool command_shifted;
+
+	// sum of each PWM channel over the tracked state, and what it may draw
+	unsigned long pwm_sum[3];
+	unsigned long power_budget_ma;
+	unsigned int power_channel_ma;
+	uint8_t power_scale;
+	A6281Packet correction_peak;
+
+	DriverNum stateSlot(DriverNum driver_index);
+	void reverseState(DriverNum from, DriverNum to);
+	bool resizeState(DriverNum num);
+	void shiftState();
+	unsigned long powerLoad(uint16_t mult);
+	uint8_t powerScaleNeeded();
 #endif
 
 };
@@ -34,19 +34,31 @@
  * Defining ONE of the available
  * 	TINYBRITE_PLATFORM_XXX
  * options compiles the library for a given hardware
- * platform.
+ * platform:
  *
- * At this time, only TINYBRITE_PLATFORM_ARDUINO (Arduino support)
- * is available.
+ * 	TINYBRITE_PLATFORM_ARDUINO	Arduino support (the default)
+ * 	TINYBRITE_PLATFORM_AVR		bare AVR, using avr-libc
+ * 	TINYBRITE_PLATFORM_LINUX	Linux boards, through spidev and GPIO
+ * 					character devices (see TB_Platform_Linux.h)
+ * 	TINYBRITE_PLATFORM_SIMULATOR	a simulated chain, to check the library
+ * 					on a host (see TB_Platform_Simulator.h)
+ *
+ * The platform may also be selected on the compiler command line
+ * (e.g. -DTINYBRITE_PLATFORM_LINUX), in which case the default below
+ * doesn't apply.
  */
+#if !defined(TINYBRITE_PLATFORM_ARDUINO) && !defined(TINYBRITE_PLATFORM_AVR) \
+	&& !defined(TINYBRITE_PLATFORM_LINUX) && !defined(TINYBRITE_PLATFORM_SIMULATOR)
 #define TINYBRITE_PLATFORM_ARDUINO
 // #define TINYBRITE_PLATFORM_AVR
+#endif
 
 #ifdef TINYBRITE_PLATFORM_AVR
 #include <avr/io.h>
 #define F_CPU	1600000UL
 #define TB_DATADIR_PORT		DDRB
 #define TB_PORT				PORTB
+#define TB_PIN				PINB
 #endif
 
 /*
@@ -78,7 +90,7 @@
 /*
  * TA6281_STATE_TRACKING_BIGNUM
  *
- * If you have > 255 'brites controlled by this library,
+ * If you have > 255 'brites controlled by this library on an AVR,
  * you must define
  *
  * 	TA6281_STATE_TRACKING_BIGNUM
@@ -86,9 +98,31 @@
  * in order to index the number of drivers correctly.  If you
  * are controlling less than 256 'Brites, leave this undefined.
  *
+ * This selects the DriverNum type used for all chain lengths,
+ * counts and indices.  On non-AVR platforms, it is always 16-bit
+ * (up to 65535 devices) and this setting has no effect.
+ *
  */
 //#define TA6281_STATE_TRACKING_BIGNUM
 
+/*
+ * TA6281_LOOPBACK_ENABLE
+ *
+ * If the data out (DO) of the last device in the chain is wired back
+ * to an input pin, the library can count the devices in the chain and
+ * check that data makes it all the way through (see
+ * detectChainLength() and verifyChain() in TinyA6281.h).
+ *
+ * Define TA6281_LOOPBACK_ENABLE to include this functionality.  It can
+ * be checked on a host with TINYBRITE_PLATFORM_SIMULATOR (see
+ * host/TinyBriteLoopbackCheck.cpp).
+ */
+//#define TA6281_LOOPBACK_ENABLE
+
+#if defined(TA6281_LOOPBACK_ENABLE) && defined(TINYBRITE_PLATFORM_LINUX)
+#error "TA6281_LOOPBACK_ENABLE needs bit-level access to the chain, not available on TINYBRITE_PLATFORM_LINUX"
+#endif
+
 /*
  * TA6281_DEFAULT_XXX
  * Sets the default pin for data, nEnable, clock and latch.
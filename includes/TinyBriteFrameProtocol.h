@@ -0,0 +1,83 @@
+/*
+
+ TinyBriteFrameProtocol.h -- part of the TinyBrite library.
+ Copyright (C) 2013 Pat Deegan.  All rights reserved.
+
+ Wire format for frames streamed to a chain from a host.
+
+
+ http://www.flyingcarsandstuff.com/projects/tinybrite/
+
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 3 of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+ See file LICENSE.txt for further informations on licensing terms.
+
+
+ *****************************  OVERVIEW  *****************************
+
+ Frames are sent over a byte stream (usually a UART) as:
+
+   +-------+-------+------+--------+--------+-----------+------+------+
+   | SYNC0 | SYNC1 | TYPE | LEN hi | LEN lo |  payload  | CK1  | CK2  |
+   +-------+-------+------+--------+--------+-----------+------+------+
+
+ LEN is the number of devices carried by the frame.
+
+ For a TINYBRITE_FRAME_TYPE_FULL frame, the payload is LEN device
+ entries of 4 bytes each, sent big-endian, in the order they are to be
+ shifted into the chain (i.e. the same order you'd pass them to
+ sendPackets(): the first entry winds up furthest from the uC).  Each
+ entry holds three 10-bit values:
+
+   bits 29..20: red, bits 19..10: green, bits 9..0: blue
+
+ (bits 31 and 30 are reserved and must be 0).
+
+ A TINYBRITE_FRAME_TYPE_DELTA frame only carries the devices that changed
+ since the previous frame.  Its payload is LEN entries of 6 bytes: a
+ big-endian 16-bit index, followed by the 4 byte colour entry described
+ above.  The index is the position the device occupies in a full frame
+ for the whole chain (so index 0 is the device furthest from the uC).
+ The receiver applies the changes to its tracked state and emits the
+ whole chain in one pass, so delta frames need state tracking.
+
+ If a delta frame is lost or corrupt, the receiver ignores every delta
+ until the next full frame covering the whole chain (a "keyframe"), so
+ senders should emit keyframes periodically.
+
+ CK1/CK2 are Fletcher-style running sums (modulo 256) over every byte
+ from TYPE to the end of the payload: for each byte b,
+   CK1 += b; CK2 += CK1;
+ A frame with a bad checksum is dropped.
+
+*/
+
+#ifndef TinyBriteFrameProtocol_h
+#define TinyBriteFrameProtocol_h
+
+#define TINYBRITE_FRAME_SYNC0			0xA6
+#define TINYBRITE_FRAME_SYNC1			0x81
+
+#define TINYBRITE_FRAME_TYPE_FULL		0x01
+#define TINYBRITE_FRAME_TYPE_DELTA		0x02
+
+#define TINYBRITE_FRAME_HEADER_SIZE		5
+#define TINYBRITE_FRAME_CHECKSUM_SIZE	2
+#define TINYBRITE_FRAME_ENTRY_SIZE		4
+#define TINYBRITE_FRAME_INDEX_SIZE		2
+#define TINYBRITE_FRAME_DELTA_ENTRY_SIZE	(TINYBRITE_FRAME_INDEX_SIZE + TINYBRITE_FRAME_ENTRY_SIZE)
+
+#define TINYBRITE_FRAME_ENTRY_RED_SHIFT		20
+#define TINYBRITE_FRAME_ENTRY_GREEN_SHIFT	10
+#define TINYBRITE_FRAME_ENTRY_BLUE_SHIFT	0
+#define TINYBRITE_FRAME_ENTRY_COLORMASK		0x3FF
+
+#endif /* TinyBriteFrameProtocol_h */
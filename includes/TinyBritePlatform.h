@@ -32,6 +32,8 @@
 
 
 #include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
 
 class BaseMCU {
 
@@ -41,12 +43,91 @@ public:
 	static void delayUs(unsigned int us) {}
 	static void setPinMode(uint8_t pinId, uint8_t mode) {}
 	static void digitalOut(uint8_t pinId, bool value) {}
+	static bool digitalIn(uint8_t pinId) { return false; }
+
+	/*
+	 * Milliseconds since startup, for things that run on a schedule.
+	 * Platforms without a time base return 0: pass the time in explicitly.
+	 */
+	static unsigned long millis() { return 0; }
+	static unsigned long micros() { return 0; }
+
+	/*
+	 * Constant data tables may be placed in flash by declaring them
+	 * TINYBRITE_FLASH, in which case they must be read with flashRead()
+	 * (or flashReadWord(), a uint16_t at a time).  Where flash and RAM
+	 * share an address space, this is a memcpy.
+	 */
+	static void flashRead(void * dest, const void * flashSrc, size_t len) {
+		memcpy(dest, flashSrc, len);
+	}
+	static uint16_t flashReadWord(const uint16_t * flashSrc) { return *flashSrc; }
+
+	/*
+	 * EEPROM access: returns false if the platform has no EEPROM.
+	 */
+	static bool eepromRead(void * dest, unsigned int eepromAddr, size_t len) { return false; }
+	static bool eepromWrite(unsigned int eepromAddr, const void * src, size_t len) { return false; }
+
+	/*
+	 * Pins on the same output port can be switched together, by a single
+	 * write: pinPort() returns 0 where that isn't possible.
+	 */
+	static uint8_t pinPort(uint8_t pinId) { return 0; }
+	static uint8_t pinMask(uint8_t pinId) { return 0; }
+	static void portOut(uint8_t port, uint8_t mask, bool value) {}
+
+	/*
+	 * Clock out precomputed data line states on a port: for each of the len
+	 * states (dataMask or 0), write it with the clock low, then high.
+	 * Returns false if that can't be done, to go a pin at a time instead.
+	 */
+	static bool portEmit(uint8_t port, uint8_t dataMask, uint8_t clockMask,
+			const uint8_t * states, size_t len) { return false; }
+
+	/*
+	 * Same, from len packed bytes (MSB first), in flash if inFlash.
+	 */
+	static bool portEmitPacked(uint8_t port, uint8_t dataMask, uint8_t clockMask,
+			const uint8_t * bytes, size_t len, bool inFlash) { return false; }
+
+	/*
+	 * A continuous clock on a pin, from a hardware timer (for the A6281's
+	 * external PWM clock): startClock() returns false if the platform
+	 * can't generate one on that pin.  stopClock() leaves the pin low.
+	 */
+	static bool startClock(uint8_t pinId, unsigned long frequency_hz) { return false; }
+	static void stopClock(uint8_t pinId) {}
 
 };
 
+/*
+ * For portEmitPacked(): clock a packed byte out on a port register, MSB
+ * first.  Each bit is tested against a constant mask, so nothing is
+ * shifted; low and high are the port with the data pin low and high.
+ */
+#define TINYBRITE_EMITBIT(out, byte, bitMask, low, high, clockMask) \
+	{ \
+		uint8_t level = ((byte) & (bitMask)) ? (high) : (low); \
+		out = level; \
+		out = level | (clockMask); \
+	}
+
+#define TINYBRITE_EMITBYTE(out, byte, low, high, clockMask) \
+	TINYBRITE_EMITBIT(out, byte, 0x80, low, high, clockMask) \
+	TINYBRITE_EMITBIT(out, byte, 0x40, low, high, clockMask) \
+	TINYBRITE_EMITBIT(out, byte, 0x20, low, high, clockMask) \
+	TINYBRITE_EMITBIT(out, byte, 0x10, low, high, clockMask) \
+	TINYBRITE_EMITBIT(out, byte, 0x08, low, high, clockMask) \
+	TINYBRITE_EMITBIT(out, byte, 0x04, low, high, clockMask) \
+	TINYBRITE_EMITBIT(out, byte, 0x02, low, high, clockMask) \
+	TINYBRITE_EMITBIT(out, byte, 0x01, low, high, clockMask)
+
 
 #include "TB_Platform_Arduino.h"
 #include "TB_Platform_AVR.h"
+#include "TB_Platform_Linux.h"
+#include "TB_Platform_Simulator.h"
 
 
 